@@ -0,0 +1,50 @@
+#ifndef NHL_ASYNC_H_
+#define NHL_ASYNC_H_
+
+#include "core.h"
+#include "game.h"
+#include "player.h"
+#include "utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Asynchronous requests are run by worker threads of the handle, and the caller is notified by
+ * calling nhl_poll(). The first asynchronous request makes the handle shared (see NhlInitParams),
+ * so that it can still be used synchronously from other threads. */
+
+/* Completion callbacks receive the status and the result of the synchronous function, and the
+ * user data given with the request. The result must be dereferenced with the corresponding unget
+ * function. */
+typedef void (*NhlScheduleCb)(Nhl *nhl, NhlStatus status, NhlSchedule *schedule, void *userdata);
+typedef void (*NhlGameCb)(Nhl *nhl, NhlStatus status, NhlGame *game, void *userdata);
+typedef void (*NhlPlayerCb)(Nhl *nhl, NhlStatus status, NhlPlayer *player, void *userdata);
+
+/* Start nhl_schedule_get() in the background. Returns zero if the request could not be started. */
+int nhl_schedule_get_async(Nhl *nhl, const NhlDate *date, NhlQueryLevel level,
+                           NhlScheduleCb cb, void *userdata);
+
+/* Start nhl_game_get() in the background. Returns zero if the request could not be started. */
+int nhl_game_get_async(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGameCb cb, void *userdata);
+
+/* Start nhl_player_get() in the background. Returns zero if the request could not be started. */
+int nhl_player_get_async(Nhl *nhl, int player_id, NhlQueryLevel level, NhlPlayerCb cb, void *userdata);
+
+/* Call the callbacks of completed requests on the calling thread, and return the number of calls.
+ * If wait is nonzero and no request has completed yet, waits until at least one has, unless there
+ * are no requests in progress. */
+int nhl_poll(Nhl *nhl, int wait);
+
+/* Return a file descriptor that becomes readable when requests have completed, or -1 if no
+ * asynchronous request has been made. It can be watched by an event loop, which then calls
+ * nhl_poll(). The descriptor must not be read or closed by the caller. */
+int nhl_poll_fd(Nhl *nhl);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* NHL_ASYNC_H_ */
@@ -6,7 +6,15 @@ extern "C" {
 #endif
 
 
-/* Main handle. This is an opaque type which can be initialized by nhl_init(). */
+/* Main handle. This is an opaque type which can be initialized by nhl_init().
+ *
+ * The library has no global mutable state. Distinct handles can be used in parallel on different
+ * threads, also when they share the same cache file, but a single handle (and the objects obtained
+ * from it) must only be used by one thread at a time, unless the handle is shared (see
+ * NhlInitParams). This requires a thread-safe build of SQLite
+ * (sqlite3_threadsafe() is nonzero), and libcurl must be initialized by curl_global_init() before
+ * creating handles on multiple threads, unless the libcurl version has a thread-safe global
+ * initialization. */
 typedef struct Nhl Nhl;
 
 /* Initialization parameters. */
@@ -21,15 +29,47 @@ typedef struct NhlInitParams {
     /* If nonzero, diagnostic messages can be printed to standard output and standard error. */
     int verbose;
 
-    /* Maximum age (in seconds) of various content types in cache. */
+    /* If nonzero, the handle can be used by several threads at once. Calls are serialized, except
+     * that downloads run in parallel, and threads requesting a URL that is being downloaded wait
+     * for the download instead of repeating it. */
+    int shared;
+
+    /* Time (in milliseconds) to wait for another handle or process that is writing to the same
+     * cache file. The cache file is opened in write-ahead log mode, so that readers do not have to
+     * wait for the writer or each other. The write lock is taken only after a download has
+     * completed. If the wait times out, the downloaded content is not stored, and the status of
+     * the call includes NHL_CACHE_LOCKED. */
+    int busy_timeout;
+
+    /* If nonzero, the cache file is opened read-only, and contents are only read from the cache as
+     * if offline was set. The file must already have the schema of this version of the library.
+     * Ignored if cache_file is NULL. */
+    int read_only;
+
+    /* If nonzero, the cache file is assumed not to change while the handle is open, e.g., because
+     * it is a prebuilt snapshot. It is then read without locks or journal files. Implies
+     * read_only. */
+    int immutable;
+
+    /* Maximum age (in seconds) of various content types in cache. Negative value means no limit.
+     * Games (and schedules of days whose games are all in the same state) use the maximum age of the
+     * game state: game_final_max_age for finished games, game_future_max_age for games starting in
+     * more than a day, and game_live_max_age otherwise. */
     int schedule_max_age;
     int game_live_max_age;
     int game_final_max_age;
+    int game_future_max_age;
     int team_max_age;
     int player_max_age;
     int league_max_age;
     int meta_max_age;
 
+    /* Objects that are no longer used by the caller are kept in memory for reuse. At most
+     * retain_max_items unused objects of each type are kept, and they are released after
+     * retain_max_age seconds of disuse (negative value means no limit). Zero disables retention. */
+    int retain_max_items;
+    int retain_max_age;
+
     /* CURRENTLY NOT USED. */
     char *dump_folder;
 } NhlInitParams;
@@ -38,11 +78,13 @@ typedef struct NhlInitParams {
 void nhl_default_params(NhlInitParams *params);
 
 /* Return a newly initialized handle. If params is NULL, default parameters are assumed. Otherwise,
- * the handle takes ownership of the members in params. */
+ * the handle takes ownership of the members in params. Returns NULL if the cache file cannot be
+ * opened, e.g., if it is locked or its schema version is not supported. */
 Nhl *nhl_init(const NhlInitParams *params);
 
-/* Re-initialize an existing handle with (possibly) new parameters. */
-void nhl_reset(Nhl *nhl, const NhlInitParams *params);
+/* Re-initialize an existing handle with (possibly) new parameters. Returns zero if the cache file
+ * cannot be opened, in which case the handle can only be closed with nhl_close(). */
+int nhl_reset(Nhl *nhl, const NhlInitParams *params);
 
 /* Release resources acquired by nhl_init() or nhl_reset().
  * The handle must not be used after call to this. */
@@ -60,7 +102,9 @@ typedef enum NhlStatus {
     NHL_CACHE_READ_ERROR     = 1 << 6 ,
     NHL_CACHE_WRITE_OK       = 1 << 7 ,
     NHL_CACHE_WRITE_ERROR    = 1 << 8 ,
-    NHL_INVALID_REQUEST      = 1 << 9
+    NHL_INVALID_REQUEST      = 1 << 9 ,
+    NHL_CACHE_LOCKED         = 1 << 10 ,
+    NHL_MEMORY_ERROR         = 1 << 11
 } NhlStatus;
 
 /* Query level defines the amount of recursion in various function calls. */
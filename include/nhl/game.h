@@ -273,6 +273,17 @@ typedef struct NhlSchedule {
 NhlStatus nhl_schedule_get(Nhl *nhl, const NhlDate *date, NhlQueryLevel level,
                            NhlSchedule **schedule);
 
+/* Get schedules for multiple days. Schedules missing from the cache are downloaded concurrently.
+ * Consecutive missing days are requested as a range.
+ * Each of the returned pointers must be dereferenced with nhl_schedule_unget(). */
+NhlStatus nhl_schedules_get(Nhl *nhl, const NhlDate *dates, int num_dates, NhlQueryLevel level,
+                            NhlSchedule **schedules);
+
+/* Make sure that the schedules of all days between first and last (inclusive) are up to date in
+ * the cache. Missing or expired schedules are downloaded with a single request, which is much faster
+ * than querying each day separately, e.g., when filling the cache with whole months or seasons. */
+NhlStatus nhl_schedules_prefetch(Nhl *nhl, const NhlDate *first, const NhlDate *last);
+
 /* Dereference the schedule acquired by nhl_schedule_get(). */
 void nhl_schedule_unget(Nhl *nhl, NhlSchedule *schedule);
 
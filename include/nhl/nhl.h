@@ -14,6 +14,7 @@
  * header files from the public API of the library.
  *
  *********************************************************************/
+#include "async.h"
 #include "core.h"
 #include "game.h"
 #include "league.h"
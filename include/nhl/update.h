@@ -75,7 +75,8 @@ typedef enum NhlUpdateContentType {
      */
     NHL_CONTENT_BOXSCORE,
 
-    /* CURRENTLY NOT SUPPORTED.
+    /* Linescore and score of a single game. The game must already be in the cache, i.e., its
+     * schedule must have been read before.
      * Example URL: https://statsapi.web.nhl.com/api/v1/game/2021020281/linescore
      */
     NHL_CONTENT_LINESCORE,
@@ -101,9 +102,23 @@ typedef enum NhlUpdateContentType {
  * content to be the most up-to-date. Usually this function should not be
  * called from a user application, because the updating is done automatically
  * by other functions whenever needed.
+ *
+ * Download is skipped if the same URL has already been accessed during the current top-level
+ * call, or more recently than the maximum age of the content type allows.
  */
 NhlStatus nhl_update_from_url(Nhl *nhl, const char *url, NhlUpdateContentType type);
 
+/* Same as nhl_update_from_url(), but for multiple URLs of the same content type. The contents are
+ * downloaded concurrently, and the database is updated in a single transaction. Returns
+ * NHL_MEMORY_ERROR without downloading anything if the transfers cannot be allocated. URLs whose
+ * transfers cannot be allocated are not downloaded, and the status then includes NHL_MEMORY_ERROR. */
+NhlStatus nhl_update_from_urls(Nhl *nhl, const char *const *urls, int num_urls, NhlUpdateContentType type);
+
+/* Return the number of cache rows that have been added, changed or deleted through the handle since
+ * it was opened. Rows that are read again with identical content only get a new timestamp, and are
+ * not counted. The difference between two calls tells how much the updates in between changed. */
+unsigned long nhl_update_num_changed(Nhl *nhl);
+
 
 #ifdef __cplusplus
 } /* extern "C" */
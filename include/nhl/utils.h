@@ -27,6 +27,9 @@ char *nhl_date_to_string(const NhlDate *date);
  * Positive means that the second argument is "smaller". Zero means equality. */
 int nhl_date_compare(const NhlDate *date1, const NhlDate *date2);
 
+/* Return the calendar day following the given date. */
+NhlDate nhl_date_next(const NhlDate *date);
+
 
 /* Clock time. */
 typedef struct NhlTime {
@@ -0,0 +1,81 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Type with the strictest alignment requirement of the types stored in an arena */
+typedef union NhlArenaAlign {
+    long l;
+    double d;
+    void *p;
+} NhlArenaAlign;
+
+/* Round size up to a multiple of the alignment */
+#define NHL_ARENA_ROUND(size) (((size) + sizeof(NhlArenaAlign) - 1) / sizeof(NhlArenaAlign) * sizeof(NhlArenaAlign))
+
+/* Header of a block. The header of the first block is the arena itself. */
+struct NhlArena {
+    NhlArena *next;    /* Next block, or NULL */
+    NhlArena *last;    /* Block being filled (first block only) */
+    size_t size;       /* Bytes available after the header */
+    size_t used;       /* Bytes allocated after the header */
+    int failed;        /* Nonzero if an allocation has failed (first block only) */
+};
+
+/* Allocate block with room for size bytes. */
+static NhlArena *create_block(size_t size) {
+    NhlArena *block = malloc(NHL_ARENA_ROUND(sizeof(NhlArena)) + size);
+    if (block != NULL) {
+        block->next = NULL;
+        block->last = block;
+        block->size = size;
+        block->used = 0;
+        block->failed = 0;
+    }
+    return block;
+}
+
+NhlArena *nhl_arena_create(size_t size) {
+    return create_block(NHL_ARENA_ROUND(size));
+}
+
+void nhl_arena_delete(NhlArena *arena) {
+    while (arena != NULL) {
+        NhlArena *next = arena->next;
+        free(arena);
+        arena = next;
+    }
+}
+
+void *nhl_arena_alloc(NhlArena *arena, size_t size) {
+    NhlArena *block = arena->last;
+    size = NHL_ARENA_ROUND(size > 0 ? size : 1);
+
+    /* New blocks are at least as large as the first one */
+    if (block->size - block->used < size) {
+        block = create_block(size > arena->size ? size : arena->size);
+        if (block == NULL) {
+            arena->failed = 1;
+            return NULL;
+        }
+        arena->last->next = block;
+        arena->last = block;
+    }
+
+    block->used += size;
+    return (char *) block + NHL_ARENA_ROUND(sizeof(NhlArena)) + block->used - size;
+}
+
+char *nhl_arena_copy_string(NhlArena *arena, const char *str) {
+    if (str != NULL) {
+        size_t len = strlen(str);
+        char *copy = nhl_arena_alloc(arena, len + 1);
+        if (copy != NULL)
+            return memcpy(copy, str, len + 1);
+    }
+    return NULL;
+}
+
+int nhl_arena_failed(const NhlArena *arena) {
+    return arena->failed;
+}
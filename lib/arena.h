@@ -0,0 +1,26 @@
+#ifndef NHL_ARENA_H_
+#define NHL_ARENA_H_
+
+#include <stddef.h>
+
+/* Bump allocator for objects that are released all at once. Memory is taken from blocks that are
+ * filled in order, so that objects allocated together are also stored together. */
+typedef struct NhlArena NhlArena;
+
+/* Create arena whose first block has room for at least size bytes. Release with
+ * nhl_arena_delete(). */
+NhlArena *nhl_arena_create(size_t size);
+
+/* Release the arena and everything allocated from it. */
+void nhl_arena_delete(NhlArena *arena);
+
+/* Allocate size bytes, suitably aligned for any object. Returns NULL if out of memory. */
+void *nhl_arena_alloc(NhlArena *arena, size_t size);
+
+/* Copy a null-terminated string into the arena. Returns NULL if str is NULL. */
+char *nhl_arena_copy_string(NhlArena *arena, const char *str);
+
+/* Returns nonzero if some allocation from the arena has failed. */
+int nhl_arena_failed(const NhlArena *arena);
+
+#endif /* NHL_ARENA_H_ */
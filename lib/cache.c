@@ -5,45 +5,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <sqlite3.h>
 
-
-/* Current time from SQLite. */
-const char *nhl_cache_current_time(Nhl *nhl) {
-    static const char sql[] = "SELECT datetime('now');";
-    static char current_time[] = "0000-00-00 00:00:00";
-
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(nhl->db, sql, -1, &stmt, NULL);
-    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) == SQLITE_TEXT) {
-        const char *datetime = (const char *) sqlite3_column_text(stmt, 0);
-        int sz = sqlite3_column_bytes(stmt, 0);
-        if (sz + 1 == sizeof(current_time)) {
-            memcpy(current_time, datetime, sz);
-        }
-    }
-    sqlite3_finalize(stmt);
-
-    return current_time;
-}
-
-/* Age of the given timestamp in seconds. Negative value indicates an error. */
-int nhl_cache_timestamp_age(Nhl *nhl, const char *timestamp) {
-    int age = -1;
-    char *sql = sqlite3_mprintf(
-        "SELECT strftime('%%s', 'now') - strftime('%%s', %Q);", timestamp);
-
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(nhl->db, sql, -1, &stmt, NULL);
-    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) == SQLITE_INTEGER) {
-        age = sqlite3_column_int(stmt, 0);
-    }
-    sqlite3_finalize(stmt);
-
-    sqlite3_free(sql);
-    return age;
-}
+#include "hash.h"
+#include "intern.h"
 
 
 /* Definition of a single column in SQLite table. */
@@ -60,6 +27,84 @@ typedef enum NhlCacheColumnType {
     NHL_CACHE_COLUMN_OTHER
 } NhlCacheColumnType;
 
+/* Identifiers of cache tables. These are used as indices in the statement registry. */
+typedef enum NhlCacheTableId {
+    NHL_CACHE_TABLE_SOURCES,
+    NHL_CACHE_TABLE_SCHEDULES,
+    NHL_CACHE_TABLE_GAMES,
+    NHL_CACHE_TABLE_GAME_TYPES,
+    NHL_CACHE_TABLE_GAME_STATUSES,
+    NHL_CACHE_TABLE_LINESCORES,
+    NHL_CACHE_TABLE_PERIODS,
+    NHL_CACHE_TABLE_GOALS,
+    NHL_CACHE_TABLE_CONFERENCES,
+    NHL_CACHE_TABLE_DIVISIONS,
+    NHL_CACHE_TABLE_PLAYERS,
+    NHL_CACHE_TABLE_POSITIONS,
+    NHL_CACHE_TABLE_ROSTER_STATUSES,
+    NHL_CACHE_TABLE_TEAMS,
+    NHL_CACHE_TABLE_FRANCHISES,
+    NHL_CACHE_TABLE_RESPONSES,
+    NHL_CACHE_NUM_TABLES
+} NhlCacheTableId;
+
+/* Kinds of prepared statements that each table can have. */
+typedef enum NhlCacheStatementKind {
+    NHL_CACHE_STMT_PUT,     /* Insert a complete row, or update it if its content differs */
+    NHL_CACHE_STMT_GET,     /* Select complete rows by the key column */
+    NHL_CACHE_STMT_FIND,    /* Select key column by the search column */
+    NHL_CACHE_STMT_TRIM,    /* Delete rows of the key column beyond a given number */
+    NHL_CACHE_STMT_TOUCH,   /* Update timestamp of rows by the source column */
+    NHL_CACHE_STMT_REFRESH, /* Update timestamp of a row by the primary key */
+    NHL_CACHE_NUM_STMTS
+} NhlCacheStatementKind;
+
+/* Definition of a cache table. */
+typedef struct NhlCacheTable {
+    NhlCacheTableId id;            /* Index in the statement registry */
+    const char *name;              /* Name of the table in the database */
+    const NhlCacheColumn *columns; /* Null-terminated array of column definitions */
+    const char *key;               /* Column used by GET and RESET statements */
+    const char *find;              /* Indexed column used by FIND statement, or NULL */
+    const char *primary_key;       /* Composite primary key, or NULL if declared by a column */
+    const char *const *sql;        /* Custom statements for each kind, or NULL if generated */
+} NhlCacheTable;
+
+/* Key of the rows read in advance. The rows of a key are chained in the order they were read. */
+typedef struct NhlCacheStashKey {
+    const char *text; /* Text key, owned by the first row, or NULL if the key is an integer */
+    int key;          /* Integer key */
+    int first;        /* Index of the first row, or -1 if there are no rows */
+    int last;         /* Index of the last row, or -1 if there are no rows */
+    int complete;     /* Nonzero if all rows of an integer key have been read, even if there are none */
+} NhlCacheStashKey;
+
+/* Rows of a table read in advance by cache_prefetch(). Each row is an array of column values. The
+ * keys of the rows are indexed by hash with open addressing and linear probing (as in NhlDict), so
+ * that finding the rows of a key does not scan all rows. For tables with an integer key column,
+ * keys that have been read without any rows are kept as well, so that they need no queries either. */
+typedef struct NhlCacheStash {
+    sqlite3_value ***rows;
+    int *next;        /* Index of the next row of the same key for each row, or -1 */
+    int num_rows;
+    int num_columns;
+    int allocated;
+    NhlCacheStashKey *keys;
+    int num_keys;
+    int allocated_keys;
+    int *slots;       /* Index of a key plus one for each slot, or zero if the slot is free */
+    int num_slots;    /* Zero or a power of two, at least twice the number of keys */
+} NhlCacheStash;
+
+/* Registry of prepared statements owned by a handle. Statements are prepared on first use and
+ * kept until the handle is closed, so that later calls only need to bind and reset them. The
+ * registry also holds the prefetched rows, which are valid until the cache is written or the
+ * top-level call finishes. */
+struct NhlCacheStatements {
+    sqlite3_stmt *stmts[NHL_CACHE_NUM_TABLES][NHL_CACHE_NUM_STMTS];
+    NhlCacheStash stash[NHL_CACHE_NUM_TABLES];
+};
+
 /* Convert null-terminated array of column definitions to a string suitable for SQL substitution.
  * For example, "NAME1 TEXT, NAME2 INTEGER", or "NAME1, NAME2" if names_only is nonzero.
  * The returned string must be released with free(). */
@@ -114,56 +159,300 @@ static char *columns_to_string(const NhlCacheColumn *columns, int names_only) {
         exit(3);
 }
 
+/* Type of a single column definition. */
+static NhlCacheColumnType column_type(const NhlCacheColumn *column) {
+    switch (column->type[0]) {
+        case 'i':
+        case 'I':
+            return NHL_CACHE_COLUMN_INTEGER;
+        case 't':
+        case 'T':
+            return NHL_CACHE_COLUMN_TEXT;
+        default:
+            return NHL_CACHE_COLUMN_OTHER;
+    }
+}
+
 /* Find column from a null-terminated array of column definitions. */
 static NhlCacheColumnType find_column(const NhlCacheColumn *columns, const char *col) {
     for ( ; columns->name != NULL; ++columns) {
         if (strcmp(columns->name, col) == 0) {
-            switch (columns->type[0]) {
-                case 'i':
-                case 'I':
-                    return NHL_CACHE_COLUMN_INTEGER;
-                case 't':
-                case 'T':
-                    return NHL_CACHE_COLUMN_TEXT;
-                default:
-                    return NHL_CACHE_COLUMN_OTHER;
-            }
+            return column_type(columns);
         }
     }
     return NHL_CACHE_COLUMN_NOT_FOUND;
 }
 
-/* Create database table if it does not already exist. Returns zero if error occurs. */
-static int ensure_table(Nhl *nhl, const char *table, const NhlCacheColumn *columns) {
-    char *clist = columns_to_string(columns, 0);
-    char *sql = sqlite3_mprintf("CREATE TABLE IF NOT EXISTS %Q (%q);", table, clist);
-    sqlite3_exec(nhl->db, sql, NULL, NULL, NULL);
-    sqlite3_free(sql);
-    free(clist);
-    return 1; /* TODO: Check return value */
+static size_t num_columns(const NhlCacheColumn *columns) {
+    size_t num_columns = 0;
+    while (columns[num_columns].name)
+        ++num_columns;
+    return num_columns;
 }
 
-/* Create template for SQL SELECT string. An example output is
- *     "SELECT NAME1, NAME2 FROM <table> WHERE %q=<spec>;"
- * where <table> and <spec> are specified in the input (spec is typically %d or %s), and NAME1 and
- * NAME2 are deduced from the null-terminated array of column definitions.
- * The returned string must be released with free(). */
-static char *sql_select_template(const char *table, const NhlCacheColumn *columns, const char *spec) {
-    static const char template[] = "SELECT "   " FROM "   " WHERE %q=%_;";
-    char *clist = columns_to_string(columns, 1);
-    size_t len = strlen(template) + strlen(clist) + strlen(table);
-    char *sql = malloc(len+1);
-    sprintf(sql, "SELECT %s FROM %s WHERE %%q=%s;", clist, table, spec);
-    free(clist);
+/* Returns nonzero if a column belongs to the primary key of a table. */
+static int is_primary_key(const NhlCacheTable *table, const NhlCacheColumn *column) {
+    const char *key = table->primary_key;
+    size_t len = strlen(column->name);
+
+    if (key == NULL) {
+        return strstr(column->type, "PRIMARY KEY") != NULL;
+    }
+    while (*key != '\0') {
+        size_t key_len = strcspn(key, ", ");
+        if (key_len == len && strncmp(key, column->name, len) == 0) {
+            return 1;
+        }
+        key += key_len;
+        key += strspn(key, ", ");
+    }
+    return 0;
+}
+
+/* Last column of the composite primary key of a table, which numbers the rows of the key column. */
+static const char *index_column(const NhlCacheTable *table) {
+    const char *last = strrchr(table->primary_key, ' ');
+    return last != NULL ? last + 1 : table->primary_key;
+}
+
+/* Append the names of the columns of a table to sql, separated by commas. The columns are either
+ * those of the primary key, or the others except for the timestamp, and each name is preceded by
+ * prefix. */
+static void append_columns(sqlite3_str *sql, const NhlCacheTable *table, int key, const char *prefix) {
+    const NhlCacheColumn *col;
+    const char *sep = "";
+    for (col = table->columns; col->name != NULL; ++col) {
+        if (key ? is_primary_key(table, col) :
+                  !is_primary_key(table, col) && strcmp(col->name, "_timestamp") != 0) {
+            sqlite3_str_appendf(sql, "%s%s%s", sep, prefix, col->name);
+            sep = ", ";
+        }
+    }
+}
+
+/* Create SQL string for an UPSERT statement. An example output is
+ *     "INSERT INTO <table> VALUES (?,?,?,?) ON CONFLICT (id) DO UPDATE SET
+ *      name=excluded.name, _timestamp=excluded._timestamp WHERE (name) IS NOT (excluded.name);"
+ * where the number of parameters equals the number of columns in the table. An existing row is
+ * only written if a column other than the timestamp differs, so that sqlite3_changes() tells
+ * whether the content changed. The returned string must be released with sqlite3_free().
+ */
+static char *sql_upsert(const NhlCacheTable *table) {
+    sqlite3_str *sql = sqlite3_str_new(NULL);
+    const NhlCacheColumn *col;
+    const char *sep = "";
+
+    sqlite3_str_appendf(sql, "INSERT INTO %s VALUES (", table->name);
+    for (col = table->columns; col->name != NULL; ++col) {
+        sqlite3_str_appendf(sql, "%s?", col == table->columns ? "" : ",");
+    }
+    sqlite3_str_appendall(sql, ") ON CONFLICT (");
+    append_columns(sql, table, 1, "");
+
+    sqlite3_str_appendall(sql, ") DO UPDATE SET ");
+    for (col = table->columns; col->name != NULL; ++col) {
+        if (!is_primary_key(table, col)) {
+            sqlite3_str_appendf(sql, "%s%s=excluded.%s", sep, col->name, col->name);
+            sep = ", ";
+        }
+    }
+
+    sqlite3_str_appendall(sql, " WHERE (");
+    append_columns(sql, table, 0, "");
+    sqlite3_str_appendall(sql, ") IS NOT (");
+    append_columns(sql, table, 0, "excluded.");
+    sqlite3_str_appendall(sql, ");");
+    return sqlite3_str_finish(sql);
+}
+
+/* Create SQL string for updating the timestamp of a single row, e.g.,
+ *     "UPDATE <table> SET _timestamp=? WHERE game=? AND goalNumber=?;"
+ * where the primary key columns are in the order of the column definitions. Release with
+ * sqlite3_free(). */
+static char *sql_refresh(const NhlCacheTable *table) {
+    sqlite3_str *sql = sqlite3_str_new(NULL);
+    const NhlCacheColumn *col;
+    const char *sep = " WHERE ";
+
+    sqlite3_str_appendf(sql, "UPDATE %s SET _timestamp=?", table->name);
+    for (col = table->columns; col->name != NULL; ++col) {
+        if (is_primary_key(table, col)) {
+            sqlite3_str_appendf(sql, "%s%s=?", sep, col->name);
+            sep = " AND ";
+        }
+    }
+    sqlite3_str_appendall(sql, ";");
+    return sqlite3_str_finish(sql);
+}
+
+/* Create SQL string for a statement of the given kind. Release with sqlite3_free(). */
+static char *sql_statement(const NhlCacheTable *table, NhlCacheStatementKind kind) {
+    char *sql = NULL;
+    char *clist;
+
+    if (table->sql != NULL) {
+        return table->sql[kind] != NULL ? sqlite3_mprintf("%s", table->sql[kind]) : NULL;
+    }
+
+    switch (kind) {
+        case NHL_CACHE_STMT_PUT:
+            sql = sql_upsert(table);
+            break;
+        case NHL_CACHE_STMT_GET:
+            clist = columns_to_string(table->columns, 1);
+            sql = sqlite3_mprintf("SELECT %s FROM %s WHERE %s=?;", clist, table->name, table->key);
+            free(clist);
+            break;
+        case NHL_CACHE_STMT_FIND:
+            if (table->find != NULL) {
+                sql = sqlite3_mprintf("SELECT %s FROM %s WHERE %s=?;", table->key, table->name, table->find);
+            }
+            break;
+        case NHL_CACHE_STMT_TRIM:
+            if (table->primary_key != NULL) {
+                sql = sqlite3_mprintf("DELETE FROM %s WHERE %s=? AND %s>=?;",
+                                      table->name, table->key, index_column(table));
+            }
+            break;
+        case NHL_CACHE_STMT_TOUCH:
+            if (find_column(table->columns, "_source") != NHL_CACHE_COLUMN_NOT_FOUND) {
+                sql = sqlite3_mprintf("UPDATE %s SET _timestamp=? WHERE _source=?;", table->name);
+            }
+            break;
+        case NHL_CACHE_STMT_REFRESH:
+            if (find_column(table->columns, "_timestamp") != NHL_CACHE_COLUMN_NOT_FOUND) {
+                sql = sql_refresh(table);
+            }
+            break;
+        default:
+            break;
+    }
     return sql;
 }
 
+/* Return prepared statement of the given kind for a table, or NULL if error occurs. The statement
+ * is created on first use and remains owned by the handle. The table must have been created by
+ * nhl_cache_open(). After use, the caller must reset the
+ * statement with release_statement(). Statements that write to the cache discard prefetched rows. */
+static sqlite3_stmt *get_statement(Nhl *nhl, const NhlCacheTable *table, NhlCacheStatementKind kind) {
+    sqlite3_stmt **stmt = &nhl->statements->stmts[table->id][kind];
+    if (kind != NHL_CACHE_STMT_GET && kind != NHL_CACHE_STMT_FIND) {
+        nhl_cache_prefetch_clear(nhl);
+    }
+    if (*stmt == NULL) {
+        char *sql = sql_statement(table, kind);
+        if (sql != NULL) {
+            if (sqlite3_prepare_v3(nhl->db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL) != SQLITE_OK) {
+                sqlite3_finalize(*stmt);
+                *stmt = NULL;
+            }
+        }
+        sqlite3_free(sql);
+    }
+    return *stmt;
+}
+
+/* Reset statement acquired by get_statement() so that it can be reused. */
+static void release_statement(sqlite3_stmt *stmt) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+/* Bind a key value to the first parameter of a statement. The type of the value is deduced from
+ * the definition of the given column. */
+static void bind_key(sqlite3_stmt *stmt, const NhlCacheTable *table, const char *col, const void *val) {
+    switch (find_column(table->columns, col)) {
+        case NHL_CACHE_COLUMN_INTEGER:
+            sqlite3_bind_int(stmt, 1, *(const int *) val);
+            break;
+        case NHL_CACHE_COLUMN_TEXT:
+            sqlite3_bind_text(stmt, 1, (const char *) val, -1, SQLITE_STATIC);
+            break;
+        default:
+            fprintf(stderr, "ERROR: Invalid key column %s.%s\n", table->name, col);
+            exit(3);
+    }
+}
+
+void nhl_cache_prefetch_clear(Nhl *nhl) {
+    if (nhl->statements != NULL) {
+        int table;
+        for (table = 0; table != NHL_CACHE_NUM_TABLES; ++table) {
+            NhlCacheStash *stash = &nhl->statements->stash[table];
+            int row;
+            for (row = 0; row != stash->num_rows; ++row) {
+                int col;
+                for (col = 0; col != stash->num_columns; ++col) {
+                    sqlite3_value_free(stash->rows[row][col]);
+                }
+                free(stash->rows[row]);
+            }
+            free(stash->rows);
+            free(stash->next);
+            stash->rows = NULL;
+            stash->next = NULL;
+            stash->num_rows = 0;
+            stash->allocated = 0;
+            free(stash->keys);
+            stash->keys = NULL;
+            stash->num_keys = 0;
+            stash->allocated_keys = 0;
+            free(stash->slots);
+            stash->slots = NULL;
+            stash->num_slots = 0;
+        }
+    }
+}
+
+void nhl_cache_close(Nhl *nhl) {
+    if (nhl->statements != NULL) {
+        int table;
+        int kind;
+        nhl_cache_prefetch_clear(nhl);
+        for (table = 0; table != NHL_CACHE_NUM_TABLES; ++table) {
+            for (kind = 0; kind != NHL_CACHE_NUM_STMTS; ++kind) {
+                sqlite3_finalize(nhl->statements->stmts[table][kind]);
+            }
+        }
+        free(nhl->statements);
+        nhl->statements = NULL;
+    }
+}
+
+time_t nhl_cache_current_time(const Nhl *nhl) {
+    (void) nhl;
+    return time(NULL);
+}
+
+int nhl_cache_timestamp_age(const Nhl *nhl, time_t timestamp) {
+    time_t now = nhl->in_progress ? nhl->now : time(NULL);
+    if (timestamp <= 0) {
+        return -1;
+    }
+    /* Rows written after the clock was read are considered brand new. */
+    return now < timestamp ? 0 : (int) (now - timestamp);
+}
+
 /* Extract text from a single column in a SQL statement result. Release with free(). */
 static char *copy_column_text(sqlite3_stmt *stmt, int col) {
     const char *text = (const char *) sqlite3_column_text(stmt, col);
     int len = sqlite3_column_bytes(stmt, col);
     char *copy = malloc(len+1);
-    memcpy(copy, text, len);
+    if (len > 0) {
+        memcpy(copy, text, len);
+    }
+    copy[len] = '\0';
+    return copy;
+}
+
+/* Extract text from a prefetched column value. Release with free(). */
+static char *copy_value_text(sqlite3_value *value) {
+    const char *text = (const char *) sqlite3_value_text(value);
+    int len = sqlite3_value_bytes(value);
+    char *copy = malloc(len+1);
+    if (len > 0) {
+        memcpy(copy, text, len);
+    }
     copy[len] = '\0';
     return copy;
 }
@@ -171,204 +460,484 @@ static char *copy_column_text(sqlite3_stmt *stmt, int col) {
 /* Destroy NhlCacheMeta object. */
 static void free_meta(NhlCacheMeta *meta) {
     if (meta) {
-        free(meta->source);
-        free(meta->timestamp);
         free(meta);
     }
 }
 
-static size_t num_columns(const NhlCacheColumn *columns) {
-    size_t num_columns = 0;
-    while (columns[num_columns].name)
-        ++num_columns;
-    return num_columns;
-}
-
-/* Create template for SQL INSERT string. An example output is
- *     "INSERT OR REPLACE INTO <table> VALUES (%Q,%%Q);"
- * where <table> is specified by the input, and placeholders with one or two % characters
- * correspond to ordinary column types and metadata column types (names beginning with underscore),
- * respectively.
- * The returned string must be released with free().
- */
-static char *sql_insert_template(const char *table, const NhlCacheColumn *columns) {
-    static const char prefix[] = "INSERT OR REPLACE INTO ";
-    static const char middle[] = " VALUES (";
-    static const char suffix[] = ");";
-
-    size_t tablename_len = strlen(table);
-    size_t num_cols = num_columns(columns);
-    size_t values_len = num_cols > 0 ? 4*num_cols - 1 : 0; /* %d, or %Q, and last without comma */
-    size_t sql_len = (sizeof(prefix)-1) + tablename_len + (sizeof(middle)-1) + values_len + (sizeof(suffix)-1);
-
-    char *sql = malloc(sql_len + 1);
-    int pos = sprintf(sql, "%s%s%s", prefix, table, middle);
-
-    for ( ; columns->name; ++columns) {
-        if (tolower(columns->type[0]) == 'i') { /* Integer type */
-            if (columns->name[0] != '_') {
-                strcpy(sql + pos, "%d,");
-                pos += 3;
-            } else {
-                strcpy(sql + pos, "%%d,"); /* Delayed substitution for metadata variable */
-                pos += 4;
-            }
-        } else if (tolower(columns->type[0]) == 't') { /* Text type */
-            if (columns->name[0] != '_') {
-                strcpy(sql + pos, "%Q,");
-                pos += 3;
-            } else {
-                strcpy(sql + pos, "%%Q,"); /* Delayed substitution for metadata variable */
-                pos += 4;
-            }
-        } else {
-            printf("ERROR: Invalid database column type.\n");
-            exit(3);
-        }
-    }
-
-    /* Overwrite last comma */
-    strcpy(sql + pos - 1, suffix);
-    return sql;
-}
-
 
 /*** Source URLs ***/
-static const char source_table[] = "Sources";
 static const NhlCacheColumn source_columns[] = {
     {"url", "TEXT PRIMARY KEY"},
     {0}
 };
+static const char *const source_sql[NHL_CACHE_NUM_STMTS] = {
+    "INSERT INTO Sources VALUES (?);",         /* Add URL */
+    "SELECT rowid FROM Sources WHERE url=?;",  /* Numeric ID of URL */
+    "SELECT url FROM Sources WHERE rowid=?;",  /* URL of numeric ID */
+    NULL
+};
+static const NhlCacheTable source_table = {
+    NHL_CACHE_TABLE_SOURCES, "Sources", source_columns, "url", NULL, NULL, source_sql
+};
+
+/* Intern table of source URLs. On first use, all URLs in the database are loaded, and later
+ * lookups fall back to the database only when the URL or ID has not been seen yet. Returns NULL
+ * if error occurs. */
+static NhlIntern *sources(Nhl *nhl) {
+    if (nhl->sources == NULL) {
+        sqlite3_stmt *stmt;
+        nhl->sources = nhl_intern_create();
+        if (nhl->sources != NULL &&
+                sqlite3_prepare_v2(nhl->db, "SELECT rowid, url FROM Sources;", -1, &stmt, NULL) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                nhl_intern_add(nhl->sources, (const char *) sqlite3_column_text(stmt, 1),
+                    sqlite3_column_int(stmt, 0));
+            }
+            sqlite3_finalize(stmt);
+        }
+    }
+    return nhl->sources;
+}
 
 /* Add non-existing source URL to database and return its numeric ID. */
 static int add_source(Nhl *nhl, const char *source) {
-    static const char sql_template[] = "INSERT INTO %q VALUES (%Q);";
-    static const char sql_rowid[] = "SELECT last_insert_rowid();";
-    char *sql = sqlite3_mprintf(sql_template, source_table, source);
+    sqlite3_stmt *stmt = get_statement(nhl, &source_table, NHL_CACHE_STMT_PUT);
     int source_id = 0;
-    sqlite3_stmt *stmt;
-
-    sqlite3_exec(nhl->db, sql, NULL, NULL, NULL);
 
-    sqlite3_prepare_v2(nhl->db, sql_rowid, -1, &stmt, NULL);
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        source_id = sqlite3_column_int(stmt, 0);
+    if (stmt != NULL) {
+        sqlite3_bind_text(stmt, 1, source, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_DONE) {
+            source_id = (int) sqlite3_last_insert_rowid(nhl->db);
+        }
+        release_statement(stmt);
     }
-
-    sqlite3_finalize(stmt);
-    sqlite3_free(sql);
     return source_id;
 }
 
 /* Get numeric ID of a given source URL, and add URL to database if it does not already exist. */
 static int source_to_num(Nhl *nhl, const char *source) {
-    static const char sql_template[] = "SELECT rowid,%q FROM %q WHERE %q=%Q;";
-    char *sql = sqlite3_mprintf(sql_template, source_columns[0].name, source_table, source_columns[0].name, source);
-    int source_id;
+    NhlIntern *intern = sources(nhl);
     sqlite3_stmt *stmt;
+    int source_id;
 
-    ensure_table(nhl, source_table, source_columns);
+    if (intern != NULL && (source_id = nhl_intern_find_id(intern, source)) != 0) {
+        return source_id;
+    }
 
-    sqlite3_prepare_v2(nhl->db, sql, -1, &stmt, NULL);
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        source_id = sqlite3_column_int(stmt, 0);
-    } else {
+    /* The URL may have been added by another connection since the table was loaded. */
+    source_id = 0;
+    stmt = get_statement(nhl, &source_table, NHL_CACHE_STMT_GET);
+    if (stmt != NULL) {
+        sqlite3_bind_text(stmt, 1, source, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            source_id = sqlite3_column_int(stmt, 0);
+        }
+        release_statement(stmt);
+    }
+    if (source_id == 0) {
         source_id = add_source(nhl, source);
     }
 
-    sqlite3_finalize(stmt);
-    sqlite3_free(sql);
+    if (intern != NULL && source_id != 0) {
+        nhl_intern_add(intern, source, source_id);
+    }
     return source_id;
 }
 
-/* Return source URL as string for given numeric ID, or NULL if not found. Release with free(). */
-static char *num_to_source(Nhl *nhl, int source_id) {
-    static const char sql_template[] = "SELECT %q FROM %q WHERE rowid=%d;";
-    char *sql = sqlite3_mprintf(sql_template, source_columns[0].name, source_table, source_id);
-    char *source = NULL;
-    sqlite3_stmt *stmt;
+/* Return source URL for given numeric ID, or NULL if not found. The returned string is owned by
+ * the handle. */
+static const char *num_to_source(Nhl *nhl, int source_id) {
+    NhlIntern *intern = sources(nhl);
+    const char *source = intern != NULL ? nhl_intern_find_string(intern, source_id) : NULL;
+
+    if (source == NULL && intern != NULL) {
+        sqlite3_stmt *stmt = get_statement(nhl, &source_table, NHL_CACHE_STMT_FIND);
+        if (stmt != NULL) {
+            sqlite3_bind_int(stmt, 1, source_id);
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                source = nhl_intern_add(intern, (const char *) sqlite3_column_text(stmt, 0), source_id);
+            }
+            release_statement(stmt);
+        }
+    }
+    return source;
+}
 
-    ensure_table(nhl, source_table, source_columns);
+/* Create metadata from the values of metadata columns. Release with free_meta(). */
+static NhlCacheMeta *create_meta(Nhl *nhl, int source_id, sqlite3_int64 timestamp, int invalid) {
+    NhlCacheMeta *meta = malloc(sizeof(NhlCacheMeta));
+    meta->source = num_to_source(nhl, source_id);
+    meta->timestamp = (time_t) timestamp;
+    meta->invalid = invalid;
+    return meta;
+}
 
-    sqlite3_prepare_v2(nhl->db, sql, -1, &stmt, NULL);
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        source = copy_column_text(stmt, 0);
-    }
+/* Read metadata columns starting from column index col. Release with free_meta(). */
+static NhlCacheMeta *read_meta(Nhl *nhl, sqlite3_stmt *stmt, int col) {
+    return create_meta(nhl, sqlite3_column_int(stmt, col), sqlite3_column_int64(stmt, col+1),
+                       sqlite3_column_int(stmt, col+2));
+}
 
-    sqlite3_finalize(stmt);
-    sqlite3_free(sql);
-    return source;
+/* Read metadata from column values starting from column index col. Release with free_meta(). */
+static NhlCacheMeta *read_value_meta(Nhl *nhl, sqlite3_value **values, int col) {
+    return create_meta(nhl, sqlite3_value_int(values[col]), sqlite3_value_int64(values[col+1]),
+                       sqlite3_value_int(values[col+2]));
 }
 
 
-/* Add new row or update an existing row in a cache table. The trailing arguments must match with
- * the corresponding variables in the column definitions of the table. */
-static NhlStatus cache_put(Nhl *nhl, const char *table, const NhlCacheColumn *columns, NhlCacheMeta *meta, ...) {
-    va_list args;
-    int source_id;
-    char *sql_template1;
-    char *sql_template2;
-    char *sql;
+/* Add new row or update an existing row in a cache table, where source_id is the numeric ID of
+ * meta->source. The values in args must match with the corresponding variables in the column
+ * definitions of the table. If the row exists with the same content, only its timestamp is updated.
+ * Rows that are actually written are counted in the handle, except for the bookkeeping of
+ * responses. */
+static NhlStatus put_row(Nhl *nhl, const NhlCacheTable *table, const NhlCacheMeta *meta, int source_id,
+                         va_list args) {
+    const NhlCacheColumn *col;
+    int param = 1;
+    int refresh_param = 2;
+    sqlite3_stmt *stmt = get_statement(nhl, table, NHL_CACHE_STMT_PUT);
+    sqlite3_stmt *refresh = get_statement(nhl, table, NHL_CACHE_STMT_REFRESH);
+    int changed;
+    int rc;
+
+    if (stmt == NULL || refresh == NULL) {
+        return NHL_CACHE_WRITE_ERROR;
+    }
+
+    for (col = table->columns; col->name != NULL && col->name[0] != '_'; ++col, ++param) {
+        int key = is_primary_key(table, col);
+        int int_value;
+        const char *text_value;
+        switch (column_type(col)) {
+            case NHL_CACHE_COLUMN_INTEGER:
+                int_value = va_arg(args, int);
+                sqlite3_bind_int(stmt, param, int_value);
+                if (key) {
+                    sqlite3_bind_int(refresh, refresh_param++, int_value);
+                }
+                break;
+            case NHL_CACHE_COLUMN_TEXT:
+                text_value = va_arg(args, const char *);
+                sqlite3_bind_text(stmt, param, text_value, -1, SQLITE_STATIC);
+                if (key) {
+                    sqlite3_bind_text(refresh, refresh_param++, text_value, -1, SQLITE_STATIC);
+                }
+                break;
+            default:
+                fprintf(stderr, "ERROR: Invalid database column type.\n");
+                exit(3);
+        }
+    }
 
-    ensure_table(nhl, table, columns);
+    /* Metadata columns */
+    sqlite3_bind_int(stmt, param, source_id);
+    sqlite3_bind_int64(stmt, param+1, (sqlite3_int64) meta->timestamp);
+    sqlite3_bind_int(stmt, param+2, meta->invalid);
 
-    source_id = source_to_num(nhl, meta->source);
+    rc = sqlite3_step(stmt);
+    changed = rc == SQLITE_DONE && sqlite3_changes(nhl->db) > 0;
+    release_statement(stmt);
 
-    /* Construct SQL query */
-    sql_template1 = sql_insert_template(table, columns);
+    if (rc == SQLITE_DONE && !changed) {
+        sqlite3_bind_int64(refresh, 1, (sqlite3_int64) meta->timestamp);
+        rc = sqlite3_step(refresh);
+    } else if (changed && table->id != NHL_CACHE_TABLE_RESPONSES) {
+        ++nhl->num_changed;
+    }
+    release_statement(refresh);
+    return rc == SQLITE_DONE ? NHL_CACHE_WRITE_OK : NHL_CACHE_WRITE_ERROR;
+}
+
+/* Add new row or update an existing row in a cache table with put_row(). The trailing arguments
+ * must match with the corresponding variables in the column definitions of the table. */
+static NhlStatus cache_put(Nhl *nhl, const NhlCacheTable *table, const NhlCacheMeta *meta, ...) {
+    NhlStatus status;
+    va_list args;
     va_start(args, meta);
-    sql_template2 = sqlite3_vmprintf(sql_template1, args);
+    status = put_row(nhl, table, meta, source_to_num(nhl, meta->source), args);
+    va_end(args);
+    return status;
+}
+
+/* Same as cache_put(), but for writing many rows of the same source, whose numeric ID is looked up
+ * by the caller only once. */
+static NhlStatus cache_put_source(Nhl *nhl, const NhlCacheTable *table, const NhlCacheMeta *meta,
+                                  int source_id, ...) {
+    NhlStatus status;
+    va_list args;
+    va_start(args, source_id);
+    status = put_row(nhl, table, meta, source_id, args);
     va_end(args);
-    sql = sqlite3_mprintf(sql_template2, source_id, meta->timestamp, meta->invalid);
+    return status;
+}
 
-    sqlite3_exec(nhl->db, sql, NULL, NULL, NULL);
+/* Number of keys bound to a single prefetch query. */
+#define NHL_CACHE_PREFETCH_CHUNK 256
 
-    sqlite3_free(sql);
-    sqlite3_free(sql_template2);
-    free(sql_template1);
+/* Index of the key column of a table. */
+static int key_index(const NhlCacheTable *table) {
+    int col = 0;
+    while (table->columns[col].name != NULL && strcmp(table->columns[col].name, table->key) != 0) {
+        ++col;
+    }
+    return col;
+}
+
+/* Hash of a key, which is a string if text is nonzero, or an int otherwise. */
+static unsigned long stash_hash(int text, const void *key) {
+    return text ? nhl_hash_string((const char *) key) : nhl_hash_int(*(const int *) key);
+}
+
+/* Return the index of a key in the stash, or -1 if not found. */
+static int stash_find(const NhlCacheStash *stash, int text, const void *key) {
+    unsigned long mask = (unsigned long) stash->num_slots - 1;
+    unsigned long slot;
+
+    if (stash->num_slots == 0) {
+        return -1;
+    }
+    for (slot = stash_hash(text, key) & mask; stash->slots[slot] != 0; slot = (slot + 1) & mask) {
+        const NhlCacheStashKey *stash_key = &stash->keys[stash->slots[slot] - 1];
+        if (text ? strcmp(stash_key->text, (const char *) key) == 0 : stash_key->key == *(const int *) key) {
+            return stash->slots[slot] - 1;
+        }
+    }
+    return -1;
+}
+
+/* Put the key of the given index to a free slot. */
+static void stash_index_key(NhlCacheStash *stash, int idx) {
+    const NhlCacheStashKey *stash_key = &stash->keys[idx];
+    unsigned long mask = (unsigned long) stash->num_slots - 1;
+    unsigned long slot = stash_key->text != NULL ? stash_hash(1, stash_key->text) : stash_hash(0, &stash_key->key);
+
+    for (slot &= mask; stash->slots[slot] != 0; slot = (slot + 1) & mask) {
+    }
+    stash->slots[slot] = idx + 1;
+}
+
+/* Return the index of a key in the stash. A key that is not found is added without rows. Text
+ * keys must be owned by a row. Returns -1 if out of memory. */
+static int stash_add_key(NhlCacheStash *stash, int text, const void *key) {
+    int idx = stash_find(stash, text, key);
+    NhlCacheStashKey *stash_key;
+
+    if (idx >= 0) {
+        return idx;
+    }
+    if (stash->num_keys == stash->allocated_keys) {
+        int allocated = stash->allocated_keys > 0 ? 2 * stash->allocated_keys : 16;
+        NhlCacheStashKey *keys = realloc(stash->keys, allocated * sizeof(NhlCacheStashKey));
+        if (keys == NULL) {
+            return -1;
+        }
+        stash->keys = keys;
+        stash->allocated_keys = allocated;
+    }
+    if (2 * (stash->num_keys + 1) > stash->num_slots) {
+        int num_slots = stash->num_slots > 0 ? 2 * stash->num_slots : 32;
+        int *slots = calloc(num_slots, sizeof(int));
+        if (slots == NULL) {
+            return -1;
+        }
+        free(stash->slots);
+        stash->slots = slots;
+        stash->num_slots = num_slots;
+        for (idx = 0; idx != stash->num_keys; ++idx) {
+            stash_index_key(stash, idx);
+        }
+    }
+
+    idx = stash->num_keys++;
+    stash_key = &stash->keys[idx];
+    stash_key->text = text ? (const char *) key : NULL;
+    stash_key->key = text ? 0 : *(const int *) key;
+    stash_key->first = -1;
+    stash_key->last = -1;
+    stash_key->complete = 0;
+    stash_index_key(stash, idx);
+    return idx;
+}
+
+/* Return prefetched row of a table whose key column matches the given value, or NULL if the row has
+ * not been prefetched. */
+static sqlite3_value **find_prefetched(Nhl *nhl, const NhlCacheTable *table, const void *key) {
+    const NhlCacheStash *stash = &nhl->statements->stash[table->id];
+    int text = find_column(table->columns, table->key) == NHL_CACHE_COLUMN_TEXT;
+    int idx = stash_find(stash, text, key);
+    return idx >= 0 && stash->keys[idx].first >= 0 ? stash->rows[stash->keys[idx].first] : NULL;
+}
+
+/* Return nonzero if the rows of an integer key have been read in advance, even if there are none. */
+static int key_prefetched(const NhlCacheStash *stash, int key) {
+    int idx = stash_find(stash, 0, &key);
+    return idx >= 0 && stash->keys[idx].complete;
+}
+
+/* Remember that the rows of an integer key have been read in advance. */
+static void add_prefetched_key(NhlCacheStash *stash, int key) {
+    int idx = stash_add_key(stash, 0, &key);
+    if (idx >= 0) {
+        stash->keys[idx].complete = 1;
+    }
+}
+
+/* Append a row read in advance to the stash, and chain it to the other rows of its key, which is
+ * in column col. Returns zero if out of memory, in which case the caller still owns values. */
+static int add_prefetched_row(NhlCacheStash *stash, sqlite3_value **values, int text, int col) {
+    int key = sqlite3_value_int(values[col]);
+    const void *key_ptr = text ? (const void *) sqlite3_value_text(values[col]) : (const void *) &key;
+    int idx;
+
+    if (key_ptr == NULL) {
+        return 0;
+    }
+    if (stash->num_rows == stash->allocated) {
+        int allocated = stash->allocated > 0 ? 2 * stash->allocated : 16;
+        sqlite3_value ***rows = realloc(stash->rows, allocated * sizeof(sqlite3_value **));
+        int *next;
+        if (rows == NULL) {
+            return 0;
+        }
+        stash->rows = rows;
+        next = realloc(stash->next, allocated * sizeof(int));
+        if (next == NULL) {
+            return 0;
+        }
+        stash->next = next;
+        stash->allocated = allocated;
+    }
+    if ((idx = stash_add_key(stash, text, key_ptr)) < 0) {
+        return 0;
+    }
+
+    stash->rows[stash->num_rows] = values;
+    stash->next[stash->num_rows] = -1;
+    if (stash->keys[idx].last >= 0) {
+        stash->next[stash->keys[idx].last] = stash->num_rows;
+    } else {
+        stash->keys[idx].first = stash->num_rows;
+    }
+    stash->keys[idx].last = stash->num_rows++;
+    return 1;
+}
+
+/* Read the rows of a table whose key column matches any of the given keys with as few queries as
+ * possible, and keep them in memory for cache_get() and cache_get_all(). The keys are given in
+ * int_keys or text_keys according to the type of the key column. Keys that are NULL or already
+ * prefetched are ignored. Rows of the same key are kept in the order of the primary key. */
+static void cache_prefetch(Nhl *nhl, const NhlCacheTable *table, const int *int_keys,
+                           const char *const *text_keys, int num_keys) {
+    NhlCacheStash *stash = &nhl->statements->stash[table->id];
+    int num_cols = (int) num_columns(table->columns);
+    int key_col = key_index(table);
+    char *clist = columns_to_string(table->columns, 1);
+    int *indices = malloc((num_keys > 0 ? num_keys : 1) * sizeof(int));
+    int num_indices = 0;
+    int idx;
+
+    for (idx = 0; idx != num_keys; ++idx) {
+        const void *key = text_keys != NULL ? (const void *) text_keys[idx] : (const void *) &int_keys[idx];
+        if (key != NULL && (text_keys != NULL ? stash_find(stash, 1, key) < 0 :
+                                                !key_prefetched(stash, int_keys[idx]))) {
+            indices[num_indices++] = idx;
+        }
+    }
+    stash->num_columns = num_cols;
+
+    for (idx = 0; idx < num_indices; idx += NHL_CACHE_PREFETCH_CHUNK) {
+        int num = num_indices - idx < NHL_CACHE_PREFETCH_CHUNK ? num_indices - idx : NHL_CACHE_PREFETCH_CHUNK;
+        char *params = malloc(2*num);
+        sqlite3_stmt *stmt = NULL;
+        char *sql;
+        int param;
+        int rc = SQLITE_ERROR;
+
+        for (param = 0; param != num; ++param) {
+            params[2*param] = '?';
+            params[2*param + 1] = ',';
+        }
+        params[2*num - 1] = '\0'; /* Overwrite last comma */
+        sql = sqlite3_mprintf("SELECT %s FROM %s WHERE %s IN (%s) ORDER BY %s;", clist, table->name,
+                              table->key, params, table->primary_key != NULL ? table->primary_key : table->key);
+        free(params);
+
+        if (sql != NULL && sqlite3_prepare_v2(nhl->db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+            for (param = 0; param != num; ++param) {
+                int key = indices[idx + param];
+                if (text_keys != NULL) {
+                    sqlite3_bind_text(stmt, param+1, text_keys[key], -1, SQLITE_STATIC);
+                } else {
+                    sqlite3_bind_int(stmt, param+1, int_keys[key]);
+                }
+            }
+
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                sqlite3_value **values = malloc(num_cols * sizeof(sqlite3_value *));
+                int col;
+                if (values == NULL) {
+                    break;
+                }
+                for (col = 0; col != num_cols; ++col) {
+                    values[col] = sqlite3_value_dup(sqlite3_column_value(stmt, col));
+                }
+                if (!add_prefetched_row(stash, values, text_keys != NULL, key_col)) {
+                    for (col = 0; col != num_cols; ++col) {
+                        sqlite3_value_free(values[col]);
+                    }
+                    free(values);
+                    break;
+                }
+            }
+            for (param = 0; rc == SQLITE_DONE && text_keys == NULL && param != num; ++param) {
+                add_prefetched_key(stash, int_keys[indices[idx + param]]);
+            }
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_free(sql);
+    }
 
-    return NHL_CACHE_WRITE_OK; /* TODO: check return value */
+    free(indices);
+    free(clist);
 }
 
 /* Read single row from a table and store values into the trailing arguments that must match with
- * the given null-terminated array of column definitions. Text values must be released with free().
- * The row is found by input arguments where_col and where_val which determine the name of the
- * column and its desired value, respectively. Nonzero return value implies success. */
-static int cache_get(Nhl *nhl, const char *table, const NhlCacheColumn *columns,
-                      const char *where_col, const void *where_val, ...) {
+ * the column definitions of the table. Text values must be released with free(). The row is found
+ * by the key column of the table whose value is given by key, first from the prefetched rows and
+ * then from the database. Nonzero return value implies success. */
+static int cache_get(Nhl *nhl, const NhlCacheTable *table, const void *key, ...) {
     va_list args;
-    char *template;
-    char *sql;
-    sqlite3_stmt *stmt;
-    NhlCacheColumnType colType = find_column(columns, where_col);
+    const NhlCacheColumn *columns;
+    sqlite3_value **values = find_prefetched(nhl, table, key);
+    sqlite3_stmt *stmt = NULL;
     int col;
     int ok;
     NhlCacheMeta **meta;
 
-    ensure_table(nhl, table, columns);
-    if (colType == NHL_CACHE_COLUMN_INTEGER) {
-        template = sql_select_template(table, columns, "%d");
-        sql = sqlite3_mprintf(template, where_col, *(const int *) where_val);
-    } else if (colType == NHL_CACHE_COLUMN_TEXT) {
-        template = sql_select_template(table, columns, "%Q");
-        sql = sqlite3_mprintf(template, where_col, (const char *) where_val);
+    if (values != NULL) {
+        ok = 1;
+    } else if (find_column(table->columns, table->key) == NHL_CACHE_COLUMN_INTEGER &&
+               key_prefetched(&nhl->statements->stash[table->id], *(const int *) key)) {
+        ok = 0;
     } else {
-        fprintf(stderr, "ERROR\n");
-        exit(3);
+        stmt = get_statement(nhl, table, NHL_CACHE_STMT_GET);
+        if (stmt == NULL) {
+            return 0;
+        }
+        bind_key(stmt, table, table->key, key);
+        ok = sqlite3_step(stmt) == SQLITE_ROW;
     }
 
-    va_start(args, where_val);
-
-    sqlite3_prepare_v2(nhl->db, sql, -1, &stmt, NULL);
-    ok = sqlite3_step(stmt) == SQLITE_ROW;
-
-    for (col = 0; columns->name != NULL && columns->name[0] != '_'; ++columns, ++col) {
-        switch (columns->type[0]) {
-            case 'i': case 'I':
-                *va_arg(args, int*) = ok ? sqlite3_column_int(stmt, col) : 0;
+    va_start(args, key);
+    for (col = 0, columns = table->columns; columns->name != NULL && columns->name[0] != '_'; ++columns, ++col) {
+        switch (column_type(columns)) {
+            case NHL_CACHE_COLUMN_INTEGER:
+                *va_arg(args, int*) = !ok ? 0 :
+                    values != NULL ? sqlite3_value_int(values[col]) : sqlite3_column_int(stmt, col);
                 break;
-            case 't': case 'T':
-                *va_arg(args, char**) = ok ? copy_column_text(stmt, col) : NULL;
+            case NHL_CACHE_COLUMN_TEXT:
+                *va_arg(args, char**) = !ok ? NULL :
+                    values != NULL ? copy_value_text(values[col]) : copy_column_text(stmt, col);
                 break;
             default:
                 fprintf(stderr, "ERROR\n");
@@ -377,40 +946,117 @@ static int cache_get(Nhl *nhl, const char *table, const NhlCacheColumn *columns,
     }
     meta = va_arg(args, NhlCacheMeta **);
     if (ok) {
-        *meta = malloc(sizeof(NhlCacheMeta));
-        (*meta)->source = ok ? num_to_source(nhl, sqlite3_column_int(stmt, col)) : NULL;
-        (*meta)->timestamp = ok ? copy_column_text(stmt, col+1) : NULL;
-        (*meta)->invalid = ok ? sqlite3_column_int(stmt, col+2) : 0;
+        *meta = values != NULL ? create_meta(nhl, sqlite3_value_int(values[col]), sqlite3_value_int64(values[col+1]),
+                                             sqlite3_value_int(values[col+2])) :
+                                 read_meta(nhl, stmt, col);
     }
-
-    sqlite3_finalize(stmt);
-    sqlite3_free(sql);
-    free(template);
     va_end(args);
+
+    if (stmt != NULL) {
+        release_statement(stmt);
+    }
     return ok;
 }
 
+/* Callback of cache_get_all() that converts the column values of a row to an array element. */
+typedef void (*NhlCacheRowCb)(Nhl *nhl, sqlite3_value **values, void *dest);
+
+/* Read all rows of a table whose integer key column matches the given key, first from the
+ * prefetched rows and then from the database. Returns an array of num_rows elements of elem_size
+ * bytes that are filled by row_cb, or NULL if there are no rows. Release with free(). */
+static void *cache_get_all(Nhl *nhl, const NhlCacheTable *table, int key, NhlCacheRowCb row_cb,
+                           size_t elem_size, int *num_rows) {
+    const NhlCacheStash *stash = &nhl->statements->stash[table->id];
+    int num_cols = (int) num_columns(table->columns);
+    sqlite3_value **values = malloc(num_cols * sizeof(sqlite3_value *));
+    int num_alloc = 4;
+    char *elems = malloc(num_alloc * elem_size);
+    *num_rows = 0;
+
+    if (key_prefetched(stash, key)) {
+        int row;
+        for (row = stash->keys[stash_find(stash, 0, &key)].first; row >= 0; row = stash->next[row]) {
+            if (num_alloc <= *num_rows) {
+                num_alloc *= 2;
+                elems = realloc(elems, num_alloc * elem_size);
+            }
+            row_cb(nhl, stash->rows[row], elems + *num_rows * elem_size);
+            ++*num_rows;
+        }
+
+    } else {
+        sqlite3_stmt *stmt = get_statement(nhl, table, NHL_CACHE_STMT_GET);
+        if (stmt != NULL) {
+            sqlite3_bind_int(stmt, 1, key);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                int col;
+                if (num_alloc <= *num_rows) {
+                    num_alloc *= 2;
+                    elems = realloc(elems, num_alloc * elem_size);
+                }
+                for (col = 0; col != num_cols; ++col) {
+                    values[col] = sqlite3_column_value(stmt, col);
+                }
+                row_cb(nhl, values, elems + *num_rows * elem_size);
+                ++*num_rows;
+            }
+            release_statement(stmt);
+        }
+    }
+
+    free(values);
+    if (*num_rows != 0) {
+        elems = realloc(elems, *num_rows * elem_size);
+    } else {
+        free(elems);
+        elems = NULL;
+    }
+    return elems;
+}
+
+/* Delete the rows of a table whose integer key column matches the given key, except for the first
+ * num rows as numbered by the last column of the primary key. */
+static NhlStatus cache_trim(Nhl *nhl, const NhlCacheTable *table, int key, int num) {
+    sqlite3_stmt *stmt = get_statement(nhl, table, NHL_CACHE_STMT_TRIM);
+    int rc;
+
+    if (stmt == NULL) {
+        return NHL_CACHE_WRITE_ERROR;
+    }
+
+    sqlite3_bind_int(stmt, 1, key);
+    sqlite3_bind_int(stmt, 2, num);
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE) {
+        nhl->num_changed += sqlite3_changes(nhl->db);
+    }
+    release_statement(stmt);
+    return rc == SQLITE_DONE ? NHL_CACHE_WRITE_OK : NHL_CACHE_WRITE_ERROR;
+}
+
 
 /*** Schedules ***/
-static const char schedule_table[] = "Schedules";
 static const NhlCacheColumn schedule_columns[] = {
     {"date",       "TEXT PRIMARY KEY"},
     {"totalGames", "INTEGER"},
     {"_source",    "INTEGER"},
-    {"_timestamp", "TEXT"},
+    {"_timestamp", "INTEGER"},
     {"_invalid",   "INTEGER"},
     {0}
 };
+static const NhlCacheTable schedule_table = {
+    NHL_CACHE_TABLE_SCHEDULES, "Schedules", schedule_columns, "date", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_schedule_put(Nhl *nhl, const NhlCacheSchedule *schedule) {
-    return cache_put(nhl, schedule_table, schedule_columns, schedule->meta,
+    return cache_put(nhl, &schedule_table, schedule->meta,
         schedule->date,
         schedule->totalGames);
 }
 
 NhlCacheSchedule *nhl_cache_schedule_get(Nhl *nhl, const char *schedule_date) {
     NhlCacheSchedule *schedule = malloc(sizeof(NhlCacheSchedule));
-    int success = cache_get(nhl, schedule_table, schedule_columns, "date", schedule_date,
+    int success = cache_get(nhl, &schedule_table, schedule_date,
         &schedule->date,
         &schedule->totalGames,
         &schedule->meta);
@@ -431,7 +1077,6 @@ void nhl_cache_schedule_free(NhlCacheSchedule *schedule) {
 
 
 /*** Games ***/
-static const char game_table[] = "Games";
 static const NhlCacheColumn game_columns[] = {
     {"gamePk",          "INTEGER PRIMARY KEY"},
     {"date",            "TEXT"},
@@ -452,13 +1097,16 @@ static const NhlCacheColumn game_columns[] = {
     {"homeOt",          "INTEGER"},
     {"homeRecordType",  "TEXT"},
     {"_source",         "INTEGER"},
-    {"_timestamp",      "TEXT"},
+    {"_timestamp",      "INTEGER"},
     {"_invalid",        "INTEGER"},
     {0}
 };
+static const NhlCacheTable game_table = {
+    NHL_CACHE_TABLE_GAMES, "Games", game_columns, "gamePk", "date", NULL, NULL
+};
 
 NhlStatus nhl_cache_game_put(Nhl *nhl, const NhlCacheGame *game) {
-    return cache_put(nhl, game_table, game_columns, game->meta,
+    return cache_put(nhl, &game_table, game->meta,
         game->gamePk,
         game->date,
         game->gameType,
@@ -480,19 +1128,16 @@ NhlStatus nhl_cache_game_put(Nhl *nhl, const NhlCacheGame *game) {
 }
 
 int *nhl_cache_games_find(Nhl *nhl, const char *date, int *num_games) {
-    char *template;
-    char *sql;
-    sqlite3_stmt *stmt;
+    sqlite3_stmt *stmt = get_statement(nhl, &game_table, NHL_CACHE_STMT_FIND);
     int num_alloc = 4;
     int *gamePk = malloc(num_alloc * sizeof(int));
 
-    ensure_table(nhl, game_table, game_columns);
-    template = sql_select_template(game_table, game_columns, "%Q");
-    sql = sqlite3_mprintf(template, "date", date);
-
-    sqlite3_prepare_v2(nhl->db, sql, -1, &stmt, NULL);
     *num_games = 0;
+    if (stmt == NULL) {
+        return gamePk;
+    }
 
+    bind_key(stmt, &game_table, game_table.find, date);
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         if (num_alloc <= *num_games) {
             num_alloc *= 2;
@@ -503,15 +1148,13 @@ int *nhl_cache_games_find(Nhl *nhl, const char *date, int *num_games) {
     }
     gamePk = realloc(gamePk, *num_games * sizeof(int));
 
-    sqlite3_finalize(stmt);
-    sqlite3_free(sql);
-    free(template);
+    release_statement(stmt);
     return gamePk;
 }
 
 NhlCacheGame *nhl_cache_game_get(Nhl *nhl, int game_id) {
     NhlCacheGame *game = malloc(sizeof(NhlCacheGame));
-    int success = cache_get(nhl, game_table, game_columns, "gamePk", &game_id,
+    int success = cache_get(nhl, &game_table, &game_id,
         &game->gamePk,
         &game->date,
         &game->gameType,
@@ -538,6 +1181,10 @@ NhlCacheGame *nhl_cache_game_get(Nhl *nhl, int game_id) {
     return game;
 }
 
+void nhl_cache_games_prefetch(Nhl *nhl, const int *game_ids, int num_games) {
+    cache_prefetch(nhl, &game_table, game_ids, NULL, num_games);
+}
+
 void nhl_cache_game_free(NhlCacheGame *game) {
     if (game != NULL) {
         free_meta(game->meta);
@@ -554,19 +1201,21 @@ void nhl_cache_game_free(NhlCacheGame *game) {
 
 
 /*** Game types ***/
-static const char gametyp_table[] = "GameTypes";
 static const NhlCacheColumn gametyp_columns[] = {
     {"id",          "TEXT PRIMARY KEY"},
     {"description", "TEXT"},
     {"postseason",  "INTEGER"},
     {"_source",     "INTEGER"},
-    {"_timestamp",  "TEXT"},
+    {"_timestamp",  "INTEGER"},
     {"_invalid",    "INTEGER"},
     {0}
 };
+static const NhlCacheTable gametyp_table = {
+    NHL_CACHE_TABLE_GAME_TYPES, "GameTypes", gametyp_columns, "id", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_game_type_put(Nhl *nhl, const NhlCacheGameType *game_type) {
-    return cache_put(nhl, gametyp_table, gametyp_columns, game_type->meta,
+    return cache_put(nhl, &gametyp_table, game_type->meta,
         game_type->id,
         game_type->description,
         game_type->postseason);
@@ -574,7 +1223,7 @@ NhlStatus nhl_cache_game_type_put(Nhl *nhl, const NhlCacheGameType *game_type) {
 
 NhlCacheGameType *nhl_cache_game_type_get(Nhl *nhl, const char *game_type_id) {
     NhlCacheGameType *gametyp = malloc(sizeof(NhlCacheGameType));
-    int success = cache_get(nhl, gametyp_table, gametyp_columns, "id", game_type_id,
+    int success = cache_get(nhl, &gametyp_table, game_type_id,
         &gametyp->id,
         &gametyp->description,
         &gametyp->postseason,
@@ -586,6 +1235,10 @@ NhlCacheGameType *nhl_cache_game_type_get(Nhl *nhl, const char *game_type_id) {
     return gametyp;
 }
 
+void nhl_cache_game_types_prefetch(Nhl *nhl, const char *const *game_type_ids, int num_game_types) {
+    cache_prefetch(nhl, &gametyp_table, NULL, game_type_ids, num_game_types);
+}
+
 void nhl_cache_game_type_free(NhlCacheGameType *game_type) {
     if (game_type != NULL) {
         free_meta(game_type->meta);
@@ -597,20 +1250,22 @@ void nhl_cache_game_type_free(NhlCacheGameType *game_type) {
 
 
 /*** Game statuses ***/
-static const char gamest_table[] = "GameStatuses";
 static const NhlCacheColumn gamest_columns[] = {
     {"code",              "TEXT PRIMARY KEY"},
     {"abstractGameState", "TEXT"},
     {"detailedState",     "TEXT"},
     {"startTimeTBD",      "INTEGER"},
     {"_source",           "INTEGER"},
-    {"_timestamp",        "TEXT"},
+    {"_timestamp",        "INTEGER"},
     {"_invalid",          "INTEGER"},
     {0}
 };
+static const NhlCacheTable gamest_table = {
+    NHL_CACHE_TABLE_GAME_STATUSES, "GameStatuses", gamest_columns, "code", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_game_status_put(Nhl *nhl, const NhlCacheGameStatus *gamest) {
-    return cache_put(nhl, gamest_table, gamest_columns, gamest->meta,
+    return cache_put(nhl, &gamest_table, gamest->meta,
         gamest->code,
         gamest->abstractGameState,
         gamest->detailedState,
@@ -619,7 +1274,7 @@ NhlStatus nhl_cache_game_status_put(Nhl *nhl, const NhlCacheGameStatus *gamest)
 
 NhlCacheGameStatus *nhl_cache_game_status_get(Nhl *nhl, const char *game_status_code) {
     NhlCacheGameStatus *gamest = malloc(sizeof(NhlCacheGameStatus));
-    int success = cache_get(nhl, gamest_table, gamest_columns, "code", game_status_code,
+    int success = cache_get(nhl, &gamest_table, game_status_code,
         &gamest->code,
         &gamest->abstractGameState,
         &gamest->detailedState,
@@ -632,6 +1287,10 @@ NhlCacheGameStatus *nhl_cache_game_status_get(Nhl *nhl, const char *game_status_
     return gamest;
 }
 
+void nhl_cache_game_statuses_prefetch(Nhl *nhl, const char *const *game_status_codes, int num_game_statuses) {
+    cache_prefetch(nhl, &gamest_table, NULL, game_status_codes, num_game_statuses);
+}
+
 void nhl_cache_game_status_free(NhlCacheGameStatus *gamest) {
     if (gamest != NULL) {
         free_meta(gamest->meta);
@@ -644,7 +1303,6 @@ void nhl_cache_game_status_free(NhlCacheGameStatus *gamest) {
 
 
 /*** Linescores ***/
-static const char linescore_table[] = "Linescores";
 static const NhlCacheColumn linescore_columns[] = {
     {"game",                        "INTEGER PRIMARY KEY"},
     {"currentPeriod",               "INTEGER"},
@@ -672,15 +1330,18 @@ static const NhlCacheColumn linescore_columns[] = {
     {"powerPlaySituationElapsed",   "INTEGER"},
     {"powerPlayInSituation",        "INTEGER"},
     {"_source",                     "INTEGER"},
-    {"_timestamp",                  "TEXT"},
+    {"_timestamp",                  "INTEGER"},
     {"_invalid",                    "INTEGER"},
     {0}
 };
+static const NhlCacheTable linescore_table = {
+    NHL_CACHE_TABLE_LINESCORES, "Linescores", linescore_columns, "game", NULL, NULL, NULL
+};
 
 
 NhlCacheLinescore *nhl_cache_linescore_get(Nhl *nhl, int game_id) {
     NhlCacheLinescore *linescore = malloc(sizeof(NhlCacheLinescore));
-    int success = cache_get(nhl, linescore_table, linescore_columns, "game", &game_id,
+    int success = cache_get(nhl, &linescore_table, &game_id,
         &linescore->game,
         &linescore->currentPeriod,
         &linescore->currentPeriodOrdinal,
@@ -715,7 +1376,7 @@ NhlCacheLinescore *nhl_cache_linescore_get(Nhl *nhl, int game_id) {
 }
 
 NhlStatus nhl_cache_linescore_put(Nhl *nhl, const NhlCacheLinescore *linescore) {
-    return cache_put(nhl, linescore_table, linescore_columns, linescore->meta,
+    return cache_put(nhl, &linescore_table, linescore->meta,
         linescore->game,
         linescore->currentPeriod,
         linescore->currentPeriodOrdinal,
@@ -743,6 +1404,10 @@ NhlStatus nhl_cache_linescore_put(Nhl *nhl, const NhlCacheLinescore *linescore)
         linescore->powerPlayInSituation);
 }
 
+void nhl_cache_linescores_prefetch(Nhl *nhl, const int *game_ids, int num_games) {
+    cache_prefetch(nhl, &linescore_table, game_ids, NULL, num_games);
+}
+
 void nhl_cache_linescore_free(NhlCacheLinescore *linescore) {
     if (linescore != NULL) {
         free_meta(linescore->meta);
@@ -756,7 +1421,6 @@ void nhl_cache_linescore_free(NhlCacheLinescore *linescore) {
 
 
 /*** Periods ***/
-static const char period_table[] = "Periods";
 static const NhlCacheColumn period_columns[] = {
     {"game",            "INTEGER"},
     {"periodIndex",     "INTEGER"},
@@ -772,91 +1436,67 @@ static const NhlCacheColumn period_columns[] = {
     {"homeShotsOnGoal", "INTEGER"},
     {"homeRinkSide",    "TEXT"},
     {"_source",         "INTEGER"},
-    {"_timestamp",      "TEXT"},
+    {"_timestamp",      "INTEGER"},
     {"_invalid",        "INTEGER"},
     {0}
 };
+static const NhlCacheTable period_table = {
+    NHL_CACHE_TABLE_PERIODS, "Periods", period_columns, "game", NULL,
+    "game, periodIndex", NULL
+};
 
-NhlStatus nhl_cache_periods_reset(Nhl *nhl, int game_id) {
-    char *sql = sqlite3_mprintf("DELETE FROM %Q WHERE game=%d", period_table, game_id);
-    ensure_table(nhl, period_table, period_columns);
-    sqlite3_exec(nhl->db, sql, NULL, NULL, NULL);
-    sqlite3_free(sql);
-    return NHL_CACHE_WRITE_OK;
-}
-
-NhlStatus nhl_cache_period_put(Nhl *nhl, const NhlCachePeriod *period) {
-    return cache_put(nhl, period_table, period_columns, period->meta,
-        period->game,
-        period->periodIndex,
-        period->periodType,
-        period->startTime,
-        period->endTime,
-        period->num,
-        period->ordinalNum,
-        period->awayGoals,
-        period->awayShotsOnGoal,
-        period->awayRinkSide,
-        period->homeGoals,
-        period->homeShotsOnGoal,
-        period->homeRinkSide);
+NhlStatus nhl_cache_periods_put(Nhl *nhl, int game_id, const NhlCachePeriod *periods, int num_periods) {
+    NhlStatus status = 0;
+    int source_id = num_periods > 0 ? source_to_num(nhl, periods[0].meta->source) : 0;
+    int idx;
+
+    for (idx = 0; idx != num_periods; ++idx) {
+        const NhlCachePeriod *period = &periods[idx];
+        status |= cache_put_source(nhl, &period_table, period->meta, source_id,
+            period->game,
+            period->periodIndex,
+            period->periodType,
+            period->startTime,
+            period->endTime,
+            period->num,
+            period->ordinalNum,
+            period->awayGoals,
+            period->awayShotsOnGoal,
+            period->awayRinkSide,
+            period->homeGoals,
+            period->homeShotsOnGoal,
+            period->homeRinkSide);
+    }
+    status |= cache_trim(nhl, &period_table, game_id, num_periods);
+    return status;
 }
 
-NhlCachePeriod *nhl_cache_periods_get(Nhl *nhl, int game_id, int *num_periods) {
-    char *template;
-    char *sql;
-    sqlite3_stmt *stmt;
-
-    int num_alloc = 4;
-    NhlCachePeriod *periods = malloc(num_alloc * sizeof(NhlCachePeriod));
-    *num_periods = 0;
-
-    ensure_table(nhl, period_table, period_columns);
-    template = sql_select_template(period_table, period_columns, "%d");
-    sql = sqlite3_mprintf(template, "game", game_id);
-
-    sqlite3_prepare_v2(nhl->db, sql, -1, &stmt, NULL);
-
-    while(sqlite3_step(stmt) == SQLITE_ROW) {
-        int col = 0;
-
-        if (num_alloc <= *num_periods) {
-            num_alloc *= 2;
-            periods = realloc(periods, num_alloc * sizeof(NhlCachePeriod));
-        }
-
-        periods[*num_periods].game = sqlite3_column_int(stmt, col++);
-        periods[*num_periods].periodIndex = sqlite3_column_int(stmt, col++);
-        periods[*num_periods].periodType = copy_column_text(stmt, col++);
-        periods[*num_periods].startTime = copy_column_text(stmt, col++);
-        periods[*num_periods].endTime = copy_column_text(stmt, col++);
-        periods[*num_periods].num = sqlite3_column_int(stmt, col++);
-        periods[*num_periods].ordinalNum = copy_column_text(stmt, col++);
-        periods[*num_periods].awayGoals = sqlite3_column_int(stmt, col++);
-        periods[*num_periods].awayShotsOnGoal = sqlite3_column_int(stmt, col++);
-        periods[*num_periods].awayRinkSide = copy_column_text(stmt, col++);
-        periods[*num_periods].homeGoals = sqlite3_column_int(stmt, col++);
-        periods[*num_periods].homeShotsOnGoal = sqlite3_column_int(stmt, col++);
-        periods[*num_periods].homeRinkSide = copy_column_text(stmt, col++);
-
-        periods[*num_periods].meta = malloc(sizeof(NhlCacheMeta));
-        periods[*num_periods].meta->source = copy_column_text(stmt, col);
-        periods[*num_periods].meta->timestamp = copy_column_text(stmt, col+1);
-        periods[*num_periods].meta->invalid = sqlite3_column_int(stmt, col+2);
+/* Row callback of nhl_cache_periods_get(). */
+static void read_period(Nhl *nhl, sqlite3_value **values, void *dest) {
+    NhlCachePeriod *period = dest;
+    int col = 0;
+    period->game = sqlite3_value_int(values[col++]);
+    period->periodIndex = sqlite3_value_int(values[col++]);
+    period->periodType = copy_value_text(values[col++]);
+    period->startTime = copy_value_text(values[col++]);
+    period->endTime = copy_value_text(values[col++]);
+    period->num = sqlite3_value_int(values[col++]);
+    period->ordinalNum = copy_value_text(values[col++]);
+    period->awayGoals = sqlite3_value_int(values[col++]);
+    period->awayShotsOnGoal = sqlite3_value_int(values[col++]);
+    period->awayRinkSide = copy_value_text(values[col++]);
+    period->homeGoals = sqlite3_value_int(values[col++]);
+    period->homeShotsOnGoal = sqlite3_value_int(values[col++]);
+    period->homeRinkSide = copy_value_text(values[col++]);
+    period->meta = read_value_meta(nhl, values, col);
+}
 
-        ++*num_periods;
-    }
+NhlCachePeriod *nhl_cache_periods_get(Nhl *nhl, int game_id, int *num_periods) {
+    return cache_get_all(nhl, &period_table, game_id, read_period, sizeof(NhlCachePeriod), num_periods);
+}
 
-    sqlite3_finalize(stmt);
-    sqlite3_free(sql);
-    free(template);
-    if (*num_periods != 0) {
-        periods = realloc(periods, *num_periods * sizeof(NhlCachePeriod));
-    } else {
-        free(periods);
-        periods = NULL;
-    }
-    return periods;
+void nhl_cache_periods_prefetch(Nhl *nhl, const int *game_ids, int num_games) {
+    cache_prefetch(nhl, &period_table, game_ids, NULL, num_games);
 }
 
 void nhl_cache_periods_free(NhlCachePeriod *periods, int num_periods) {
@@ -877,7 +1517,6 @@ void nhl_cache_periods_free(NhlCachePeriod *periods, int num_periods) {
 
 
 /*** Goals ***/
-static const char goal_table[] = "Goals";
 static const NhlCacheColumn goal_columns[] = {
     {"game",                "INTEGER"},
     {"goalNumber",          "INTEGER"},
@@ -903,111 +1542,87 @@ static const NhlCacheColumn goal_columns[] = {
     {"goalsHome",           "INTEGER"},
     {"team",                "INTEGER"},
     {"_source",             "INTEGER"},
-    {"_timestamp",          "TEXT"},
+    {"_timestamp",          "INTEGER"},
     {"_invalid",            "INTEGER"},
     {0}
 };
+static const NhlCacheTable goal_table = {
+    NHL_CACHE_TABLE_GOALS, "Goals", goal_columns, "game", NULL,
+    "game, goalNumber", NULL
+};
 
-NhlStatus nhl_cache_goals_reset(Nhl *nhl, int game_id) {
-    char *sql = sqlite3_mprintf("DELETE FROM %Q WHERE game=%d", goal_table, game_id);
-    ensure_table(nhl, goal_table, goal_columns);
-    sqlite3_exec(nhl->db, sql, NULL, NULL, NULL);
-    sqlite3_free(sql);
-    return NHL_CACHE_WRITE_OK;
-}
-
-NhlStatus nhl_cache_goal_put(Nhl *nhl, const NhlCacheGoal *goal) {
-    return cache_put(nhl, goal_table, goal_columns, goal->meta,
-        goal->game,
-        goal->goalNumber,
-        goal->scorer,
-        goal->scorerSeasonTotal,
-        goal->assist1,
-        goal->assist1SeasonTotal,
-        goal->assist2,
-        goal->assist2SeasonTotal,
-        goal->goalie,
-        goal->secondaryType,
-        goal->strengthCode,
-        goal->strengthName,
-        goal->gameWinningGoal,
-        goal->emptyNet,
-        goal->period,
-        goal->periodType,
-        goal->ordinalNum,
-        goal->periodTime,
-        goal->periodTimeRemaining,
-        goal->dateTime,
-        goal->goalsAway,
-        goal->goalsHome,
-        goal->team);
+NhlStatus nhl_cache_goals_put(Nhl *nhl, int game_id, const NhlCacheGoal *goals, int num_goals) {
+    NhlStatus status = 0;
+    int source_id = num_goals > 0 ? source_to_num(nhl, goals[0].meta->source) : 0;
+    int idx;
+
+    for (idx = 0; idx != num_goals; ++idx) {
+        const NhlCacheGoal *goal = &goals[idx];
+        status |= cache_put_source(nhl, &goal_table, goal->meta, source_id,
+            goal->game,
+            goal->goalNumber,
+            goal->scorer,
+            goal->scorerSeasonTotal,
+            goal->assist1,
+            goal->assist1SeasonTotal,
+            goal->assist2,
+            goal->assist2SeasonTotal,
+            goal->goalie,
+            goal->secondaryType,
+            goal->strengthCode,
+            goal->strengthName,
+            goal->gameWinningGoal,
+            goal->emptyNet,
+            goal->period,
+            goal->periodType,
+            goal->ordinalNum,
+            goal->periodTime,
+            goal->periodTimeRemaining,
+            goal->dateTime,
+            goal->goalsAway,
+            goal->goalsHome,
+            goal->team);
+    }
+    status |= cache_trim(nhl, &goal_table, game_id, num_goals);
+    return status;
 }
 
-NhlCacheGoal *nhl_cache_goals_get(Nhl *nhl, int game_id, int *num_goals) {
-    char *template;
-    char *sql;
-    sqlite3_stmt *stmt;
-
-    int num_alloc = 4;
-    NhlCacheGoal *goals = malloc(num_alloc * sizeof(NhlCacheGoal));
-    *num_goals = 0;
-
-    ensure_table(nhl, goal_table, goal_columns);
-    template = sql_select_template(goal_table, goal_columns, "%d");
-    sql = sqlite3_mprintf(template, "game", game_id);
-
-    sqlite3_prepare_v2(nhl->db, sql, -1, &stmt, NULL);
-
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int col = 0;
-
-        if (num_alloc <= *num_goals) {
-            num_alloc *= 2;
-            goals = realloc(goals, num_alloc * sizeof(NhlCacheGoal));
-        }
+/* Row callback of nhl_cache_goals_get(). */
+static void read_goal(Nhl *nhl, sqlite3_value **values, void *dest) {
+    NhlCacheGoal *goal = dest;
+    int col = 0;
+    goal->game = sqlite3_value_int(values[col++]);
+    goal->goalNumber = sqlite3_value_int(values[col++]);
+    goal->scorer = sqlite3_value_int(values[col++]);
+    goal->scorerSeasonTotal = sqlite3_value_int(values[col++]);
+    goal->assist1 = sqlite3_value_int(values[col++]);
+    goal->assist1SeasonTotal = sqlite3_value_int(values[col++]);
+    goal->assist2 = sqlite3_value_int(values[col++]);
+    goal->assist2SeasonTotal = sqlite3_value_int(values[col++]);
+    goal->goalie = sqlite3_value_int(values[col++]);
+    goal->secondaryType = copy_value_text(values[col++]);
+    goal->strengthCode = copy_value_text(values[col++]);
+    goal->strengthName = copy_value_text(values[col++]);
+    goal->gameWinningGoal = sqlite3_value_int(values[col++]);
+    goal->emptyNet = sqlite3_value_int(values[col++]);
+    goal->period = sqlite3_value_int(values[col++]);
+    goal->periodType = copy_value_text(values[col++]);
+    goal->ordinalNum = copy_value_text(values[col++]);
+    goal->periodTime = copy_value_text(values[col++]);
+    goal->periodTimeRemaining = copy_value_text(values[col++]);
+    goal->dateTime = copy_value_text(values[col++]);
+    goal->goalsAway = sqlite3_value_int(values[col++]);
+    goal->goalsHome = sqlite3_value_int(values[col++]);
+    goal->team = sqlite3_value_int(values[col++]);
+    goal->meta = read_value_meta(nhl, values, col);
+}
 
-        goals[*num_goals].game = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].goalNumber = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].scorer = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].scorerSeasonTotal = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].assist1 = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].assist1SeasonTotal = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].assist2 = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].assist2SeasonTotal = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].goalie = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].secondaryType = copy_column_text(stmt, col++);
-        goals[*num_goals].strengthCode = copy_column_text(stmt, col++);
-        goals[*num_goals].strengthName = copy_column_text(stmt, col++);
-        goals[*num_goals].gameWinningGoal = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].emptyNet = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].period = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].periodType = copy_column_text(stmt, col++);
-        goals[*num_goals].ordinalNum = copy_column_text(stmt, col++);
-        goals[*num_goals].periodTime = copy_column_text(stmt, col++);
-        goals[*num_goals].periodTimeRemaining = copy_column_text(stmt, col++);
-        goals[*num_goals].dateTime = copy_column_text(stmt, col++);
-        goals[*num_goals].goalsAway = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].goalsHome = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].team = sqlite3_column_int(stmt, col++);
-        goals[*num_goals].meta = malloc(sizeof(NhlCacheMeta));
-
-        goals[*num_goals].meta->source = copy_column_text(stmt, col);
-        goals[*num_goals].meta->timestamp = copy_column_text(stmt, col+1);
-        goals[*num_goals].meta->invalid = sqlite3_column_int(stmt, col+2);
-
-        ++*num_goals;
-    }
+NhlCacheGoal *nhl_cache_goals_get(Nhl *nhl, int game_id, int *num_goals) {
+    return cache_get_all(nhl, &goal_table, game_id, read_goal, sizeof(NhlCacheGoal), num_goals);
+}
 
-    sqlite3_finalize(stmt);
-    sqlite3_free(sql);
-    free(template);
-    if (*num_goals != 0) {
-        goals = realloc(goals, *num_goals * sizeof(NhlCacheGoal));
-    } else {
-        free(goals);
-        goals = NULL;
-    }
-    return goals;
+void nhl_cache_goals_prefetch(Nhl *nhl, const int *game_ids, int num_games) {
+    cache_prefetch(nhl, &goal_table, game_ids, NULL, num_games);
 }
 
 void nhl_cache_goals_free(NhlCacheGoal *goals, int num_goals) {
@@ -1030,7 +1645,6 @@ void nhl_cache_goals_free(NhlCacheGoal *goals, int num_goals) {
 
 
 /*** Conferences ***/
-static const char conference_table[] = "Conferences";
 static const NhlCacheColumn conference_columns[] = {
     {"id",           "INTEGER PRIMARY KEY"},
     {"name",         "TEXT"},
@@ -1038,13 +1652,16 @@ static const NhlCacheColumn conference_columns[] = {
     {"shortName",    "TEXT"},
     {"active",       "INTEGER"},
     {"_source",      "INTEGER"},
-    {"_timestamp",   "TEXT"},
+    {"_timestamp",   "INTEGER"},
     {"_invalid",     "INTEGER"},
     {0}
 };
+static const NhlCacheTable conference_table = {
+    NHL_CACHE_TABLE_CONFERENCES, "Conferences", conference_columns, "id", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_conference_put(Nhl *nhl, const NhlCacheConference *conference) {
-    return cache_put(nhl, conference_table, conference_columns, conference->meta,
+    return cache_put(nhl, &conference_table, conference->meta,
         conference->id,
         conference->name,
         conference->abbreviation,
@@ -1054,7 +1671,7 @@ NhlStatus nhl_cache_conference_put(Nhl *nhl, const NhlCacheConference *conferenc
 
 NhlCacheConference *nhl_cache_conference_get(Nhl *nhl, int conference_id) {
     NhlCacheConference *conference = malloc(sizeof(NhlCacheConference));
-    int success = cache_get(nhl, conference_table, conference_columns, "id", &conference_id,
+    int success = cache_get(nhl, &conference_table, &conference_id,
         &conference->id,
         &conference->name,
         &conference->abbreviation,
@@ -1068,6 +1685,10 @@ NhlCacheConference *nhl_cache_conference_get(Nhl *nhl, int conference_id) {
     return conference;
 }
 
+void nhl_cache_conferences_prefetch(Nhl *nhl, const int *conference_ids, int num_conferences) {
+    cache_prefetch(nhl, &conference_table, conference_ids, NULL, num_conferences);
+}
+
 void nhl_cache_conference_free(NhlCacheConference *conference) {
     if (conference != NULL) {
         free_meta(conference->meta);
@@ -1080,7 +1701,6 @@ void nhl_cache_conference_free(NhlCacheConference *conference) {
 
 
 /*** Divisions ***/
-static const char division_table[] = "Divisions";
 static const NhlCacheColumn division_columns[] = {
     {"id",           "INTEGER PRIMARY KEY"},
     {"name",         "TEXT"},
@@ -1089,13 +1709,16 @@ static const NhlCacheColumn division_columns[] = {
     {"conference",   "INTEGER"},
     {"active",       "INTEGER"},
     {"_source",      "INTEGER"},
-    {"_timestamp",   "TEXT"},
+    {"_timestamp",   "INTEGER"},
     {"_invalid",     "INTEGER"},
     {0}
 };
+static const NhlCacheTable division_table = {
+    NHL_CACHE_TABLE_DIVISIONS, "Divisions", division_columns, "id", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_division_put(Nhl *nhl, const NhlCacheDivision *division) {
-    return cache_put(nhl, division_table, division_columns, division->meta,
+    return cache_put(nhl, &division_table, division->meta,
         division->id,
         division->name,
         division->nameShort,
@@ -1106,7 +1729,7 @@ NhlStatus nhl_cache_division_put(Nhl *nhl, const NhlCacheDivision *division) {
 
 NhlCacheDivision *nhl_cache_division_get(Nhl *nhl, int division_id) {
     NhlCacheDivision *division = malloc(sizeof(NhlCacheDivision));
-    int success = cache_get(nhl, division_table, division_columns, "id", &division_id,
+    int success = cache_get(nhl, &division_table, &division_id,
         &division->id,
         &division->name,
         &division->nameShort,
@@ -1121,6 +1744,10 @@ NhlCacheDivision *nhl_cache_division_get(Nhl *nhl, int division_id) {
     return division;
 }
 
+void nhl_cache_divisions_prefetch(Nhl *nhl, const int *division_ids, int num_divisions) {
+    cache_prefetch(nhl, &division_table, division_ids, NULL, num_divisions);
+}
+
 void nhl_cache_division_free(NhlCacheDivision *division) {
     if (division != NULL) {
         free_meta(division->meta);
@@ -1133,7 +1760,6 @@ void nhl_cache_division_free(NhlCacheDivision *division) {
 
 
 /*** Players ***/
-static const char player_table[] = "Players";
 static const NhlCacheColumn player_columns[] = {
     {"id",                 "INTEGER PRIMARY KEY"},
     {"fullName",           "TEXT"},
@@ -1156,13 +1782,16 @@ static const NhlCacheColumn player_columns[] = {
     {"currentTeam",        "INTEGER"},
     {"primaryPosition",    "TEXT"},
     {"_source",            "INTEGER"},
-    {"_timestamp",         "TEXT"},
+    {"_timestamp",         "INTEGER"},
     {"_invalid",           "INTEGER"},
     {0}
 };
+static const NhlCacheTable player_table = {
+    NHL_CACHE_TABLE_PLAYERS, "Players", player_columns, "id", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_player_put(Nhl *nhl, const NhlCachePlayer *player) {
-    return cache_put(nhl, player_table, player_columns, player->meta,
+    return cache_put(nhl, &player_table, player->meta,
         player->id,
         player->fullName,
         player->firstName,
@@ -1187,7 +1816,7 @@ NhlStatus nhl_cache_player_put(Nhl *nhl, const NhlCachePlayer *player) {
 
 NhlCachePlayer *nhl_cache_player_get(Nhl *nhl, int player_id) {
     NhlCachePlayer *player = malloc(sizeof(NhlCachePlayer));
-    int success = cache_get(nhl, player_table, player_columns, "id", &player_id,
+    int success = cache_get(nhl, &player_table, &player_id,
         &player->id,
         &player->fullName,
         &player->firstName,
@@ -1216,6 +1845,10 @@ NhlCachePlayer *nhl_cache_player_get(Nhl *nhl, int player_id) {
     return player;
 }
 
+void nhl_cache_players_prefetch(Nhl *nhl, const int *player_ids, int num_players) {
+    cache_prefetch(nhl, &player_table, player_ids, NULL, num_players);
+}
+
 void nhl_cache_player_free(NhlCachePlayer *player) {
     if (player != NULL) {
         free_meta(player->meta);
@@ -1238,20 +1871,22 @@ void nhl_cache_player_free(NhlCachePlayer *player) {
 
 
 /*** Positions ***/
-static const char position_table[] = "Positions";
 static const NhlCacheColumn position_columns[] = {
     {"abbrev",     "TEXT"},
     {"code",       "TEXT PRIMARY KEY"},
     {"fullName",   "TEXT"},
     {"type",       "TEXT"},
     {"_source",    "INTEGER"},
-    {"_timestamp", "TEXT"},
+    {"_timestamp", "INTEGER"},
     {"_invalid",   "INTEGER"},
     {0}
 };
+static const NhlCacheTable position_table = {
+    NHL_CACHE_TABLE_POSITIONS, "Positions", position_columns, "code", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_position_put(Nhl *nhl, const NhlCachePosition *position) {
-    return cache_put(nhl, position_table, position_columns, position->meta,
+    return cache_put(nhl, &position_table, position->meta,
         position->abbrev,
         position->code,
         position->fullName,
@@ -1260,7 +1895,7 @@ NhlStatus nhl_cache_position_put(Nhl *nhl, const NhlCachePosition *position) {
 
 NhlCachePosition *nhl_cache_position_get(Nhl *nhl, const char *position_code) {
     NhlCachePosition *position = malloc(sizeof(NhlCachePosition));
-    int success = cache_get(nhl, position_table, position_columns, "code", position_code,
+    int success = cache_get(nhl, &position_table, position_code,
         &position->abbrev,
         &position->code,
         &position->fullName,
@@ -1286,25 +1921,27 @@ void nhl_cache_position_free(NhlCachePosition *position) {
 
 
 /*** Roster statuses ***/
-static const char rosterst_table[] = "RosterStatuses";
 static const NhlCacheColumn rosterst_columns[] = {
     {"code",        "TEXT PRIMARY KEY"},
     {"description", "TEXT"},
     {"_source",     "INTEGER"},
-    {"_timestamp",  "TEXT"},
+    {"_timestamp",  "INTEGER"},
     {"_invalid",    "INTEGER"},
     {0}
 };
+static const NhlCacheTable rosterst_table = {
+    NHL_CACHE_TABLE_ROSTER_STATUSES, "RosterStatuses", rosterst_columns, "code", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_roster_status_put(Nhl *nhl, const NhlCacheRosterStatus *rosterst) {
-    return cache_put(nhl, rosterst_table, rosterst_columns, rosterst->meta,
+    return cache_put(nhl, &rosterst_table, rosterst->meta,
         rosterst->code,
         rosterst->description);
 }
 
 NhlCacheRosterStatus *nhl_cache_roster_status_get(Nhl *nhl, const char *roster_status_code) {
     NhlCacheRosterStatus *rosterst = malloc(sizeof(NhlCacheRosterStatus));
-    int success = cache_get(nhl, rosterst_table, rosterst_columns, "code", roster_status_code,
+    int success = cache_get(nhl, &rosterst_table, roster_status_code,
         &rosterst->code,
         &rosterst->description,
         &rosterst->meta);
@@ -1326,7 +1963,6 @@ void nhl_cache_roster_status_free(NhlCacheRosterStatus *rosterst) {
 
 
 /*** Teams ***/
-static const char team_table[] = "Teams";
 static const NhlCacheColumn team_columns[] = {
     {"id",               "INTEGER PRIMARY KEY"},
     {"name",             "TEXT"},
@@ -1341,13 +1977,16 @@ static const NhlCacheColumn team_columns[] = {
     {"officialSiteUrl",  "TEXT"},
     {"active",           "INTEGER"},
     {"_source",          "INTEGER"},
-    {"_timestamp",       "TEXT"},
+    {"_timestamp",       "INTEGER"},
     {"_invalid",         "INTEGER"},
     {0}
 };
+static const NhlCacheTable team_table = {
+    NHL_CACHE_TABLE_TEAMS, "Teams", team_columns, "id", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_team_put(Nhl *nhl, const NhlCacheTeam *team) {
-    return cache_put(nhl, team_table, team_columns, team->meta,
+    return cache_put(nhl, &team_table, team->meta,
         team->id,
         team->name,
         team->abbreviation,
@@ -1364,7 +2003,7 @@ NhlStatus nhl_cache_team_put(Nhl *nhl, const NhlCacheTeam *team) {
 
 NhlCacheTeam *nhl_cache_team_get(Nhl *nhl, int team_id) {
     NhlCacheTeam *team = malloc(sizeof(NhlCacheTeam));
-    int success = cache_get(nhl, team_table, team_columns, "id", &team_id,
+    int success = cache_get(nhl, &team_table, &team_id,
         &team->id,
         &team->name,
         &team->abbreviation,
@@ -1385,6 +2024,10 @@ NhlCacheTeam *nhl_cache_team_get(Nhl *nhl, int team_id) {
     return team;
 }
 
+void nhl_cache_teams_prefetch(Nhl *nhl, const int *team_ids, int num_teams) {
+    cache_prefetch(nhl, &team_table, team_ids, NULL, num_teams);
+}
+
 void nhl_cache_team_free(NhlCacheTeam *team) {
     if (team != NULL) {
         free_meta(team->meta);
@@ -1401,7 +2044,6 @@ void nhl_cache_team_free(NhlCacheTeam *team) {
 
 
 /*** Franchises ***/
-static const char franchise_table[] = "Franchises";
 static const NhlCacheColumn franchise_columns[] = {
     {"franchiseId",      "INTEGER PRIMARY KEY"},
     {"firstSeasonId",    "INTEGER"},
@@ -1410,13 +2052,16 @@ static const NhlCacheColumn franchise_columns[] = {
     {"teamName",         "TEXT"},
     {"locationName",     "TEXT"},
     {"_source",          "INTEGER"},
-    {"_timestamp",       "TEXT"},
+    {"_timestamp",       "INTEGER"},
     {"_invalid",         "INTEGER"},
     {0}
 };
+static const NhlCacheTable franchise_table = {
+    NHL_CACHE_TABLE_FRANCHISES, "Franchises", franchise_columns, "franchiseId", NULL, NULL, NULL
+};
 
 NhlStatus nhl_cache_franchise_put(Nhl *nhl, const NhlCacheFranchise *franchise) {
-    return cache_put(nhl, franchise_table, franchise_columns, franchise->meta,
+    return cache_put(nhl, &franchise_table, franchise->meta,
         franchise->franchiseId,
         franchise->firstSeasonId,
         franchise->lastSeasonId,
@@ -1427,7 +2072,7 @@ NhlStatus nhl_cache_franchise_put(Nhl *nhl, const NhlCacheFranchise *franchise)
 
 NhlCacheFranchise *nhl_cache_franchise_get(Nhl *nhl, int franchise_id) {
     NhlCacheFranchise *franchise = malloc(sizeof(NhlCacheFranchise));
-    int success = cache_get(nhl, franchise_table, franchise_columns, "franchiseId", &franchise_id,
+    int success = cache_get(nhl, &franchise_table, &franchise_id,
         &franchise->franchiseId,
         &franchise->firstSeasonId,
         &franchise->lastSeasonId,
@@ -1442,6 +2087,10 @@ NhlCacheFranchise *nhl_cache_franchise_get(Nhl *nhl, int franchise_id) {
     return franchise;
 }
 
+void nhl_cache_franchises_prefetch(Nhl *nhl, const int *franchise_ids, int num_franchises) {
+    cache_prefetch(nhl, &franchise_table, franchise_ids, NULL, num_franchises);
+}
+
 void nhl_cache_franchise_free(NhlCacheFranchise *franchise) {
     if (franchise != NULL) {
         free_meta(franchise->meta);
@@ -1450,3 +2099,297 @@ void nhl_cache_franchise_free(NhlCacheFranchise *franchise) {
         free(franchise);
     }
 }
+
+
+/*** Responses ***/
+static const NhlCacheColumn response_columns[] = {
+    {"url",          "TEXT PRIMARY KEY"},
+    {"etag",         "TEXT"},
+    {"lastModified", "TEXT"},
+    {"digest",       "TEXT"},
+    {"size",         "INTEGER"},
+    {"_source",      "INTEGER"},
+    {"_timestamp",   "INTEGER"},
+    {"_invalid",     "INTEGER"},
+    {0}
+};
+static const NhlCacheTable response_table = {
+    NHL_CACHE_TABLE_RESPONSES, "Responses", response_columns, "url", NULL, NULL, NULL
+};
+
+NhlStatus nhl_cache_response_put(Nhl *nhl, const NhlCacheResponse *response) {
+    return cache_put(nhl, &response_table, response->meta,
+        response->url,
+        response->etag,
+        response->lastModified,
+        response->digest,
+        response->size);
+}
+
+NhlCacheResponse *nhl_cache_response_get(Nhl *nhl, const char *url) {
+    NhlCacheResponse *response = malloc(sizeof(NhlCacheResponse));
+    int success = cache_get(nhl, &response_table, url,
+        &response->url,
+        &response->etag,
+        &response->lastModified,
+        &response->digest,
+        &response->size,
+        &response->meta);
+    if (!success) {
+        free(response);
+        response = NULL;
+    }
+    return response;
+}
+
+void nhl_cache_response_free(NhlCacheResponse *response) {
+    if (response != NULL) {
+        free_meta(response->meta);
+        free(response->url);
+        free(response->etag);
+        free(response->lastModified);
+        free(response->digest);
+        free(response);
+    }
+}
+
+
+/*** Schema ***/
+static const NhlCacheTable *const cache_tables[NHL_CACHE_NUM_TABLES] = {
+    &source_table,
+    &schedule_table,
+    &game_table,
+    &gametyp_table,
+    &gamest_table,
+    &linescore_table,
+    &period_table,
+    &goal_table,
+    &conference_table,
+    &division_table,
+    &player_table,
+    &position_table,
+    &rosterst_table,
+    &team_table,
+    &franchise_table,
+    &response_table
+};
+
+NhlStatus nhl_cache_source_touch(Nhl *nhl, const NhlCacheMeta *meta) {
+    NhlStatus status = 0;
+    int source_id = source_to_num(nhl, meta->source);
+    int idx;
+
+    for (idx = 0; idx != NHL_CACHE_NUM_TABLES; ++idx) {
+        sqlite3_stmt *stmt = get_statement(nhl, cache_tables[idx], NHL_CACHE_STMT_TOUCH);
+        if (stmt != NULL) {
+            sqlite3_bind_int64(stmt, 1, (sqlite3_int64) meta->timestamp);
+            sqlite3_bind_int(stmt, 2, source_id);
+            status |= sqlite3_step(stmt) == SQLITE_DONE ? NHL_CACHE_WRITE_OK : NHL_CACHE_WRITE_ERROR;
+            release_statement(stmt);
+        }
+    }
+    return status;
+}
+
+/* Create database table, the index of its FIND column and the index of its _source column if they
+ * do not already exist. Returns zero if error occurs. */
+static int create_table(Nhl *nhl, const NhlCacheTable *table) {
+    char *clist = columns_to_string(table->columns, 0);
+    char *sql;
+    int rc;
+
+    if (table->primary_key != NULL) {
+        sql = sqlite3_mprintf("CREATE TABLE IF NOT EXISTS %Q (%s, PRIMARY KEY (%s));",
+            table->name, clist, table->primary_key);
+    } else {
+        sql = sqlite3_mprintf("CREATE TABLE IF NOT EXISTS %Q (%s);", table->name, clist);
+    }
+    rc = sqlite3_exec(nhl->db, sql, NULL, NULL, NULL);
+    sqlite3_free(sql);
+    free(clist);
+
+    if (rc == SQLITE_OK && table->find != NULL) {
+        sql = sqlite3_mprintf("CREATE INDEX IF NOT EXISTS %s_%s ON %s (%s);",
+            table->name, table->find, table->name, table->find);
+        rc = sqlite3_exec(nhl->db, sql, NULL, NULL, NULL);
+        sqlite3_free(sql);
+    }
+    if (rc == SQLITE_OK && find_column(table->columns, "_source") != NHL_CACHE_COLUMN_NOT_FOUND) {
+        sql = sqlite3_mprintf("CREATE INDEX IF NOT EXISTS %s__source ON %s (_source);",
+            table->name, table->name);
+        rc = sqlite3_exec(nhl->db, sql, NULL, NULL, NULL);
+        sqlite3_free(sql);
+    }
+    return rc == SQLITE_OK;
+}
+
+/* Create all tables and their indices that do not already exist. Returns zero if error occurs. */
+static int create_tables(Nhl *nhl) {
+    int idx;
+    for (idx = 0; idx != NHL_CACHE_NUM_TABLES; ++idx) {
+        if (!create_table(nhl, cache_tables[idx])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Schema version 1: the original table layout. Tables of older cache files were created on first
+ * access, so any of them may be missing. */
+static int migrate_v1(Nhl *nhl) {
+    return create_tables(nhl);
+}
+
+/* Recreate table with its current column definitions and copy the old rows. By default, each
+ * column is copied as is. The null-terminated array exprs can override that with pairs of column
+ * names and SQL expressions that are evaluated against the old table. Returns zero if error
+ * occurs. */
+static int rebuild_table(Nhl *nhl, const NhlCacheTable *table, const char *const *exprs) {
+    const NhlCacheColumn *col;
+    char *select = sqlite3_mprintf("%s", "");
+    char *sql;
+    int ok;
+
+    for (col = table->columns; col->name != NULL && select != NULL; ++col) {
+        const char *expr = col->name;
+        const char *const *e;
+        char *next;
+        for (e = exprs; e != NULL && *e != NULL; e += 2) {
+            if (strcmp(e[0], col->name) == 0) {
+                expr = e[1];
+            }
+        }
+        next = sqlite3_mprintf("%s%s%s", select, col == table->columns ? "" : ", ", expr);
+        sqlite3_free(select);
+        select = next;
+    }
+    if (select == NULL) {
+        return 0;
+    }
+
+    sql = sqlite3_mprintf("ALTER TABLE %s RENAME TO %s_old;", table->name, table->name);
+    ok = sqlite3_exec(nhl->db, sql, NULL, NULL, NULL) == SQLITE_OK && create_table(nhl, table);
+    sqlite3_free(sql);
+    if (ok) {
+        sql = sqlite3_mprintf("INSERT OR REPLACE INTO %s SELECT %s FROM %s_old; DROP TABLE %s_old;",
+            table->name, select, table->name, table->name);
+        ok = sqlite3_exec(nhl->db, sql, NULL, NULL, NULL) == SQLITE_OK;
+        sqlite3_free(sql);
+    }
+    sqlite3_free(select);
+
+    /* Indices were renamed along with the old table and dropped with it. */
+    return ok && create_table(nhl, table);
+}
+
+/* Schema version 2: timestamps are stored as seconds since the epoch instead of text. */
+static int migrate_v2(Nhl *nhl) {
+    static const char *const exprs[] = {
+        "_timestamp",
+        "CASE WHEN typeof(_timestamp) = 'text' "
+            "THEN CAST(strftime('%s', _timestamp) AS INTEGER) ELSE _timestamp END",
+        NULL
+    };
+    int idx;
+    for (idx = 0; idx != NHL_CACHE_NUM_TABLES; ++idx) {
+        if (cache_tables[idx] != &source_table && !rebuild_table(nhl, cache_tables[idx], exprs)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Schema version 3: index on Games.date, and composite primary keys on Periods and Goals, so
+ * that lookups by date or game do not scan whole tables. */
+static int migrate_v3(Nhl *nhl) {
+    return create_table(nhl, &game_table) &&
+           rebuild_table(nhl, &period_table, NULL) &&
+           rebuild_table(nhl, &goal_table, NULL);
+}
+
+/* Schema version 4: metadata of raw responses for conditional requests, and an index on _source
+ * in every table, so that the rows of an unchanged response are touched without scanning whole
+ * tables. */
+static int migrate_v4(Nhl *nhl) {
+    return create_tables(nhl);
+}
+
+/* Migration from version N to N+1 is at index N. Append new migrations to the end. */
+static int (*const migrations[])(Nhl *) = {
+    migrate_v1,
+    migrate_v2,
+    migrate_v3,
+    migrate_v4
+};
+static const int schema_version = sizeof(migrations) / sizeof(migrations[0]);
+
+/* Read schema version of the database, or -1 if error occurs. */
+static int read_schema_version(Nhl *nhl) {
+    sqlite3_stmt *stmt;
+    int version = -1;
+    if (sqlite3_prepare_v2(nhl->db, "PRAGMA user_version;", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            version = sqlite3_column_int(stmt, 0);
+        }
+    }
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+/* Bring database schema up to date. Each migration is run in its own transaction together with
+ * the version update. The version is read again within the transaction, so that handles opening
+ * a new file at the same time do not run the same migration twice. Returns zero if error occurs. */
+static int migrate_schema(Nhl *nhl) {
+    /* Up-to-date files are not locked, so that readers can open them while another process writes */
+    if (read_schema_version(nhl) == schema_version) {
+        return 1;
+    }
+    if (nhl->params->read_only) {
+        if (nhl->params->verbose)
+            fprintf(stderr, "Cache schema of a read-only file cannot be updated\n");
+        return 0;
+    }
+
+    for (;;) {
+        int version;
+        char *sql;
+        int ok;
+
+        if (sqlite3_exec(nhl->db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK) {
+            if (nhl->params->verbose)
+                fprintf(stderr, "Cache file is locked, cannot check schema version\n");
+            return 0;
+        }
+
+        version = read_schema_version(nhl);
+        if (version < 0 || version > schema_version) {
+            sqlite3_exec(nhl->db, "ROLLBACK;", NULL, NULL, NULL);
+            if (nhl->params->verbose)
+                fprintf(stderr, "Unsupported cache schema version %d\n", version);
+            return 0;
+        }
+        if (version == schema_version) {
+            sqlite3_exec(nhl->db, "COMMIT;", NULL, NULL, NULL);
+            return 1;
+        }
+
+        sql = sqlite3_mprintf("PRAGMA user_version = %d;", version + 1);
+        ok = migrations[version](nhl) && sqlite3_exec(nhl->db, sql, NULL, NULL, NULL) == SQLITE_OK;
+        sqlite3_free(sql);
+
+        if (!ok || sqlite3_exec(nhl->db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+            sqlite3_exec(nhl->db, "ROLLBACK;", NULL, NULL, NULL);
+            if (nhl->params->verbose)
+                fprintf(stderr, "Cache schema migration to version %d failed\n", version + 1);
+            return 0;
+        }
+    }
+}
+
+int nhl_cache_open(Nhl *nhl) {
+    nhl->statements = calloc(1, sizeof(NhlCacheStatements));
+    if (nhl->statements == NULL) {
+        return 0;
+    }
+    return migrate_schema(nhl);
+}
@@ -1,22 +1,41 @@
 #ifndef NHL_CACHE_H_
 #define NHL_CACHE_H_
 
+#include <time.h>
+
 #include "handle.h"
 
-/* Current time from SQLite. */
-const char *nhl_cache_current_time(Nhl *nhl);
+/* Create or migrate the cache schema and allocate the registry of prepared statements for the
+ * handle. Returns zero if error occurs. */
+int nhl_cache_open(Nhl *nhl);
+
+/* Finalize all prepared statements of the handle. Must be called before closing the database. */
+void nhl_cache_close(Nhl *nhl);
+
+/* Discard the rows read in advance by the prefetch functions below. The prefetch functions read the
+ * rows of many keys with few queries, so that the subsequent get functions with the same keys need
+ * no queries. Prefetched rows are discarded automatically whenever the cache is written, and when
+ * the top-level call finishes. */
+void nhl_cache_prefetch_clear(Nhl *nhl);
+
+/* Current time for timestamping new data. */
+time_t nhl_cache_current_time(const Nhl *nhl);
 
-/* Age of the given timestamp in seconds. Negative value indicates an error. */
-int nhl_cache_timestamp_age(Nhl *nhl, const char *timestamp);
+/* Age of the given timestamp in seconds. Negative value indicates an error. Within a top-level
+ * call, the age is computed against the clock read by nhl_prepare(). */
+int nhl_cache_timestamp_age(const Nhl *nhl, time_t timestamp);
 
 
 /* Common metadata struct. */
 typedef struct NhlCacheMeta {
-    char *source;    /* Original source (URL) of the data */
-    char *timestamp; /* Time when the data was read */
-    int invalid;     /* Nonzero if an inconsistency has been detected */
+    const char *source; /* Original source (URL) of the data, owned by the handle */
+    time_t timestamp;   /* Time when the data was read */
+    int invalid;        /* Nonzero if an inconsistency has been detected */
 } NhlCacheMeta;
 
+/* Metadata of any cache struct below. All of them have the metadata pointer as the first member. */
+#define nhl_cache_item_meta(item) (*(NhlCacheMeta *const *) (item))
+
 
 /* The structs correspond to tables in a cache database, and the members
  * correspond to columns in the tables. Furthermore, the member names
@@ -69,6 +88,7 @@ NhlStatus nhl_cache_game_put(Nhl *nhl, const NhlCacheGame *game);
 /* Returns an array of primary keys (gamePk). Release with free(). */
 int *nhl_cache_games_find(Nhl *nhl, const char *date, int *num_games);
 NhlCacheGame *nhl_cache_game_get(Nhl *nhl, int game_id);
+void nhl_cache_games_prefetch(Nhl *nhl, const int *game_ids, int num_games);
 void nhl_cache_game_free(NhlCacheGame *game);
 
 
@@ -82,6 +102,7 @@ typedef struct NhlCacheGameType {
 
 NhlStatus nhl_cache_game_type_put(Nhl *nhl, const NhlCacheGameType *game_type);
 NhlCacheGameType *nhl_cache_game_type_get(Nhl *nhl, const char *game_type_id);
+void nhl_cache_game_types_prefetch(Nhl *nhl, const char *const *game_type_ids, int num_game_types);
 void nhl_cache_game_type_free(NhlCacheGameType *game_type);
 
 
@@ -96,6 +117,7 @@ typedef struct NhlCacheGameStatus {
 
 NhlStatus nhl_cache_game_status_put(Nhl *nhl, const NhlCacheGameStatus *game_status);
 NhlCacheGameStatus *nhl_cache_game_status_get(Nhl *nhl, const char *game_status_code);
+void nhl_cache_game_statuses_prefetch(Nhl *nhl, const char *const *game_status_codes, int num_game_statuses);
 void nhl_cache_game_status_free(NhlCacheGameStatus *game_status);
 
 
@@ -140,6 +162,7 @@ typedef struct NhlCacheLinescore {
 
 NhlStatus nhl_cache_linescore_put(Nhl *nhl, const NhlCacheLinescore *linescore);
 NhlCacheLinescore *nhl_cache_linescore_get(Nhl *nhl, int game_id);
+void nhl_cache_linescores_prefetch(Nhl *nhl, const int *game_ids, int num_games);
 void nhl_cache_linescore_free(NhlCacheLinescore *linescore);
 
 
@@ -164,9 +187,10 @@ typedef struct NhlCachePeriod {
     char *homeRinkSide;
 } NhlCachePeriod;
 
-NhlStatus nhl_cache_periods_reset(Nhl *nhl, int game_id);
-NhlStatus nhl_cache_period_put(Nhl *nhl, const NhlCachePeriod *period);
+/* Write all periods of a game at once, and delete the periods beyond num_periods. */
+NhlStatus nhl_cache_periods_put(Nhl *nhl, int game_id, const NhlCachePeriod *periods, int num_periods);
 NhlCachePeriod *nhl_cache_periods_get(Nhl *nhl, int game_id, int *num_periods);
+void nhl_cache_periods_prefetch(Nhl *nhl, const int *game_ids, int num_games);
 void nhl_cache_periods_free(NhlCachePeriod *periods, int num_periods);
 
 
@@ -203,9 +227,10 @@ typedef struct NhlCacheGoal {
     int team;      /* Scoring team */
 } NhlCacheGoal;
 
-NhlStatus nhl_cache_goals_reset(Nhl *nhl, int game_id);
-NhlStatus nhl_cache_goal_put(Nhl *nhl, const NhlCacheGoal *goal);
+/* Write all goals of a game at once, and delete the goals beyond num_goals. */
+NhlStatus nhl_cache_goals_put(Nhl *nhl, int game_id, const NhlCacheGoal *goals, int num_goals);
 NhlCacheGoal *nhl_cache_goals_get(Nhl *nhl, int game_id, int *num_goals);
+void nhl_cache_goals_prefetch(Nhl *nhl, const int *game_ids, int num_games);
 void nhl_cache_goals_free(NhlCacheGoal *goals, int num_goals);
 
 
@@ -221,6 +246,7 @@ typedef struct NhlCacheConference {
 
 NhlStatus nhl_cache_conference_put(Nhl *nhl, const NhlCacheConference *conference);
 NhlCacheConference *nhl_cache_conference_get(Nhl *nhl, int conference_id);
+void nhl_cache_conferences_prefetch(Nhl *nhl, const int *conference_ids, int num_conferences);
 void nhl_cache_conference_free(NhlCacheConference *conference);
 
 
@@ -237,6 +263,7 @@ typedef struct NhlCacheDivision {
 
 NhlStatus nhl_cache_division_put(Nhl *nhl, const NhlCacheDivision *division);
 NhlCacheDivision *nhl_cache_division_get(Nhl *nhl, int division_id);
+void nhl_cache_divisions_prefetch(Nhl *nhl, const int *division_ids, int num_divisions);
 void nhl_cache_division_free(NhlCacheDivision *division);
 
 
@@ -267,6 +294,7 @@ typedef struct NhlCachePlayer {
 
 NhlStatus nhl_cache_player_put(Nhl *nhl, const NhlCachePlayer *player);
 NhlCachePlayer *nhl_cache_player_get(Nhl *nhl, int player_id);
+void nhl_cache_players_prefetch(Nhl *nhl, const int *player_ids, int num_players);
 void nhl_cache_player_free(NhlCachePlayer *player);
 
 
@@ -315,6 +343,7 @@ typedef struct NhlCacheTeam {
 
 NhlStatus nhl_cache_team_put(Nhl *nhl, const NhlCacheTeam *team);
 NhlCacheTeam *nhl_cache_team_get(Nhl *nhl, int team_id);
+void nhl_cache_teams_prefetch(Nhl *nhl, const int *team_ids, int num_teams);
 void nhl_cache_team_free(NhlCacheTeam *team);
 
 
@@ -331,9 +360,29 @@ typedef struct NhlCacheFranchise {
 
 NhlStatus nhl_cache_franchise_put(Nhl *nhl, const NhlCacheFranchise *franchise);
 NhlCacheFranchise *nhl_cache_franchise_get(Nhl *nhl, int franchise_id);
+void nhl_cache_franchises_prefetch(Nhl *nhl, const int *franchise_ids, int num_franchises);
 void nhl_cache_franchise_free(NhlCacheFranchise *franchise);
 
 
+/* Metadata of the latest response from a URL. All content types */
+typedef struct NhlCacheResponse {
+    NhlCacheMeta *meta;
+    char *url;          /* Requested URL (primary key) */
+    char *etag;         /* ETag header, or empty */
+    char *lastModified; /* Last-Modified header, or empty */
+    char *digest;       /* 64-bit hash of the response body in hexadecimal, or empty */
+    int size;           /* Size of the response body in bytes */
+} NhlCacheResponse;
+
+NhlStatus nhl_cache_response_put(Nhl *nhl, const NhlCacheResponse *response);
+NhlCacheResponse *nhl_cache_response_get(Nhl *nhl, const char *url);
+void nhl_cache_response_free(NhlCacheResponse *response);
+
+/* Set the timestamp of all rows whose source is meta->source to meta->timestamp. Used when the
+ * content of the source is known not to have changed. */
+NhlStatus nhl_cache_source_touch(Nhl *nhl, const NhlCacheMeta *meta);
+
+
 /* Venue. NOT USED */
 typedef struct NhlCacheVenue {
     int id;           /* Identifier (does not always exist) */
@@ -0,0 +1,22 @@
+#ifndef NHL_DESTROY_H_
+#define NHL_DESTROY_H_
+
+/* Destructors of the objects stored in the dicts of a handle. These are given to nhl_dict_create()
+ * and called once a dict no longer keeps the object. The second argument is the handle. */
+
+void nhl_schedule_destroy(void *schedule, void *nhl);
+void nhl_game_destroy(void *game, void *nhl);
+void nhl_game_status_destroy(void *game_status, void *nhl);
+void nhl_game_type_destroy(void *game_type, void *nhl);
+
+void nhl_team_destroy(void *team, void *nhl);
+void nhl_franchise_destroy(void *franchise, void *nhl);
+
+void nhl_player_destroy(void *player, void *nhl);
+void nhl_player_position_destroy(void *position, void *nhl);
+void nhl_player_roster_status_destroy(void *roster_status, void *nhl);
+
+void nhl_conference_destroy(void *conference, void *nhl);
+void nhl_division_destroy(void *division, void *nhl);
+
+#endif /* NHL_DESTROY_H_ */
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "hash.h"
 #include "mem.h"
 
 
@@ -20,97 +21,383 @@ typedef struct NhlDictItem {
     } key;
     void *val;
     int num_refs;
-    char *timestamp;
+    time_t timestamp;
+    int older;       /* Index of the previously added item with the same key, or -1 */
+    int newer;       /* Index of the next added item with the same key, or -1 */
+    int lru_prev;    /* Index of the previous unreferenced item in LRU order, or -1 */
+    int lru_next;    /* Index of the next unreferenced item in LRU order, or -1 */
+    time_t released; /* Time when the reference count dropped to zero */
 } NhlDictItem;
 
-/* Complete dict. */
+/* Complete dict. Items are stored in an array, and two open-addressing indices map keys and
+ * values to array positions. The key index only refers to the most recently added item of each
+ * key, and older duplicates are chained through the items. Index slots hold the array position
+ * plus one, so that zero marks an empty slot. */
 struct NhlDict {
     NhlDictKeyType key_type;
     NhlDictItem *items;
     int num_items;
     int num_alloc;
+    int *by_key;
+    int *by_val;
+    unsigned long num_slots; /* Power of two, at least twice num_alloc */
+
+    /* Unreferenced items, least recently used first */
+    int lru_head;
+    int lru_tail;
+    int num_unused;
+
+    int max_unused;
+    int max_age;
+    NhlDictDestroy destroy;
+    void *userdata;
 };
 
 
-NhlDict *nhl_dict_create(NhlDictKeyType key_type) {
+NhlDict *nhl_dict_create(NhlDictKeyType key_type, NhlDictDestroy destroy, void *userdata) {
     NhlDict *dict = malloc(sizeof(NhlDict));
     dict->key_type = key_type;
     dict->items = NULL;
     dict->num_items = 0;
     dict->num_alloc = 0;
+    dict->by_key = NULL;
+    dict->by_val = NULL;
+    dict->num_slots = 0;
+    dict->lru_head = -1;
+    dict->lru_tail = -1;
+    dict->num_unused = 0;
+    dict->max_unused = 0;
+    dict->max_age = -1;
+    dict->destroy = destroy;
+    dict->userdata = userdata;
     return dict;
 }
 
 void nhl_dict_delete(NhlDict *dict) {
     if (dict != NULL) {
+        if (dict->key_type == NHL_DICT_KEY_TEXT) {
+            int idx;
+            for (idx = 0; idx != dict->num_items; ++idx) {
+                free(dict->items[idx].key.text);
+            }
+        }
         free(dict->items);
+        free(dict->by_key);
+        free(dict->by_val);
         free(dict);
     }
 }
 
 
-void *nhl_dict_find(NhlDict *dict, const void *key, char **timestamp) {
-    /* Reverse loop finds the most recently added item, in case of duplicate keys. */
+/* Home slot of a key in the key index. */
+static unsigned long key_home(const NhlDict *dict, const void *key) {
+    unsigned long hash = dict->key_type == NHL_DICT_KEY_NUMERIC ?
+        nhl_hash_int(*(const int *) key) : nhl_hash_string((const char *) key);
+    return hash & (dict->num_slots - 1);
+}
+
+/* Home slot of a value in the value index. */
+static unsigned long val_home(const NhlDict *dict, const void *val) {
+    return nhl_hash_pointer(val) & (dict->num_slots - 1);
+}
+
+/* Home slot of the item referred to by a slot of the given index. */
+static unsigned long item_home(const NhlDict *dict, const int *index, unsigned long slot) {
+    const NhlDictItem *item = &dict->items[index[slot] - 1];
+    if (index == dict->by_key) {
+        return key_home(dict, dict->key_type == NHL_DICT_KEY_NUMERIC ?
+            (const void *) &item->key.num : (const void *) item->key.text);
+    }
+    return val_home(dict, item->val);
+}
+
+/* Slot of the key index where key is stored, or the empty slot where it would be stored. */
+static unsigned long key_slot(const NhlDict *dict, const void *key) {
+    unsigned long mask = dict->num_slots - 1;
+    unsigned long slot = key_home(dict, key);
+    while (dict->by_key[slot] != 0 && !key_equals(dict, dict->by_key[slot] - 1, key)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Slot of the value index where val is stored, or the empty slot where it would be stored. */
+static unsigned long val_slot(const NhlDict *dict, const void *val) {
+    unsigned long mask = dict->num_slots - 1;
+    unsigned long slot = val_home(dict, val);
+    while (dict->by_val[slot] != 0 && dict->items[dict->by_val[slot] - 1].val != val) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Empty a slot of an index, and shift later entries of the same probe sequence backwards so that
+ * no tombstones are needed. */
+static void clear_slot(NhlDict *dict, int *index, unsigned long slot) {
+    unsigned long mask = dict->num_slots - 1;
+    unsigned long next = slot;
+    for (;;) {
+        unsigned long home;
+        next = (next + 1) & mask;
+        if (index[next] == 0) {
+            break;
+        }
+        /* Entry can be moved if its home slot is not cyclically within (slot, next]. */
+        home = item_home(dict, index, next);
+        if ((slot < next) ? (home <= slot || next < home) : (home <= slot && next < home)) {
+            index[slot] = index[next];
+            slot = next;
+        }
+    }
+    index[slot] = 0;
+}
+
+/* Append unreferenced item to the end of the LRU list. */
+static void lru_push(NhlDict *dict, int idx) {
+    dict->items[idx].lru_prev = dict->lru_tail;
+    dict->items[idx].lru_next = -1;
+    if (dict->lru_tail != -1)
+        dict->items[dict->lru_tail].lru_next = idx;
+    else
+        dict->lru_head = idx;
+    dict->lru_tail = idx;
+    dict->num_unused++;
+}
+
+/* Remove item from the LRU list. */
+static void lru_unlink(NhlDict *dict, int idx) {
+    NhlDictItem *item = &dict->items[idx];
+    if (item->lru_prev != -1)
+        dict->items[item->lru_prev].lru_next = item->lru_next;
+    else
+        dict->lru_head = item->lru_next;
+    if (item->lru_next != -1)
+        dict->items[item->lru_next].lru_prev = item->lru_prev;
+    else
+        dict->lru_tail = item->lru_prev;
+    dict->num_unused--;
+}
+
+/* Allocate room for at least one more item, and rebuild the indices if they are resized. */
+static int grow(NhlDict *dict) {
     int idx;
-    for (idx = dict->num_items - 1; idx != -1; --idx)
-        if (key_equals(dict, idx, key)) {
-            dict->items[idx].num_refs++;
-            *timestamp = dict->items[idx].timestamp;
-            return dict->items[idx].val;
+    unsigned long num_slots;
+    int *by_key;
+    int *by_val;
+    NhlDictItem *items;
+
+    if (dict->num_items < dict->num_alloc) {
+        return 1;
+    }
+
+    num_slots = dict->num_slots ? 2 * dict->num_slots : 16;
+    items = realloc(dict->items, num_slots / 2 * sizeof(NhlDictItem));
+    if (items == NULL) {
+        return 0;
+    }
+    dict->items = items;
+
+    by_key = calloc(num_slots, sizeof(int));
+    by_val = calloc(num_slots, sizeof(int));
+    if (by_key == NULL || by_val == NULL) {
+        free(by_key);
+        free(by_val);
+        return 0;
+    }
+    free(dict->by_key);
+    free(dict->by_val);
+    dict->by_key = by_key;
+    dict->by_val = by_val;
+    dict->num_slots = num_slots;
+    dict->num_alloc = (int) (num_slots / 2);
+
+    for (idx = 0; idx != dict->num_items; ++idx) {
+        NhlDictItem *item = &dict->items[idx];
+        if (item->newer == -1) {
+            dict->by_key[key_slot(dict, dict->key_type == NHL_DICT_KEY_NUMERIC ?
+                (const void *) &item->key.num : (const void *) item->key.text)] = idx + 1;
         }
-    return NULL;
+        dict->by_val[val_slot(dict, item->val)] = idx + 1;
+    }
+    return 1;
 }
 
 
-int nhl_dict_insert(NhlDict *dict, const void *key, void *val, const char *timestamp) {
-    /* Grow dict if necessary */
-    if (dict->num_alloc <= dict->num_items) {
-        if (dict->num_alloc == 0)
-            dict->num_alloc = 8;
-        else
-            dict->num_alloc *= 2;
+/* Remove the idx'th item from the dict, and move the last item into its place. The item must not
+ * be in the LRU list. */
+static void remove_item(NhlDict *dict, int idx) {
+    NhlDictItem *item = &dict->items[idx];
+    int last = dict->num_items - 1;
 
-        dict->items = realloc(dict->items, dict->num_alloc * sizeof(NhlDictItem));
-        if (dict->items == NULL)
-            return 0;
+    /* Unlink from the key index or from the chain of duplicates */
+    if (item->newer == -1) {
+        unsigned long slot = key_slot(dict, dict->key_type == NHL_DICT_KEY_NUMERIC ?
+            (const void *) &item->key.num : (const void *) item->key.text);
+        if (item->older != -1) {
+            dict->by_key[slot] = item->older + 1;
+            dict->items[item->older].newer = -1;
+        } else {
+            clear_slot(dict, dict->by_key, slot);
+        }
+    } else {
+        dict->items[item->newer].older = item->older;
+        if (item->older != -1)
+            dict->items[item->older].newer = item->newer;
     }
+    clear_slot(dict, dict->by_val, val_slot(dict, item->val));
+
+    if (dict->key_type == NHL_DICT_KEY_TEXT) {
+        free(item->key.text);
+    }
+
+    /* Fill the hole with the last item, and update references to it */
+    if (idx != last) {
+        NhlDictItem *moved = item;
+        *moved = dict->items[last];
+        dict->by_val[val_slot(dict, moved->val)] = idx + 1;
+        if (moved->newer == -1) {
+            dict->by_key[key_slot(dict, dict->key_type == NHL_DICT_KEY_NUMERIC ?
+                (const void *) &moved->key.num : (const void *) moved->key.text)] = idx + 1;
+        } else {
+            dict->items[moved->newer].older = idx;
+        }
+        if (moved->older != -1) {
+            dict->items[moved->older].newer = idx;
+        }
+        if (moved->num_refs == 0) {
+            if (moved->lru_prev != -1)
+                dict->items[moved->lru_prev].lru_next = idx;
+            else
+                dict->lru_head = idx;
+            if (moved->lru_next != -1)
+                dict->items[moved->lru_next].lru_prev = idx;
+            else
+                dict->lru_tail = idx;
+        }
+    }
+    dict->num_items--;
+}
+
+
+void *nhl_dict_find(NhlDict *dict, const void *key, time_t *timestamp) {
+    /* The key index refers to the most recently added item, in case of duplicate keys. */
+    if (dict->num_items != 0) {
+        int pos = dict->by_key[key_slot(dict, key)];
+        if (pos != 0) {
+            NhlDictItem *item = &dict->items[pos - 1];
+            if (item->num_refs++ == 0)
+                lru_unlink(dict, pos - 1);
+            *timestamp = item->timestamp;
+            return item->val;
+        }
+    }
+    return NULL;
+}
+
+
+int nhl_dict_insert(NhlDict *dict, const void *key, void *val, time_t timestamp) {
+    NhlDictItem *item;
+    unsigned long slot;
+    int idx = dict->num_items;
+    void *shadowed = NULL;
+
+    if (!grow(dict))
+        return 0;
+
+    item = &dict->items[idx];
 
     /* Copy key */
     if (dict->key_type == NHL_DICT_KEY_NUMERIC)
-        dict->items[dict->num_items].key.num = *(int *) key;
+        item->key.num = *(int *) key;
     else
-        dict->items[dict->num_items].key.text = nhl_copy_string((char *) key);
+        item->key.text = nhl_copy_string((char *) key);
+
+    item->val = val;
+    item->num_refs = 1;
+    item->timestamp = timestamp;
+    item->newer = -1;
+
+    /* New item replaces the older duplicate in the key index. */
+    slot = key_slot(dict, key);
+    item->older = dict->by_key[slot] - 1;
+    if (item->older != -1)
+        dict->items[item->older].newer = idx;
+    dict->by_key[slot] = idx + 1;
 
-    /* Append new value to items. */
-    dict->items[dict->num_items].val = val;
-    dict->items[dict->num_items].num_refs = 1;
-    dict->items[dict->num_items].timestamp = nhl_copy_string(timestamp);
+    dict->by_val[val_slot(dict, val)] = idx + 1;
     dict->num_items++;
 
+    /* Unreferenced older duplicate can no longer be found, so there is no point in keeping it. */
+    if (item->older != -1 && dict->items[item->older].num_refs == 0) {
+        shadowed = dict->items[item->older].val;
+        lru_unlink(dict, item->older);
+        remove_item(dict, item->older);
+        dict->destroy(shadowed, dict->userdata);
+    }
+
     return 1;
 }
 
 
+/* Destroy least recently used items until at most max_items remain unused, and then destroy unused
+ * items released before the given time (if nonzero). */
+static void evict(NhlDict *dict, int max_items, time_t released_before) {
+    while (dict->lru_head != -1) {
+        int idx = dict->lru_head;
+        void *val = dict->items[idx].val;
+
+        if (dict->num_unused <= max_items &&
+                (released_before == 0 || dict->items[idx].released >= released_before)) {
+            break;
+        }
+
+        /* The item is removed before destroying the value, because the destructor may unreference
+         * other items, including items of this dict. */
+        lru_unlink(dict, idx);
+        remove_item(dict, idx);
+        dict->destroy(val, dict->userdata);
+    }
+}
+
+void nhl_dict_set_retention(NhlDict *dict, int max_items, int max_age) {
+    dict->max_unused = max_items < 0 ? 0 : max_items;
+    dict->max_age = max_age;
+    evict(dict, dict->max_unused, 0);
+}
+
+void nhl_dict_expire(NhlDict *dict, time_t now) {
+    if (dict->max_age >= 0) {
+        evict(dict, dict->max_unused, now - dict->max_age);
+    }
+}
+
+
+time_t nhl_dict_timestamp(const NhlDict *dict, const void *val) {
+    if (dict->num_items != 0) {
+        int pos = dict->by_val[val_slot(dict, val)];
+        if (pos != 0) {
+            return dict->items[pos - 1].timestamp;
+        }
+    }
+    return 0;
+}
+
 int nhl_dict_unref(NhlDict *dict, void *val) {
-    int idx;
-    for (idx = 0; idx != dict->num_items; ++idx) {
-        if (dict->items[idx].val == val) {
+    if (dict->num_items != 0) {
+        int pos = dict->by_val[val_slot(dict, val)];
+        if (pos != 0) {
             /* Decremented reference count */
-            int num_refs = --(dict->items[idx].num_refs);
+            int num_refs = --(dict->items[pos - 1].num_refs);
 
+            /* Retain the item for reuse, unless it is shadowed by a newer duplicate */
             if (num_refs == 0) {
-                int k;
-
-                /* Release resources if refcount went to zero */
-                free(dict->items[idx].timestamp);
-                if (dict->key_type == NHL_DICT_KEY_TEXT) {
-                    free(dict->items[idx].key.text);
-                }
-
-                /* Adjust dict size */
-                dict->num_items--;
-                for (k = idx; k != dict->num_items; ++k) {
-                    dict->items[k] = dict->items[k+1];
+                if (dict->items[pos - 1].newer == -1 && dict->max_unused > 0) {
+                    dict->items[pos - 1].released = time(NULL);
+                    lru_push(dict, pos - 1);
+                    evict(dict, dict->max_unused, 0);
+                } else {
+                    remove_item(dict, pos - 1);
+                    dict->destroy(val, dict->userdata);
                 }
             }
 
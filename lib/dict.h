@@ -1,6 +1,7 @@
 #ifndef NHL_DICT_H_
 #define NHL_DICT_H_
 
+#include <time.h>
 
 /* Dictionary-like type that stores (possible non-unique) keys, values and timestamps. */
 typedef struct NhlDict NhlDict;
@@ -13,22 +14,42 @@ typedef enum NhlDictKeyType {
     NHL_DICT_KEY_TEXT
 } NhlDictKeyType;
 
-/* Create new dict with the given key type. Release with nhl_dict_delete(). */
-NhlDict *nhl_dict_create(NhlDictKeyType key_type);
+/* Destructor of values, called with the value and the user data given to nhl_dict_create(). */
+typedef void (*NhlDictDestroy)(void *val, void *userdata);
 
-/* Release resources acquired with nhl_dict_create(). */
+/* Create new dict with the given key type. Values whose reference count has dropped to zero are
+ * released with destroy. Release dict with nhl_dict_delete(). */
+NhlDict *nhl_dict_create(NhlDictKeyType key_type, NhlDictDestroy destroy, void *userdata);
+
+/* Release resources acquired with nhl_dict_create(). Values that are still referenced are not
+ * destroyed. */
 void nhl_dict_delete(NhlDict *dict);
 
+/* Keep at most max_items unreferenced values for reuse, and destroy them once they have been
+ * unreferenced for more than max_age seconds (negative means no limit). The least recently used
+ * values are destroyed first. Zero max_items destroys values as soon as they are unreferenced.
+ * Excess values are destroyed immediately. */
+void nhl_dict_set_retention(NhlDict *dict, int max_items, int max_age);
+
+/* Destroy unreferenced values that have exceeded the maximum age at time now. */
+void nhl_dict_expire(NhlDict *dict, time_t now);
+
 /* Return value and timestamp for given key, and increment the reference count.
  * Returns NULL if the key does not exist.
- * In case of duplicate keys, the most recently added value is returned. */
-void *nhl_dict_find(NhlDict *dict, const void *key, char **timestamp);
+ * In case of duplicate keys, the most recently added value is returned. Retained unreferenced
+ * values are returned as well. */
+void *nhl_dict_find(NhlDict *dict, const void *key, time_t *timestamp);
+
+/* Insert key, value and timestamp, and set reference count to one. An unreferenced value with the
+ * same key is destroyed, because it can no longer be found. Returns nonzero if success. */
+int nhl_dict_insert(NhlDict *dict, const void *key, void *val, time_t timestamp);
 
-/* Insert key, value and timestamp, and set reference count to one. Returns nonzero if success. */
-int nhl_dict_insert(NhlDict *dict, const void *key, void *val, const char *timestamp);
+/* Return the timestamp of a given (unique) value, or zero if the value is not found. */
+time_t nhl_dict_timestamp(const NhlDict *dict, const void *val);
 
 /* Decrement reference count for a given (unique) value and return the decremented
- * reference count. Returns -1 if the value is not found. */
+ * reference count. Returns -1 if the value is not found. If the count drops to zero, the value is
+ * either retained or destroyed according to the retention policy. */
 int nhl_dict_unref(NhlDict *dict, void *val);
 
 
@@ -1,13 +1,17 @@
 #include <nhl/game.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <nhl/player.h>
 #include <nhl/team.h>
 #include <nhl/update.h>
 #include <nhl/utils.h>
+#include "arena.h"
 #include "cache.h"
+#include "destroy.h"
 #include "dict.h"
 #include "get.h"
 #include "handle.h"
@@ -33,19 +37,390 @@ static void delete_schedule(NhlSchedule *schedule) {
     }
 }
 
-/* Generate schedule URL based on date. The returned string must be released with free().
+/* Generate schedule URL based on date. The returned string must be released with free(). Returns
+ * NULL if out of memory.
  * NOTE: Currently, both expands (linescore, scoringPlays) are activated.*/
 static char *schedule_url(const NhlDate *date) {
     size_t base_len = strlen(NHL_URL_PREFIX_SCHEDULE);
     char *date_str = nhl_date_to_string(date);
-    size_t date_len = strlen(date_str);
-    char *url = malloc(base_len + date_len + 1);
-    memcpy(url, NHL_URL_PREFIX_SCHEDULE, base_len);
-    memcpy(url + base_len, date_str, date_len + 1);
+    size_t date_len = date_str != NULL ? strlen(date_str) : 0;
+    char *url = date_str != NULL ? malloc(base_len + date_len + 1) : NULL;
+    if (url != NULL) {
+        memcpy(url, NHL_URL_PREFIX_SCHEDULE, base_len);
+        memcpy(url + base_len, date_str, date_len + 1);
+    }
     free(date_str);
     return url;
 }
 
+/* Generate URL for the schedules of all dates between first and last (inclusive). The returned
+ * string must be released with free(). Returns NULL if out of memory. */
+static char *schedule_range_url(const NhlDate *first, const NhlDate *last) {
+    size_t base_len = strlen(NHL_URL_PREFIX_SCHEDULE_RANGE);
+    size_t infix_len = strlen(NHL_URL_INFIX_SCHEDULE_RANGE);
+    char *first_str = nhl_date_to_string(first);
+    char *last_str = nhl_date_to_string(last);
+    size_t first_len = first_str != NULL ? strlen(first_str) : 0;
+    size_t last_len = last_str != NULL ? strlen(last_str) : 0;
+    char *url = first_str != NULL && last_str != NULL ?
+                malloc(base_len + first_len + infix_len + last_len + 1) : NULL;
+    char *pos = url;
+    if (url != NULL) {
+        memcpy(pos, NHL_URL_PREFIX_SCHEDULE_RANGE, base_len);
+        memcpy(pos += base_len, first_str, first_len);
+        memcpy(pos += first_len, NHL_URL_INFIX_SCHEDULE_RANGE, infix_len);
+        memcpy(pos += infix_len, last_str, last_len + 1);
+    }
+    free(first_str);
+    free(last_str);
+    return url;
+}
+
+/* Returns nonzero if the game status code is known to mean a finished game. */
+static int is_final_status(Nhl *nhl, const char *status_code) {
+    NhlCacheGameStatus *game_status = status_code != NULL ? nhl_cache_game_status_get(nhl, status_code) : NULL;
+    int final = game_status != NULL && game_status->abstractGameState != NULL &&
+                strcmp(game_status->abstractGameState, "Final") == 0;
+    nhl_cache_game_status_free(game_status);
+    return final;
+}
+
+/* Game states that determine how often the game data is refreshed. */
+typedef enum NhlGameAgeState {
+    NHL_GAME_CURRENT, /* live, or starting within a day */
+    NHL_GAME_FINAL,   /* finished */
+    NHL_GAME_FUTURE   /* starting in more than a day */
+} NhlGameAgeState;
+
+/* Date in UTC at the given time. The date is computed from the number of days since the epoch (see
+ * http://howardhinnant.github.io/date_algorithms.html), because gmtime() is not reentrant. */
+static NhlDate utc_date(time_t timestamp) {
+    long days = (long) (timestamp / 86400) + 719468; /* days since 0000-03-01 */
+    long era = days / 146097;
+    long doe = days - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    NhlDate today;
+
+    today.day = (int) (doy - (153 * mp + 2) / 5 + 1);
+    today.month = (int) (mp < 10 ? mp + 3 : mp - 9);
+    today.year = (int) (yoe + era * 400 + (today.month <= 2));
+    return today;
+}
+
+/* Current date in UTC. */
+static NhlDate current_date(Nhl *nhl) {
+    return utc_date(nhl_cache_current_time(nhl));
+}
+
+/* State of a game that is (final or not) and starts on start_date. */
+static NhlGameAgeState game_age_state(Nhl *nhl, int final, const NhlDate *start_date) {
+    NhlDate today = current_date(nhl);
+    NhlDate tomorrow = nhl_date_next(&today);
+    if (final) {
+        return NHL_GAME_FINAL;
+    }
+    return nhl_date_compare(start_date, &tomorrow) > 0 ? NHL_GAME_FUTURE : NHL_GAME_CURRENT;
+}
+
+/* State of a game. The state is read from the dict if possible. */
+static NhlGameAgeState game_state(Nhl *nhl, int game_id) {
+    time_t timestamp;
+    NhlGame *game = nhl_dict_find(nhl->games, &game_id, &timestamp);
+    NhlCacheGame *cache_game;
+    NhlGameAgeState state = NHL_GAME_CURRENT;
+
+    if (game != NULL && game->status != NULL) {
+        int final = game->status->abstract_state != NULL && strcmp(game->status->abstract_state, "Final") == 0;
+        state = game_age_state(nhl, final, &game->start_time.date);
+        nhl_game_unget(nhl, game);
+        return state;
+    }
+    nhl_game_unget(nhl, game);
+
+    cache_game = nhl_cache_game_get(nhl, game_id);
+    if (cache_game != NULL) {
+        NhlDateTime start_time = nhl_string_to_datetime(cache_game->gameDate);
+        state = game_age_state(nhl, is_final_status(nhl, cache_game->statusCode), &start_time.date);
+        nhl_cache_game_free(cache_game);
+    }
+    return state;
+}
+
+/* Maximum age of a game according to its state. */
+static int game_max_age(Nhl *nhl, int game_id) {
+    switch (game_state(nhl, game_id)) {
+        case NHL_GAME_FINAL:
+            return nhl->params->game_final_max_age;
+        case NHL_GAME_FUTURE:
+            return nhl->params->game_future_max_age;
+        default:
+            return nhl->params->game_live_max_age;
+    }
+}
+
+/* Read the cache rows of games and of the objects linked from them (teams with their franchises,
+ * divisions and conferences, game statuses and types, and the linescores, periods and goals needed
+ * by the query level) with a constant number of queries, so that getting the games one by one
+ * afterwards needs no further queries. */
+static void prefetch_games(Nhl *nhl, const int *game_ids, int num_games, NhlQueryLevel level) {
+    int *team_ids = malloc(2 * num_games * sizeof(int));
+    int *franchise_ids = malloc(2 * num_games * sizeof(int));
+    int *division_ids = malloc(2 * num_games * sizeof(int));
+    int *conference_ids = malloc(2 * num_games * sizeof(int));
+    NhlCacheGame **cache_games = calloc(num_games, sizeof(NhlCacheGame *));
+    const char **status_codes = calloc(num_games, sizeof(char *));
+    const char **type_codes = calloc(num_games, sizeof(char *));
+    int num_teams = 0;
+    int idx;
+
+    if (team_ids == NULL || franchise_ids == NULL || division_ids == NULL || conference_ids == NULL ||
+            cache_games == NULL || status_codes == NULL || type_codes == NULL) {
+        goto cleanup;
+    }
+
+    nhl_cache_games_prefetch(nhl, game_ids, num_games);
+    if (level & NHL_QUERY_GAMEDETAILS) {
+        nhl_cache_linescores_prefetch(nhl, game_ids, num_games);
+        nhl_cache_periods_prefetch(nhl, game_ids, num_games);
+    }
+    if (level & NHL_QUERY_GOALS) {
+        nhl_cache_goals_prefetch(nhl, game_ids, num_games);
+    }
+    for (idx = 0; idx != num_games; ++idx) {
+        cache_games[idx] = nhl_cache_game_get(nhl, game_ids[idx]);
+        if (cache_games[idx] != NULL) {
+            team_ids[num_teams++] = cache_games[idx]->awayTeam;
+            team_ids[num_teams++] = cache_games[idx]->homeTeam;
+            status_codes[idx] = cache_games[idx]->statusCode;
+            type_codes[idx] = cache_games[idx]->gameType;
+        }
+    }
+    nhl_cache_game_statuses_prefetch(nhl, status_codes, num_games);
+    nhl_cache_game_types_prefetch(nhl, type_codes, num_games);
+
+    nhl_cache_teams_prefetch(nhl, team_ids, num_teams);
+    for (idx = 0; idx != num_teams; ++idx) {
+        NhlCacheTeam *cache_team = nhl_cache_team_get(nhl, team_ids[idx]);
+        franchise_ids[idx] = cache_team != NULL ? cache_team->franchise : 0;
+        division_ids[idx] = cache_team != NULL ? cache_team->division : 0;
+        conference_ids[idx] = cache_team != NULL ? cache_team->conference : 0;
+        nhl_cache_team_free(cache_team);
+    }
+    nhl_cache_franchises_prefetch(nhl, franchise_ids, num_teams);
+    nhl_cache_divisions_prefetch(nhl, division_ids, num_teams);
+    nhl_cache_conferences_prefetch(nhl, conference_ids, num_teams);
+
+cleanup:
+    if (cache_games != NULL) {
+        for (idx = 0; idx != num_games; ++idx) {
+            nhl_cache_game_free(cache_games[idx]);
+        }
+    }
+    free(type_codes);
+    free(status_codes);
+    free(cache_games);
+    free(conference_ids);
+    free(division_ids);
+    free(franchise_ids);
+    free(team_ids);
+}
+
+/* Add player_id to the set of num_ids distinct ids. Zero stands for no player and is ignored. */
+static void add_player_id(int *ids, int *num_ids, int player_id) {
+    int idx;
+    if (player_id == 0) {
+        return;
+    }
+    for (idx = 0; idx != *num_ids; ++idx) {
+        if (ids[idx] == player_id) {
+            return;
+        }
+    }
+    ids[(*num_ids)++] = player_id;
+}
+
+/* Download the players of the goals of games that are missing from the cache or too old, all at
+ * once, and read their cache rows in advance. Otherwise, getting the goals one by one would
+ * download each player separately. The goals are read from the rows prefetched by
+ * prefetch_games(), if any. */
+static NhlStatus prefetch_players(Nhl *nhl, const int *game_ids, int num_games) {
+    NhlStatus status = 0;
+    int max_age = nhl->params->player_max_age;
+    int *player_ids = NULL;
+    int num_players = 0;
+    char **urls = NULL;
+    int num_urls = 0;
+    int idx;
+
+    for (idx = 0; idx != num_games; ++idx) {
+        int num_goals = 0;
+        NhlCacheGoal *cache_goals = nhl_cache_goals_get(nhl, game_ids[idx], &num_goals);
+        int *ids = realloc(player_ids, (num_players + 4 * num_goals + 1) * sizeof(int));
+        int goal;
+        if (ids == NULL) {
+            nhl_cache_goals_free(cache_goals, num_goals);
+            status |= NHL_MEMORY_ERROR;
+            break;
+        }
+        player_ids = ids;
+        for (goal = 0; goal != num_goals; ++goal) {
+            add_player_id(player_ids, &num_players, cache_goals[goal].scorer);
+            add_player_id(player_ids, &num_players, cache_goals[goal].assist1);
+            add_player_id(player_ids, &num_players, cache_goals[goal].assist2);
+            add_player_id(player_ids, &num_players, cache_goals[goal].goalie);
+        }
+        nhl_cache_goals_free(cache_goals, num_goals);
+    }
+
+    if (num_players == 0) {
+        free(player_ids);
+        return status;
+    }
+
+    urls = malloc(num_players * sizeof(char *));
+    if (urls == NULL) {
+        status |= NHL_MEMORY_ERROR;
+    }
+    nhl_cache_players_prefetch(nhl, player_ids, num_players);
+    for (idx = 0; urls != NULL && idx != num_players; ++idx) {
+        NhlCachePlayer *cache_player = nhl_cache_player_get(nhl, player_ids[idx]);
+        int age = cache_player != NULL ? nhl_cache_timestamp_age(nhl, cache_player->meta->timestamp) : -1;
+        if (age < 0 || (max_age >= 0 && age > max_age)) {
+            char *url = malloc(sizeof(NHL_URL_PREFIX_PEOPLE) + 1 + NHL_INTSTR_LEN + 1);
+            if (url != NULL) {
+                sprintf(url, "%s/%d", NHL_URL_PREFIX_PEOPLE, player_ids[idx]);
+                urls[num_urls++] = url;
+            } else {
+                status |= NHL_MEMORY_ERROR;
+            }
+        }
+        nhl_cache_player_free(cache_player);
+    }
+
+    /* Writing to the cache discards the rows read in advance, so read them again */
+    if (num_urls > 0) {
+        status |= nhl_update_from_urls(nhl, (const char *const *) urls, num_urls, NHL_CONTENT_PEOPLE);
+        nhl_cache_players_prefetch(nhl, player_ids, num_players);
+    }
+
+    for (idx = 0; idx != num_urls; ++idx) {
+        free(urls[idx]);
+    }
+    free(urls);
+    free(player_ids);
+    return status;
+}
+
+/* Maximum age of a game of a schedule according to its state. Schedules with games in progress
+ * are refreshed as often as schedules in general. */
+static int schedule_game_max_age(Nhl *nhl, NhlGameAgeState state) {
+    switch (state) {
+        case NHL_GAME_FINAL:
+            return nhl->params->game_final_max_age;
+        case NHL_GAME_FUTURE:
+            return nhl->params->game_future_max_age;
+        default:
+            return nhl->params->schedule_max_age;
+    }
+}
+
+/* Maximum age of a schedule without games, fetched at timestamp. The day is final only if it was
+ * already over when the schedule was fetched, because games may be published late. Dates are North
+ * American, so the day is surely over after the next day has begun in UTC. */
+static int empty_schedule_max_age(Nhl *nhl, const NhlDate *date, time_t timestamp) {
+    NhlDate next = nhl_date_next(date);
+    NhlDate fetched = utc_date(timestamp);
+    if (nhl_date_compare(&next, &fetched) < 0) {
+        return nhl->params->game_final_max_age;
+    } else if (game_age_state(nhl, 0, date) == NHL_GAME_FUTURE) {
+        return nhl->params->game_future_max_age;
+    }
+    return nhl->params->schedule_max_age;
+}
+
+/* Maximum age of a schedule whose games have been loaded. No queries are needed. */
+static int loaded_schedule_max_age(Nhl *nhl, const NhlSchedule *schedule, time_t timestamp) {
+    int max_age = nhl->params->schedule_max_age;
+    int idx;
+
+    if (schedule->num_games == 0) {
+        return empty_schedule_max_age(nhl, &schedule->date, timestamp);
+    }
+    for (idx = 0; idx != schedule->num_games; ++idx) {
+        const NhlGame *game = schedule->games[idx];
+        NhlGameAgeState state = NHL_GAME_CURRENT;
+        int game_age;
+        if (game != NULL && game->status != NULL) {
+            int final = game->status->abstract_state != NULL && strcmp(game->status->abstract_state, "Final") == 0;
+            state = game_age_state(nhl, final, &game->start_time.date);
+        }
+        game_age = schedule_game_max_age(nhl, state);
+        max_age = idx == 0 ? game_age : nhl_min_age(max_age, game_age);
+    }
+    return max_age;
+}
+
+/* Maximum age of a cached schedule (or NULL if not cached) of date. */
+static int cached_schedule_max_age(Nhl *nhl, const NhlDate *date, const NhlCacheSchedule *cache_schedule) {
+    int max_age = nhl->params->schedule_max_age;
+    int num_games = 0;
+    int *game_ids;
+    int idx;
+
+    if (cache_schedule == NULL) {
+        return max_age;
+    }
+    game_ids = nhl_cache_games_find(nhl, cache_schedule->date, &num_games);
+    if (num_games == 0) {
+        max_age = empty_schedule_max_age(nhl, date, cache_schedule->meta->timestamp);
+    } else {
+        prefetch_games(nhl, game_ids, num_games, 0);
+    }
+
+    for (idx = 0; idx != num_games; ++idx) {
+        int game_age = schedule_game_max_age(nhl, game_state(nhl, game_ids[idx]));
+        max_age = idx == 0 ? game_age : nhl_min_age(max_age, game_age);
+    }
+
+    free(game_ids);
+    return max_age;
+}
+
+/* Maximum age of the schedule of date. Schedules whose games are all finished (or all far in the
+ * future) can be kept as long as the games. The age is computed from the schedule in the dict if
+ * its games have been loaded, so that warm requests need no queries. */
+static int schedule_max_age(Nhl *nhl, const NhlDate *date, const char *date_str) {
+    time_t timestamp;
+    NhlSchedule *schedule = nhl_dict_find(nhl->schedules, date_str, &timestamp);
+    NhlCacheSchedule *cache_schedule;
+    int max_age;
+
+    if (schedule != NULL && (schedule->games != NULL || schedule->num_games == 0)) {
+        max_age = loaded_schedule_max_age(nhl, schedule, timestamp);
+        nhl_schedule_unget(nhl, schedule);
+        return max_age;
+    }
+    nhl_schedule_unget(nhl, schedule);
+
+    cache_schedule = nhl_cache_schedule_get(nhl, date_str);
+    max_age = cached_schedule_max_age(nhl, date, cache_schedule);
+    nhl_cache_schedule_free(cache_schedule);
+    return max_age;
+}
+
+/* Returns nonzero if the cached schedule of date is not older than its maximum age. */
+static int schedule_is_fresh(Nhl *nhl, const NhlDate *date) {
+    char *date_str = nhl_date_to_string(date);
+    NhlCacheSchedule *cache_schedule = date_str != NULL ? nhl_cache_schedule_get(nhl, date_str) : NULL;
+    int max_age = cached_schedule_max_age(nhl, date, cache_schedule);
+    int age = cache_schedule != NULL ? nhl_cache_timestamp_age(nhl, cache_schedule->meta->timestamp) : -1;
+    nhl_cache_schedule_free(cache_schedule);
+    free(date_str);
+    return 0 <= age && (age <= max_age || max_age < 0);
+}
+
 /* Callback for getting cached schedule. */
 static NhlStatus get_cache_schedule_cb(Nhl *nhl, int update, void **dest, void *userp) {
     NhlStatus status = 0;
@@ -55,7 +430,7 @@ static NhlStatus get_cache_schedule_cb(Nhl *nhl, int update, void **dest, void *
 
     if (update) {
         char *url = schedule_url(date);
-        status |= nhl_update_from_url(nhl, url, NHL_CONTENT_SCHEDULE);
+        status |= url != NULL ? nhl_update_from_url(nhl, url, NHL_CONTENT_SCHEDULE) : NHL_MEMORY_ERROR;
         free(url);
     }
 
@@ -93,42 +468,61 @@ NhlStatus nhl_schedule_get(Nhl *nhl, const NhlDate *date, NhlQueryLevel level, N
     NhlCacheSchedule *cache_schedule = NULL;
     NhlDate date_copy = *date;
     char *date_str = nhl_date_to_string(date);
-    NhlStatus status = nhl_get(nhl, nhl->schedules, date_str, nhl->params->schedule_max_age,
+    NhlStatus status = nhl_get(nhl, nhl->schedules, date_str, schedule_max_age(nhl, date, date_str),
         get_cache_schedule_cb, &date_copy, (void **) schedule, (void **) &cache_schedule);
+    time_t timestamp = 0;
 
     if (cache_schedule != NULL) {
         *schedule = create_schedule(cache_schedule);
-        nhl_dict_insert(nhl->schedules, date_str, *schedule, cache_schedule->meta->timestamp);
+        timestamp = cache_schedule->meta->timestamp;
+    } else if (*schedule != NULL) {
+        timestamp = nhl_dict_timestamp(nhl->schedules, *schedule);
     }
 
+    /* Games are collected into a new schedule, which replaces the old one only when complete,
+     * because the old one may be in use elsewhere (also by other threads of a shared handle). */
     if (*schedule != NULL && level & NHL_QUERY_BASIC) {
+        NhlSchedule *old_schedule = *schedule;
         int idx;
         int num_games = 0;
         int *game_ids = NULL;
 
-        if ((*schedule)->games != NULL) {
-            num_games = (*schedule)->num_games;
+        if (old_schedule->games != NULL) {
+            num_games = old_schedule->num_games;
             game_ids = malloc(num_games * sizeof(int));
             for (idx = 0; idx != num_games; ++idx) {
-                game_ids[idx] = (*schedule)->games[idx]->unique_id;
+                game_ids[idx] = old_schedule->games[idx]->unique_id;
             }
         } else {
             game_ids = nhl_cache_games_find(nhl, date_str, &num_games);
-            (*schedule)->games = calloc(num_games, sizeof(NhlGame *));
         }
 
-        for (idx = 0; idx != num_games; ++idx) {
-            NhlGame *game_old = (*schedule)->games[idx];
-            NhlGame *game;
-            status |= nhl_game_get(nhl, game_ids[idx], level, &game);
-            (*schedule)->games[idx] = game;
-            nhl_game_unget(nhl, game_old);
+        /* Downloading players discards the rows read in advance, so they are read again */
+        prefetch_games(nhl, game_ids, num_games, level);
+        if (level & NHL_QUERY_PLAYERS) {
+            status |= prefetch_players(nhl, game_ids, num_games);
+            prefetch_games(nhl, game_ids, num_games, level);
         }
-        (*schedule)->num_games = num_games;
 
+        *schedule = malloc(sizeof(NhlSchedule));
+        (*schedule)->date = old_schedule->date;
+        (*schedule)->num_games = num_games;
+        (*schedule)->games = calloc(num_games, sizeof(NhlGame *));
+        for (idx = 0; idx != num_games; ++idx) {
+            status |= nhl_game_get(nhl, game_ids[idx], level, &(*schedule)->games[idx]);
+        }
         qsort((*schedule)->games, num_games, sizeof(NhlGame *), compare_games);
-
         free(game_ids);
+
+        nhl_dict_insert(nhl->schedules, date_str, *schedule, timestamp);
+        if (cache_schedule != NULL) {
+            delete_schedule(old_schedule);
+        } else {
+            nhl_dict_unref(nhl->schedules, old_schedule);
+        }
+
+    } else if (cache_schedule != NULL) {
+        nhl_dict_insert(nhl->schedules, date_str, *schedule, timestamp);
     }
 
     free(date_str);
@@ -137,15 +531,103 @@ NhlStatus nhl_schedule_get(Nhl *nhl, const NhlDate *date, NhlQueryLevel level, N
     return status;
 }
 
+NhlStatus nhl_schedules_get(Nhl *nhl, const NhlDate *dates, int num_dates, NhlQueryLevel level,
+                            NhlSchedule **schedules) {
+    NhlStatus status = 0;
+    int start = nhl_prepare(nhl);
+    char **urls = malloc((num_dates > 0 ? num_dates : 1) * sizeof(char *));
+    int num_urls = 0;
+    int idx = 0;
+
+    /* Collect schedules that are missing from the cache or too old, and download them at once.
+     * Consecutive days are requested with a single range query. If the URLs cannot be allocated,
+     * the schedules are only read from the cache. */
+    if (urls == NULL) {
+        status |= NHL_MEMORY_ERROR;
+    }
+    while (urls != NULL && idx != num_dates) {
+        NhlDate last = dates[idx];
+        int end = idx + 1;
+        NhlDate next;
+        char *url;
+        if (schedule_is_fresh(nhl, &dates[idx])) {
+            ++idx;
+            continue;
+        }
+        for (next = nhl_date_next(&last); end != num_dates; ++end, next = nhl_date_next(&last)) {
+            if (nhl_date_compare(&dates[end], &next) != 0 || schedule_is_fresh(nhl, &dates[end])) {
+                break;
+            }
+            last = next;
+        }
+        url = end - idx > 1 ? schedule_range_url(&dates[idx], &last) : schedule_url(&dates[idx]);
+        if (url != NULL) {
+            urls[num_urls++] = url;
+        } else {
+            status |= NHL_MEMORY_ERROR;
+        }
+        idx = end;
+    }
+
+    if (num_urls > 0) {
+        status |= nhl_update_from_urls(nhl, (const char *const *) urls, num_urls, NHL_CONTENT_SCHEDULE);
+    }
+
+    /* Schedules are now up to date in the cache, unless the downloads failed. URLs visited above are
+     * not downloaded again during this call. */
+    for (idx = 0; idx != num_dates; ++idx) {
+        status |= nhl_schedule_get(nhl, &dates[idx], level, &schedules[idx]);
+    }
+
+    for (idx = 0; idx != num_urls; ++idx) {
+        free(urls[idx]);
+    }
+    free(urls);
+    nhl_finish(nhl, start);
+    return status;
+}
+
+NhlStatus nhl_schedules_prefetch(Nhl *nhl, const NhlDate *first, const NhlDate *last) {
+    NhlStatus status = 0;
+    int start = nhl_prepare(nhl);
+    NhlDate date = *first;
+
+    /* Download only if some of the dates is missing or too old */
+    while (nhl_date_compare(&date, last) <= 0 && schedule_is_fresh(nhl, &date)) {
+        date = nhl_date_next(&date);
+    }
+
+    if (nhl_date_compare(&date, last) <= 0) {
+        char *url = schedule_range_url(first, last);
+        status |= url != NULL ? nhl_update_from_url(nhl, url, NHL_CONTENT_SCHEDULE) : NHL_MEMORY_ERROR;
+        free(url);
+    } else {
+        status |= NHL_CACHE_READ_OK;
+    }
+
+    nhl_finish(nhl, start);
+    return status;
+}
+
 void nhl_schedule_unget(Nhl *nhl, NhlSchedule *schedule) {
-    if (schedule != NULL && nhl_dict_unref(nhl->schedules, schedule) == 0) {
-        int idx;
-        for (idx=0; idx != schedule->num_games; ++idx) {
+    if (schedule != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->schedules, schedule);
+        nhl_handle_unlock(nhl);
+    }
+}
+
+void nhl_schedule_destroy(void *ptr, void *nhl_ptr) {
+    Nhl *nhl = nhl_ptr;
+    NhlSchedule *schedule = ptr;
+    int idx;
+    if (schedule->games != NULL) {
+        for (idx = 0; idx != schedule->num_games; ++idx) {
             nhl_game_unget(nhl, schedule->games[idx]);
         }
         free(schedule->games);
-        delete_schedule(schedule);
     }
+    delete_schedule(schedule);
 }
 
 
@@ -212,11 +694,18 @@ NhlStatus nhl_game_status_get(Nhl *nhl, const char *game_status_code, NhlQueryLe
 }
 
 void nhl_game_status_unget(Nhl *nhl, NhlGameStatus *game_status) {
-    if (game_status != NULL && nhl_dict_unref(nhl->game_statuses, game_status) == 0) {
-        delete_game_status(game_status);
+    if (game_status != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->game_statuses, game_status);
+        nhl_handle_unlock(nhl);
     }
 }
 
+void nhl_game_status_destroy(void *game_status, void *nhl) {
+    (void) nhl;
+    delete_game_status(game_status);
+}
+
 
 /* Convert cached game type to game type. Release with delete_game_type(). */
 static NhlGameType *create_game_type(const NhlCacheGameType *cache_game_type) {
@@ -279,25 +768,32 @@ NhlStatus nhl_game_type_get(Nhl *nhl, const char *game_type_code, NhlQueryLevel
 }
 
 void nhl_game_type_unget(Nhl *nhl, NhlGameType *game_type) {
-    if (game_type != NULL && nhl_dict_unref(nhl->game_types, game_type) == 0) {
-        delete_game_type(game_type);
+    if (game_type != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->game_types, game_type);
+        nhl_handle_unlock(nhl);
     }
 }
 
+void nhl_game_type_destroy(void *game_type, void *nhl) {
+    (void) nhl;
+    delete_game_type(game_type);
+}
+
 
-/* Create goal array from cached goal array. Release with delete_goals().*/
-static NhlGoal *create_goals(const NhlCacheGoal *cache_goals, int num_goals) {
+/* Create goal array from cached goal array. Allocated from the arena of the game. */
+static NhlGoal *create_goals(NhlArena *arena, const NhlCacheGoal *cache_goals, int num_goals) {
     if (num_goals > 0) {
-        NhlGoal *goals = malloc(num_goals * sizeof(NhlGoal));
+        NhlGoal *goals = nhl_arena_alloc(arena, num_goals * sizeof(NhlGoal));
         int idx;
         for (idx = 0; idx != num_goals; ++idx) {
             NhlGoalTime *time;
             NhlGoalStrength *strength;
 
-            time = malloc(sizeof(NhlGoalTime));
+            time = nhl_arena_alloc(arena, sizeof(NhlGoalTime));
             time->period = cache_goals[idx].period;
-            time->period_type = nhl_copy_string(cache_goals[idx].periodType);
-            time->period_ordinal = nhl_copy_string(cache_goals[idx].ordinalNum);
+            time->period_type = nhl_arena_copy_string(arena, cache_goals[idx].periodType);
+            time->period_ordinal = nhl_arena_copy_string(arena, cache_goals[idx].ordinalNum);
             time->time = nhl_string_to_time(cache_goals[idx].periodTime);
             time->time_remaining = nhl_string_to_time(cache_goals[idx].periodTimeRemaining);
             goals[idx].time = time;
@@ -312,11 +808,11 @@ static NhlGoal *create_goals(const NhlCacheGoal *cache_goals, int num_goals) {
             goals[idx].assist2 = NULL;
             goals[idx].assist2_season_total = cache_goals[idx].assist2SeasonTotal;
             goals[idx].goalie = NULL;
-            goals[idx].type = nhl_copy_string(cache_goals[idx].secondaryType);
+            goals[idx].type = nhl_arena_copy_string(arena, cache_goals[idx].secondaryType);
 
-            strength = malloc(sizeof(NhlGoalStrength));
-            strength->code = nhl_copy_string(cache_goals[idx].strengthCode);
-            strength->name = nhl_copy_string(cache_goals[idx].strengthName);
+            strength = nhl_arena_alloc(arena, sizeof(NhlGoalStrength));
+            strength->code = nhl_arena_copy_string(arena, cache_goals[idx].strengthCode);
+            strength->name = nhl_arena_copy_string(arena, cache_goals[idx].strengthName);
             goals[idx].strength = strength;
 
             goals[idx].game_winning_goal = cache_goals[idx].gameWinningGoal;
@@ -327,32 +823,16 @@ static NhlGoal *create_goals(const NhlCacheGoal *cache_goals, int num_goals) {
     return NULL;
 }
 
-/* Release resources acquired by create_goals(). */
-static void delete_goals(NhlGoal *goals, int num_goals) {
-    if (goals != NULL) {
-        int idx;
-        for (idx = 0; idx != num_goals; ++idx) {
-            free(goals[idx].time->period_type);
-            free(goals[idx].time->period_ordinal);
-            free(goals[idx].time);
-            free(goals[idx].type);
-            free(goals[idx].strength->code);
-            free(goals[idx].strength->name);
-            free(goals[idx].strength);
-        }
-        free(goals);
-    }
-}
-
 /* Assign goal array and its number of elements to the corresponding output arguments.
  * This function NOT use shared pointer model. In addition, this function does not check whether
  * the cache database is up-to-date. Thus, this function should only be called internally from a
  * function that ensures that the cache is up-to-date.
  */
-static NhlStatus nhl_goals_get(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGoal **goals, int *num_goals) {
+static NhlStatus nhl_goals_get(Nhl *nhl, NhlArena *arena, int game_id, NhlQueryLevel level,
+                               NhlGoal **goals, int *num_goals) {
     NhlStatus status = 0;
     NhlCacheGoal *cache_goals = nhl_cache_goals_get(nhl, game_id, num_goals);
-    *goals = create_goals(cache_goals, *num_goals);
+    *goals = create_goals(arena, cache_goals, *num_goals);
 
     if (level & NHL_QUERY_BASIC) {
         int idx;
@@ -392,7 +872,8 @@ static NhlStatus nhl_goals_get(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGo
     return status;
 }
 
-/* Release resources acquired by nhl_goals_get. */
+/* Release the objects linked from goals acquired by nhl_goals_get. The goals themselves are released
+ * with the arena. */
 static void nhl_goals_unget(Nhl *nhl, NhlGoal *goals, int num_goals) {
     if (goals != NULL) {
         int idx;
@@ -403,15 +884,14 @@ static void nhl_goals_unget(Nhl *nhl, NhlGoal *goals, int num_goals) {
             nhl_player_unget(nhl, goals[idx].assist2);
             nhl_player_unget(nhl, goals[idx].goalie);
         }
-        delete_goals(goals, num_goals);
     }
 }
 
 
-/* Create period array from cached period array. Release with delete_periods().*/
-static NhlGamePeriod *create_periods(const NhlCachePeriod *cache_periods, int num_periods) {
+/* Create period array from cached period array. Allocated from the arena of the game. */
+static NhlGamePeriod *create_periods(NhlArena *arena, const NhlCachePeriod *cache_periods, int num_periods) {
     if (num_periods > 0) {
-        NhlGamePeriod *periods = malloc(num_periods * sizeof(NhlGamePeriod));
+        NhlGamePeriod *periods = nhl_arena_alloc(arena, num_periods * sizeof(NhlGamePeriod));
         int idx;
         for (idx = 0; idx != num_periods; ++idx) {
             periods[idx].num = cache_periods[idx].num;
@@ -419,8 +899,8 @@ static NhlGamePeriod *create_periods(const NhlCachePeriod *cache_periods, int nu
             periods[idx].away_shots = cache_periods[idx].awayShotsOnGoal;
             periods[idx].home_goals = cache_periods[idx].homeGoals;
             periods[idx].home_shots = cache_periods[idx].homeShotsOnGoal;
-            periods[idx].ordinal_num = nhl_copy_string(cache_periods[idx].ordinalNum);
-            periods[idx].period_type = nhl_copy_string(cache_periods[idx].periodType);
+            periods[idx].ordinal_num = nhl_arena_copy_string(arena, cache_periods[idx].ordinalNum);
+            periods[idx].period_type = nhl_arena_copy_string(arena, cache_periods[idx].periodType);
             periods[idx].start_time = nhl_string_to_datetime(cache_periods[idx].startTime);
             periods[idx].end_time = nhl_string_to_datetime(cache_periods[idx].endTime);
         }
@@ -429,47 +909,28 @@ static NhlGamePeriod *create_periods(const NhlCachePeriod *cache_periods, int nu
     return NULL;
 }
 
-/* Release resources acquired by create_periods(). */
-static void delete_periods(NhlGamePeriod *periods, int num_periods) {
-    if (periods != NULL) {
-        int idx;
-        for (idx = 0; idx != num_periods; ++idx) {
-            free(periods[idx].ordinal_num);
-            free(periods[idx].period_type);
-        }
-        free(periods);
-    }
-}
-
 /* Assign period array and its number of elements to the corresponding output arguments.
  * This function does NOT use shared pointer model. In addition, this function does not check
  * whether the cache database is up-to-date. Thus, this function should only be called internally
  * from a function that ensures that the cache is up-to-date.
  */
-static NhlStatus nhl_periods_get(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGamePeriod **periods, int *num_periods) {
+static NhlStatus nhl_periods_get(Nhl *nhl, NhlArena *arena, int game_id, NhlQueryLevel level,
+                                 NhlGamePeriod **periods, int *num_periods) {
     NhlStatus status = 0;
     NhlCachePeriod *cache_periods = nhl_cache_periods_get(nhl, game_id, num_periods);
-    *periods = create_periods(cache_periods, *num_periods);
+    *periods = create_periods(arena, cache_periods, *num_periods);
 
     (void) level;
     nhl_cache_periods_free(cache_periods, *num_periods);
     return status;
 }
 
-/* Release resources acquired by nhl_periods_get. */
-static void nhl_periods_unget(Nhl *nhl, NhlGamePeriod *periods, int num_periods) {
-    (void) nhl;
-    if (periods != NULL) {
-        delete_periods(periods, num_periods);
-    }
-}
 
-
-/* Create game details from cache linescore. Release with delete_details().*/
-static NhlGameDetails *create_details(const NhlCacheLinescore *cache_details) {
-    NhlGameDetails *details = malloc(sizeof(NhlGameDetails));
+/* Create game details from cache linescore. Allocated from the arena of the game. */
+static NhlGameDetails *create_details(NhlArena *arena, const NhlCacheLinescore *cache_details) {
+    NhlGameDetails *details = nhl_arena_alloc(arena, sizeof(NhlGameDetails));
     details->current_period_number = cache_details->currentPeriod;
-    details->current_period_name = nhl_copy_string(cache_details->currentPeriodOrdinal);
+    details->current_period_name = nhl_arena_copy_string(arena, cache_details->currentPeriodOrdinal);
     details->current_period_remaining = nhl_string_to_time(cache_details->currentPeriodTimeRemaining);
     details->away_shots = cache_details->awayShotsOnGoal;
     details->away_power_play = cache_details->awayPowerPlay;
@@ -480,7 +941,7 @@ static NhlGameDetails *create_details(const NhlCacheLinescore *cache_details) {
     details->home_goalie_pulled = cache_details->homeGoaliePulled;
     details->home_num_skaters = cache_details->homeNumSkaters;
     details->powerplay = cache_details->powerPlayInSituation;
-    details->power_play_strength = nhl_copy_string(cache_details->powerPlayStrength);
+    details->power_play_strength = nhl_arena_copy_string(arena, cache_details->powerPlayStrength);
     details->powerplay_time_secs = cache_details->powerPlaySituationElapsed;
     details->powerplay_time_remaining_secs = cache_details->powerPlaySituationRemaining;
     details->intermission = cache_details->intermission;
@@ -490,7 +951,7 @@ static NhlGameDetails *create_details(const NhlCacheLinescore *cache_details) {
     details->periods = NULL;
 
     if (cache_details->hasShootout) {
-        details->shootout = malloc(sizeof(NhlGameShootout));
+        details->shootout = nhl_arena_alloc(arena, sizeof(NhlGameShootout));
         details->shootout->away_score = cache_details->awayShootoutScores;
         details->shootout->away_attempts = cache_details->awayShootoutAttempts;
         details->shootout->home_score = cache_details->homeShootoutScores;
@@ -503,46 +964,47 @@ static NhlGameDetails *create_details(const NhlCacheLinescore *cache_details) {
     return details;
 }
 
-/* Release resources acquired by create_details(). */
-static void delete_details(NhlGameDetails *details) {
-    if (details != NULL) {
-        free(details->current_period_name);
-        free(details->power_play_strength);
-        free(details->shootout);
-        free(details);
-    }
-}
-
 /* Assign game details a.k.a. linescore. This function does NOT use shared pointer model.
  * In addition, this function does not check whether the cache database is up-to-date.
  * Thus, this function should only be called internally from a function that ensures that
  * the cache is up-to-date.
  */
-static NhlStatus nhl_game_details_get(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGameDetails **details) {
+static NhlStatus nhl_game_details_get(Nhl *nhl, NhlArena *arena, int game_id, NhlQueryLevel level,
+                                      NhlGameDetails **details) {
     NhlStatus status = 0;
     NhlCacheLinescore *cache_linescore = nhl_cache_linescore_get(nhl, game_id);
-    *details = create_details(cache_linescore);
+    *details = create_details(arena, cache_linescore);
 
     if (level & NHL_QUERY_BASIC) {
-        status |= nhl_periods_get(nhl, game_id, level, &(*details)->periods, &(*details)->num_periods);
+        status |= nhl_periods_get(nhl, arena, game_id, level, &(*details)->periods, &(*details)->num_periods);
     }
 
     nhl_cache_linescore_free(cache_linescore);
     return status;
 }
 
-/* Release resources acquired by nhl_game_details_get. */
-static void nhl_game_details_unget(Nhl *nhl, NhlGameDetails *details) {
-    if (details != NULL) {
-        nhl_periods_unget(nhl, details->periods, details->num_periods);
-        delete_details(details);
-    }
-}
 
+/* Game together with the arena that holds it. Everything the game owns (records, details, periods,
+ * goals and their strings) is allocated from the same arena, whereas the linked teams, players,
+ * statuses and types are shared objects. */
+typedef struct NhlGameBlock {
+    NhlGame game;
+    NhlArena *arena;
+} NhlGameBlock;
+
+/* Size of the first block of a game arena, enough for the details and goals of most games */
+#define NHL_GAME_ARENA_SIZE 4096
+
+/* Return the arena of a game created with create_game(). */
+static NhlArena *game_arena(NhlGame *game) {
+    return ((NhlGameBlock *) game)->arena;
+}
 
 /* Convert cached game to game. Release with delete_game(). */
 static NhlGame *create_game(const NhlCacheGame *cache_game) {
-    NhlGame *game = malloc(sizeof(NhlGame));
+    NhlArena *arena = nhl_arena_create(NHL_GAME_ARENA_SIZE);
+    NhlGameBlock *block = nhl_arena_alloc(arena, sizeof(NhlGameBlock));
+    NhlGame *game = &block->game;
 
     NhlTeamRecord *away_record;
     NhlTeamRecord *home_record;
@@ -550,7 +1012,7 @@ static NhlGame *create_game(const NhlCacheGame *cache_game) {
     game->unique_id = cache_game->gamePk;
     game->away = NULL;
     game->home = NULL;
-    game->season = nhl_copy_string(cache_game->season);
+    game->season = nhl_arena_copy_string(arena, cache_game->season);
     game->type = NULL;
     game->date = nhl_string_to_date(cache_game->date);
     game->start_time = nhl_string_to_datetime(cache_game->gameDate);
@@ -560,14 +1022,14 @@ static NhlGame *create_game(const NhlCacheGame *cache_game) {
     game->num_goals = -1;
     game->goals = NULL;
 
-    away_record = malloc(sizeof(NhlTeamRecord));
+    away_record = nhl_arena_alloc(arena, sizeof(NhlTeamRecord));
     away_record->wins = cache_game->awayWins;
     away_record->losses = cache_game->awayLosses;
     away_record->overtime_losses = cache_game->awayOt;
     away_record->games_played = away_record->wins + away_record->losses + away_record->overtime_losses;
     game->away_record = away_record;
 
-    home_record = malloc(sizeof(NhlTeamRecord));
+    home_record = nhl_arena_alloc(arena, sizeof(NhlTeamRecord));
     home_record->wins = cache_game->homeWins;
     home_record->losses = cache_game->homeLosses;
     home_record->overtime_losses = cache_game->homeOt;
@@ -575,19 +1037,73 @@ static NhlGame *create_game(const NhlCacheGame *cache_game) {
     game->home_record = home_record;
 
     game->details = NULL;
+    block->arena = arena;
     return game;
 }
 
-/* Release resources acquired with create_game(). */
+/* Release resources acquired with create_game(), including everything allocated from its arena. */
 static void delete_game(NhlGame *game) {
     if (game != NULL) {
-        free(game->season);
-        free(game->away_record);
-        free(game->home_record);
-        free(game);
+        nhl_arena_delete(game_arena(game));
     }
 }
 
+/* Generate linescore URL of a game. The returned string must be released with free(). */
+static char *game_linescore_url(int game_id) {
+    size_t base_len = strlen(NHL_URL_PREFIX_GAME);
+    size_t suffix_len = strlen(NHL_URL_SUFFIX_LINESCORE);
+    char *url = malloc(base_len + 12 + suffix_len + 1);
+    sprintf(url, "%s%d%s", NHL_URL_PREFIX_GAME, game_id, NHL_URL_SUFFIX_LINESCORE);
+    return url;
+}
+
+/* Returns nonzero if the strings are equal or both NULL. */
+static int equal_strings(const char *str1, const char *str2) {
+    return str1 == str2 || (str1 != NULL && str2 != NULL && strcmp(str1, str2) == 0);
+}
+
+/* Refresh a game that is already in the cache. Unfinished games are refreshed with the linescore of
+ * the game only. The schedule of the whole day, which also contains scoring plays, is read only if
+ * the linescore shows that a goal has been scored or that the status of the game has changed, or if
+ * the game was already finished. */
+static NhlStatus update_game(Nhl *nhl, const NhlCacheGame *old_game) {
+    NhlStatus status = 0;
+    NhlCacheGame *new_game;
+    NhlCacheLinescore *linescore;
+    int refresh_day = 0;
+    char *url;
+
+    if (is_final_status(nhl, old_game->statusCode)) {
+        refresh_day = 1;
+
+    } else {
+        url = game_linescore_url(old_game->gamePk);
+        status |= nhl_update_from_url(nhl, url, NHL_CONTENT_LINESCORE);
+        free(url);
+        if (!(status & NHL_DOWNLOAD_OK)) {
+            return status;
+        }
+
+        new_game = nhl_cache_game_get(nhl, old_game->gamePk);
+        linescore = nhl_cache_linescore_get(nhl, old_game->gamePk);
+        refresh_day = new_game == NULL ||
+                      new_game->awayScore != old_game->awayScore || new_game->homeScore != old_game->homeScore ||
+                      !equal_strings(new_game->statusCode, old_game->statusCode) ||
+                      (linescore != NULL && linescore->currentPeriodTimeRemaining != NULL &&
+                       strcmp(linescore->currentPeriodTimeRemaining, "Final") == 0);
+        nhl_cache_linescore_free(linescore);
+        nhl_cache_game_free(new_game);
+    }
+
+    if (refresh_day) {
+        NhlDate date = nhl_string_to_date(old_game->date);
+        url = schedule_url(&date);
+        status |= url != NULL ? nhl_update_from_url(nhl, url, NHL_CONTENT_SCHEDULE) : NHL_MEMORY_ERROR;
+        free(url);
+    }
+    return status;
+}
+
 /* Callback for getting cached game. */
 static NhlStatus get_cache_game_cb(Nhl *nhl, int update, void **dest, void *userp) {
     NhlStatus status = 0;
@@ -595,7 +1111,14 @@ static NhlStatus get_cache_game_cb(Nhl *nhl, int update, void **dest, void *user
     int *game_id = userp;
 
     if (update) {
-        status |= nhl_update_from_url(nhl, NULL, 0);
+        /* Games are found only through schedules, so an uncached game cannot be updated. */
+        cache_game = nhl_cache_game_get(nhl, *game_id);
+        if (cache_game != NULL) {
+            status |= update_game(nhl, cache_game);
+            nhl_cache_game_free(cache_game);
+        } else {
+            status |= NHL_DOWNLOAD_SKIPPED;
+        }
     }
 
     cache_game = nhl_cache_game_get(nhl, *game_id);
@@ -614,7 +1137,7 @@ static NhlStatus get_cache_game_cb(Nhl *nhl, int update, void **dest, void *user
 NhlStatus nhl_game_get(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGame **game) {
     int start = nhl_prepare(nhl);
     NhlCacheGame *cache_game = NULL;
-    NhlStatus status = nhl_get(nhl, nhl->games, &game_id, nhl->params->game_live_max_age,
+    NhlStatus status = nhl_get(nhl, nhl->games, &game_id, game_max_age(nhl, game_id),
                                get_cache_game_cb, &game_id, (void **) game, (void **) &cache_game);
 
     if (cache_game != NULL) {
@@ -622,7 +1145,8 @@ NhlStatus nhl_game_get(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGame **gam
         nhl_dict_insert(nhl->games, &game_id, *game, cache_game->meta->timestamp);
     }
 
-    if (*game != NULL && level & NHL_QUERY_BASIC) {
+    if (*game != NULL && level & NHL_QUERY_BASIC &&
+            nhl_links_refreshable(nhl, (*game)->away && (*game)->home && (*game)->status && (*game)->type)) {
         int away_id = 0;
         NhlTeam *away_old = (*game)->away;
         NhlTeam *away;
@@ -675,12 +1199,26 @@ NhlStatus nhl_game_get(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGame **gam
         free(type_code);
     }
 
+    /* Other threads of a shared handle may fill the same game meanwhile, so the first one wins.
+     * The details and goals of the losers are left unused in the arena of the game. */
     if (*game != NULL && (*game)->details == NULL && level & NHL_QUERY_GAMEDETAILS) {
-        status |= nhl_game_details_get(nhl, game_id, level, &(*game)->details);
+        NhlGameDetails *details;
+        status |= nhl_game_details_get(nhl, game_arena(*game), game_id, level, &details);
+        if ((*game)->details == NULL) {
+            (*game)->details = details;
+        }
     }
 
     if (*game != NULL && (*game)->goals == NULL && level & NHL_QUERY_GOALS) {
-        status |= nhl_goals_get(nhl, game_id, level, &(*game)->goals, &(*game)->num_goals);
+        NhlGoal *goals;
+        int num_goals;
+        status |= nhl_goals_get(nhl, game_arena(*game), game_id, level, &goals, &num_goals);
+        if ((*game)->goals == NULL) {
+            (*game)->goals = goals;
+            (*game)->num_goals = num_goals;
+        } else {
+            nhl_goals_unget(nhl, goals, num_goals);
+        }
     }
 
     nhl_cache_game_free(cache_game);
@@ -689,13 +1227,20 @@ NhlStatus nhl_game_get(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGame **gam
 }
 
 void nhl_game_unget(Nhl *nhl, NhlGame *game) {
-    if (game != NULL && nhl_dict_unref(nhl->games, game) == 0) {
-        nhl_team_unget(nhl, game->away);
-        nhl_team_unget(nhl, game->home);
-        nhl_game_type_unget(nhl, game->type);
-        nhl_game_status_unget(nhl, game->status);
-        nhl_game_details_unget(nhl, game->details);
-        nhl_goals_unget(nhl, game->goals, game->num_goals);
-        delete_game(game);
+    if (game != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->games, game);
+        nhl_handle_unlock(nhl);
     }
 }
+
+void nhl_game_destroy(void *ptr, void *nhl_ptr) {
+    Nhl *nhl = nhl_ptr;
+    NhlGame *game = ptr;
+    nhl_team_unget(nhl, game->away);
+    nhl_team_unget(nhl, game->home);
+    nhl_game_type_unget(nhl, game->type);
+    nhl_game_status_unget(nhl, game->status);
+    nhl_goals_unget(nhl, game->goals, game->num_goals);
+    delete_game(game);
+}
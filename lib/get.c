@@ -7,7 +7,7 @@
 
 /* Search for the `key` in `dict`. */
 static NhlStatus nhl_get_from_dict(Nhl *nhl, NhlDict *dict, int max_age, void *key, void **item, int *age) {
-    char *timestamp;
+    time_t timestamp;
     *item = nhl_dict_find(dict, key, &timestamp);
     if (*item != NULL) {
         *age = nhl_cache_timestamp_age(nhl, timestamp);
@@ -32,8 +32,7 @@ static NhlStatus nhl_get_from_cache(Nhl *nhl, int prev_age, int max_age,
     status |= get_from_cache_cb(nhl, 0, cache_item, data_cb);
 
     if (status & NHL_CACHE_READ_OK) {
-        char *timestamp = ((NhlCacheMeta *) ((NhlCacheMeta*) *cache_item)->source)->timestamp;
-        int cache_age = nhl_cache_timestamp_age(nhl, timestamp);
+        int cache_age = nhl_cache_timestamp_age(nhl, nhl_cache_item_meta(*cache_item)->timestamp);
         if (0 <= cache_age && (cache_age <= max_age || max_age < 0)) {
             return status;
         }
@@ -41,9 +40,8 @@ static NhlStatus nhl_get_from_cache(Nhl *nhl, int prev_age, int max_age,
 
     status = get_from_cache_cb(nhl, 1, cache_item, data_cb);
     if (status & NHL_CACHE_READ_OK) {
-        char *timestamp = ((NhlCacheMeta *) ((NhlCacheMeta*) *cache_item)->source)->timestamp;
-        int cache_age = nhl_cache_timestamp_age(nhl, timestamp);
-        status &= NHL_CACHE_WRITE_OK;
+        int cache_age = nhl_cache_timestamp_age(nhl, nhl_cache_item_meta(*cache_item)->timestamp);
+        status &= NHL_CACHE_WRITE_OK | NHL_CACHE_LOCKED;
         if (0 <= cache_age) {
             if (cache_age < max_age || max_age < 0) {
                 return status | NHL_CACHE_READ_OK;
@@ -90,3 +88,16 @@ NhlStatus nhl_get(Nhl *nhl, NhlDict *dict, void *key, int max_age,
 
     return cache_status;
 }
+
+
+int nhl_links_refreshable(const Nhl *nhl, int complete) {
+    return nhl->lock == NULL || !complete;
+}
+
+int nhl_min_age(int age1, int age2) {
+    if (age1 < 0)
+        return age2;
+    if (age2 < 0)
+        return age1;
+    return age1 < age2 ? age1 : age2;
+}
@@ -25,5 +25,13 @@ NhlStatus nhl_get(Nhl *nhl, NhlDict *dict, void *key, int max_age,
                   NhlStatus (*get_from_cache_cb)(Nhl *, int, void **, void *), void *data_cb,
                   void **item, void **cache_item);
 
+/* Return nonzero if the objects linked from an object found by nhl_get() can be replaced with
+ * refreshed ones. Objects of a shared handle may be in use by other threads, so their links are
+ * only set once, when they are not yet complete. */
+int nhl_links_refreshable(const Nhl *nhl, int complete);
+
+/* Smaller of two maximum ages, where negative value means no limit. */
+int nhl_min_age(int age1, int age2);
+
 
 #endif /* NHL_GET_H_ */
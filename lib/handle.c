@@ -4,12 +4,21 @@
 
 #include <curl/curl.h>
 #include <sqlite3.h>
+#include <time.h>
 
 #include "cache.h"
+#include "destroy.h"
+#include "lock.h"
 #include "mem.h"
 
 /* TODO: check curl and sqlite error codes */
 
+/* Each handle has its own database connection, which is only used by one thread at a time. */
+#define NHL_OPEN_FLAGS (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX)
+
+/* Flags of a read-only cache file. Immutable files are opened by URI. */
+#define NHL_OPEN_READONLY_FLAGS (SQLITE_OPEN_READONLY | SQLITE_OPEN_URI | SQLITE_OPEN_NOMUTEX)
+
 
 void nhl_default_params(NhlInitParams *params) {
     params->cache_file = NULL;
@@ -17,14 +26,22 @@ void nhl_default_params(NhlInitParams *params) {
 
     params->offline = 0;
     params->verbose = 0;
+    params->shared = 0;
+    params->busy_timeout = 5000;
+    params->read_only = 0;
+    params->immutable = 0;
 
     params->schedule_max_age = 60;
     params->game_live_max_age = 60;
-    params->game_final_max_age = 60;
+    params->game_final_max_age = -1;
+    params->game_future_max_age = 6 * 3600;
     params->team_max_age = -1;
     params->player_max_age = -1;
     params->league_max_age = -1;
     params->meta_max_age = -1;
+
+    params->retain_max_items = 1000;
+    params->retain_max_age = 600;
 }
 
 static NhlInitParams *copy_params(NhlInitParams *dest, const NhlInitParams *src) {
@@ -47,6 +64,82 @@ static void free_params(NhlInitParams *params) {
 }
 
 
+/* Return the URI of an immutable database file at path. Release with sqlite3_free(). */
+static char *immutable_uri(const char *path) {
+    sqlite3_str *uri = sqlite3_str_new(NULL);
+    /* Absolute paths need an empty authority, so that "//" is not mistaken for a host name */
+    sqlite3_str_appendall(uri, path[0] == '/' ? "file://" : "file:");
+    for ( ; *path != '\0'; ++path) {
+        if (*path == '%' || *path == '?' || *path == '#') {
+            sqlite3_str_appendf(uri, "%%%02X", (unsigned char) *path);
+        } else {
+            sqlite3_str_appendchar(uri, 1, *path);
+        }
+    }
+    sqlite3_str_appendall(uri, "?immutable=1");
+    return sqlite3_str_finish(uri);
+}
+
+/* Open the database connection of the handle. A writable cache file is switched to write-ahead
+ * log mode, which is stored in the file, so it only has to be set once by any handle. */
+static void open_database(Nhl *nhl) {
+    const NhlInitParams *params = nhl->params;
+    if (params->cache_file == NULL) {
+        sqlite3_open_v2(":memory:", &nhl->db, NHL_OPEN_FLAGS, NULL);
+    } else if (params->immutable) {
+        char *uri = immutable_uri(params->cache_file);
+        sqlite3_open_v2(uri, &nhl->db, NHL_OPEN_READONLY_FLAGS, NULL);
+        sqlite3_free(uri);
+    } else if (params->read_only) {
+        sqlite3_open_v2(params->cache_file, &nhl->db, NHL_OPEN_READONLY_FLAGS, NULL);
+    } else {
+        sqlite3_open_v2(params->cache_file, &nhl->db, NHL_OPEN_FLAGS, NULL);
+        sqlite3_exec(nhl->db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+    }
+    sqlite3_busy_timeout(nhl->db, params->busy_timeout);
+}
+
+
+/* Number of object dicts in a handle. */
+#define NUM_DICTS 11
+
+/* Collect object dicts of the handle into an array of NUM_DICTS elements. */
+static void get_dicts(Nhl *nhl, NhlDict **dicts) {
+    dicts[0] = nhl->schedules;
+    dicts[1] = nhl->games;
+    dicts[2] = nhl->players;
+    dicts[3] = nhl->teams;
+    dicts[4] = nhl->franchises;
+    dicts[5] = nhl->divisions;
+    dicts[6] = nhl->conferences;
+    dicts[7] = nhl->game_statuses;
+    dicts[8] = nhl->game_types;
+    dicts[9] = nhl->player_positions;
+    dicts[10] = nhl->roster_statuses;
+}
+
+/* Apply retention policy to all object dicts of the handle. */
+static void set_retention(Nhl *nhl, int max_items, int max_age) {
+    NhlDict *dicts[NUM_DICTS];
+    int idx;
+    get_dicts(nhl, dicts);
+    for (idx = 0; idx != NUM_DICTS; ++idx) {
+        nhl_dict_set_retention(dicts[idx], max_items, max_age);
+    }
+}
+
+/* Destroy retained objects that have been unused for too long. */
+static void expire_retained(Nhl *nhl) {
+    NhlDict *dicts[NUM_DICTS];
+    int idx;
+    get_dicts(nhl, dicts);
+    for (idx = 0; idx != NUM_DICTS; ++idx) {
+        nhl_dict_expire(dicts[idx], nhl->now);
+    }
+}
+
+/* Initialize the members of a handle. Returns zero if the parameters cannot be allocated, or if the
+ * cache cannot be opened (e.g., the file is locked, or its schema cannot be brought up to date). */
 static int nhl_handle_initialize(Nhl *nhl, const NhlInitParams *params) {
     nhl->params = malloc(sizeof(NhlInitParams));
     if (nhl->params == NULL)
@@ -58,85 +151,206 @@ static int nhl_handle_initialize(Nhl *nhl, const NhlInitParams *params) {
         nhl_default_params(nhl->params);
     }
 
-    nhl->schedules = nhl_dict_create(NHL_DICT_KEY_TEXT);
-    nhl->games = nhl_dict_create(NHL_DICT_KEY_NUMERIC);
-    nhl->teams = nhl_dict_create(NHL_DICT_KEY_NUMERIC);
-    nhl->players = nhl_dict_create(NHL_DICT_KEY_NUMERIC);
+    /* Read-only modes only concern a cache file, and contents can then only come from the cache */
+    if (nhl->params->cache_file == NULL) {
+        nhl->params->read_only = 0;
+        nhl->params->immutable = 0;
+    }
+    if (nhl->params->immutable) {
+        nhl->params->read_only = 1;
+    }
+    if (nhl->params->read_only) {
+        nhl->params->offline = 1;
+    }
+
+    nhl->schedules = nhl_dict_create(NHL_DICT_KEY_TEXT, nhl_schedule_destroy, nhl);
+    nhl->games = nhl_dict_create(NHL_DICT_KEY_NUMERIC, nhl_game_destroy, nhl);
+    nhl->teams = nhl_dict_create(NHL_DICT_KEY_NUMERIC, nhl_team_destroy, nhl);
+    nhl->players = nhl_dict_create(NHL_DICT_KEY_NUMERIC, nhl_player_destroy, nhl);
+
+    nhl->conferences = nhl_dict_create(NHL_DICT_KEY_NUMERIC, nhl_conference_destroy, nhl);
+    nhl->divisions = nhl_dict_create(NHL_DICT_KEY_NUMERIC, nhl_division_destroy, nhl);
+    nhl->franchises = nhl_dict_create(NHL_DICT_KEY_NUMERIC, nhl_franchise_destroy, nhl);
 
-    nhl->conferences = nhl_dict_create(NHL_DICT_KEY_NUMERIC);
-    nhl->divisions = nhl_dict_create(NHL_DICT_KEY_NUMERIC);
-    nhl->franchises = nhl_dict_create(NHL_DICT_KEY_NUMERIC);
+    nhl->game_statuses = nhl_dict_create(NHL_DICT_KEY_TEXT, nhl_game_status_destroy, nhl);
+    nhl->game_types = nhl_dict_create(NHL_DICT_KEY_TEXT, nhl_game_type_destroy, nhl);
+    nhl->player_positions = nhl_dict_create(NHL_DICT_KEY_TEXT, nhl_player_position_destroy, nhl);
+    nhl->roster_statuses = nhl_dict_create(NHL_DICT_KEY_TEXT, nhl_player_roster_status_destroy, nhl);
 
-    nhl->game_statuses = nhl_dict_create(NHL_DICT_KEY_TEXT);
-    nhl->game_types = nhl_dict_create(NHL_DICT_KEY_TEXT);
-    nhl->player_positions = nhl_dict_create(NHL_DICT_KEY_TEXT);
-    nhl->roster_statuses = nhl_dict_create(NHL_DICT_KEY_TEXT);
+    set_retention(nhl, nhl->params->retain_max_items, nhl->params->retain_max_age);
 
-    nhl->visited_urls = nhl_list_create();
+    nhl->visited_urls = nhl_visited_create();
 
 
     nhl->curl = curl_easy_init();
     curl_easy_setopt(nhl->curl, CURLOPT_ACCEPT_ENCODING, "");
 
-    if (nhl->params->cache_file == NULL)
-        sqlite3_open_v2(":memory:", &nhl->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
-    else
-        sqlite3_open_v2(params->cache_file, &nhl->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    open_database(nhl);
 
+    nhl->sources = NULL;
+    nhl->lock = nhl->params->shared ? nhl_lock_create() : NULL;
+    nhl->workers = NULL;
     nhl->in_progress = 0;
+    nhl->now = 0;
+    nhl->call = 0;
+    nhl->num_calls = 0;
+    nhl->num_changed = 0;
 
-    return 1;
+    return nhl_cache_open(nhl);
+}
+
+
+/* Release the members of a handle, but not the handle itself. Handles whose parameters could not
+ * be allocated have nothing else to release. */
+static void nhl_handle_release(Nhl *nhl) {
+    if (nhl->params == NULL) {
+        return;
+    }
+    nhl_workers_delete(nhl->workers, nhl);
+
+    /* Destroy retained objects. Objects released during this are destroyed immediately. */
+    set_retention(nhl, 0, -1);
+
+    nhl_cache_close(nhl);
+    sqlite3_close(nhl->db);
+    nhl_intern_delete(nhl->sources);
+    curl_easy_cleanup(nhl->curl);
+
+    nhl_visited_delete(nhl->visited_urls);
+    nhl_lock_delete(nhl->lock);
+
+    nhl_dict_delete(nhl->roster_statuses);
+    nhl_dict_delete(nhl->player_positions);
+    nhl_dict_delete(nhl->game_types);
+    nhl_dict_delete(nhl->game_statuses);
+    nhl_dict_delete(nhl->franchises);
+    nhl_dict_delete(nhl->divisions);
+    nhl_dict_delete(nhl->conferences);
+    nhl_dict_delete(nhl->players);
+    nhl_dict_delete(nhl->teams);
+    nhl_dict_delete(nhl->games);
+    nhl_dict_delete(nhl->schedules);
+
+    free_params(nhl->params);
+    nhl->params = NULL;
 }
 
 
 Nhl *nhl_init(const NhlInitParams *params) {
     Nhl *nhl = malloc(sizeof(Nhl));
-    nhl_handle_initialize(nhl, params);
+    if (nhl != NULL && !nhl_handle_initialize(nhl, params)) {
+        nhl_close(nhl);
+        nhl = NULL;
+    }
     return nhl;
 }
 
-void nhl_reset(Nhl *nhl, const NhlInitParams *params) {
-    nhl_close(nhl);
-    nhl_handle_initialize(nhl, params);
+int nhl_reset(Nhl *nhl, const NhlInitParams *params) {
+    nhl_handle_release(nhl);
+    return nhl_handle_initialize(nhl, params);
 }
 
 void nhl_close(Nhl *nhl) {
     if (nhl != NULL) {
-        sqlite3_close(nhl->db);
-        curl_easy_cleanup(nhl->curl);
-
-        nhl_list_delete(nhl->visited_urls);
-
-        nhl_dict_delete(nhl->roster_statuses);
-        nhl_dict_delete(nhl->player_positions);
-        nhl_dict_delete(nhl->game_types);
-        nhl_dict_delete(nhl->game_statuses);
-        nhl_dict_delete(nhl->franchises);
-        nhl_dict_delete(nhl->divisions);
-        nhl_dict_delete(nhl->conferences);
-        nhl_dict_delete(nhl->players);
-        nhl_dict_delete(nhl->teams);
-        nhl_dict_delete(nhl->games);
-        nhl_dict_delete(nhl->schedules);
-
-        free_params(nhl->params);
+        nhl_handle_release(nhl);
         free(nhl);
     }
 }
 
+/* Begin the read transaction of a top-level call, so that the call sees a consistent cache.
+ * Writes take the write lock separately, see nhl_handle_begin_write(). Immutable files need no
+ * transactions, since they are read without locks. */
+static void begin_call(Nhl *nhl) {
+    if (!nhl->params->immutable) {
+        sqlite3_exec(nhl->db, "BEGIN;", NULL, NULL, NULL);
+    }
+}
+
+/* Commit the transaction begun by begin_call(), if any. */
+static void end_call(Nhl *nhl) {
+    if (!sqlite3_get_autocommit(nhl->db)) {
+        sqlite3_exec(nhl->db, "COMMIT;", NULL, NULL, NULL);
+    }
+}
 
 int nhl_prepare(Nhl *nhl) {
+    nhl_handle_lock(nhl);
     if (nhl->in_progress) {
         return 0;
     }
-    sqlite3_exec(nhl->db, "BEGIN;", NULL, NULL, NULL);
+    begin_call(nhl);
     nhl->in_progress = 1;
+    nhl->now = time(NULL);
+    nhl->call = ++nhl->num_calls;
+    expire_retained(nhl);
     return 1;
 }
 
 void nhl_finish(Nhl *nhl, int start) {
     if (start) {
-        sqlite3_exec(nhl->db, "COMMIT;", NULL, NULL, NULL);
+        end_call(nhl);
         nhl->in_progress = 0;
+        nhl_cache_prefetch_clear(nhl);
+    }
+    nhl_handle_unlock(nhl);
+}
+
+
+void nhl_handle_lock(Nhl *nhl) {
+    if (nhl->lock != NULL) {
+        nhl_lock_acquire(nhl->lock);
+    }
+}
+
+void nhl_handle_unlock(Nhl *nhl) {
+    if (nhl->lock != NULL) {
+        nhl_lock_release(nhl->lock);
+    }
+}
+
+void nhl_handle_suspend(Nhl *nhl, NhlCallState *state) {
+    state->in_progress = nhl->in_progress;
+    state->now = nhl->now;
+    state->call = nhl->call;
+    state->depth = 0;
+    if (nhl->lock != NULL) {
+        if (nhl->in_progress) {
+            end_call(nhl);
+            nhl->in_progress = 0;
+        }
+        state->depth = nhl_lock_suspend(nhl->lock);
+    }
+}
+
+void nhl_handle_resume(Nhl *nhl, const NhlCallState *state) {
+    if (nhl->lock != NULL) {
+        nhl_lock_resume(nhl->lock, state->depth);
+        if (state->in_progress) {
+            begin_call(nhl);
+        }
+        nhl->in_progress = state->in_progress;
+        nhl->now = state->now;
+        nhl->call = state->call;
+    }
+}
+
+int nhl_handle_begin_write(Nhl *nhl) {
+    if (nhl->params->read_only) {
+        return 0;
+    }
+    end_call(nhl);
+    if (sqlite3_exec(nhl->db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) == SQLITE_OK) {
+        return 1;
+    }
+    if (nhl->in_progress) {
+        begin_call(nhl);
+    }
+    return 0;
+}
+
+void nhl_handle_end_write(Nhl *nhl) {
+    end_call(nhl);
+    if (nhl->in_progress) {
+        begin_call(nhl);
     }
 }
@@ -3,10 +3,17 @@
 
 #include <curl/curl.h>
 #include <sqlite3.h>
+#include <time.h>
 
 #include <nhl/core.h>
 #include "dict.h"
-#include "list.h"
+#include "intern.h"
+#include "lock.h"
+#include "visited.h"
+#include "worker.h"
+
+/* Prepared statements of the cache database, defined in cache.c. */
+typedef struct NhlCacheStatements NhlCacheStatements;
 
 struct Nhl {
     NhlInitParams *params;
@@ -27,12 +34,64 @@ struct Nhl {
 
     CURL *curl;
     sqlite3 *db;
+    NhlCacheStatements *statements;
+
+    /* Source URLs of the cache, loaded lazily. NULL until first needed. */
+    NhlIntern *sources;
+
+    /* URLs that the handle has already accessed or tried to access. */
+    NhlVisited *visited_urls;
+
+    /* Lock of a handle shared by several threads, or NULL if the handle is not shared. */
+    NhlLock *lock;
 
-    /* List of URLs that the handle has already accessed or tried to access. */
-    NhlList *visited_urls;
+    /* Workers of asynchronous requests, or NULL if none have been made. */
+    NhlWorkers *workers;
 
     /* If nonzero, nhl_prepare() is called without a matching call to nhl_finish(). */
     int in_progress;
+
+    /* Clock read by nhl_prepare(), used for all freshness checks until nhl_finish(). */
+    time_t now;
+
+    /* Number of the current top-level call. */
+    unsigned long call;
+
+    /* Number of top-level calls started by nhl_prepare(). */
+    unsigned long num_calls;
+
+    /* Number of cache rows whose content has changed, see nhl_update_num_changed(). */
+    unsigned long num_changed;
 };
 
+/* Top-level call of a thread, saved while other threads use a shared handle. */
+typedef struct NhlCallState {
+    int depth;
+    int in_progress;
+    time_t now;
+    unsigned long call;
+} NhlCallState;
+
+/* Acquire the lock of a shared handle, or do nothing if the handle is not shared. Calls to
+ * nhl_prepare() and nhl_finish() do this implicitly. */
+void nhl_handle_lock(Nhl *nhl);
+
+/* Release the lock acquired by nhl_handle_lock(). */
+void nhl_handle_unlock(Nhl *nhl);
+
+/* Let other threads use a shared handle, e.g., while downloading. The current transaction is
+ * committed, and the call state is saved into state. Does nothing if the handle is not shared. */
+void nhl_handle_suspend(Nhl *nhl, NhlCallState *state);
+
+/* Continue the call suspended by nhl_handle_suspend(). */
+void nhl_handle_resume(Nhl *nhl, const NhlCallState *state);
+
+/* Take the write lock of the cache file for writing downloaded content. The read transaction of
+ * the current call is committed, and other writers are waited for at most the busy timeout.
+ * Returns zero if the lock could not be taken, in which case nothing must be written. */
+int nhl_handle_begin_write(Nhl *nhl);
+
+/* Commit the writes made after nhl_handle_begin_write(), and continue the current call. */
+void nhl_handle_end_write(Nhl *nhl);
+
 #endif /* NHL_HANDLE_H_ */
@@ -0,0 +1,36 @@
+#include "hash.h"
+
+#include <stddef.h>
+
+/* 32-bit FNV-1a. Only the low 32 bits are used, so that the result is the same for every size of
+ * unsigned long. */
+unsigned long nhl_hash_string(const char *str) {
+    unsigned long hash = 2166136261UL;
+    for ( ; *str != '\0'; ++str) {
+        hash ^= (unsigned char) *str;
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+/* Finalizer of MurmurHash3 for 32-bit values. */
+static unsigned long mix32(unsigned long hash) {
+    hash &= 0xffffffffUL;
+    hash ^= hash >> 16;
+    hash = (hash * 0x85ebca6bUL) & 0xffffffffUL;
+    hash ^= hash >> 13;
+    hash = (hash * 0xc2b2ae35UL) & 0xffffffffUL;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+unsigned long nhl_hash_int(int num) {
+    return mix32((unsigned long) num);
+}
+
+unsigned long nhl_hash_pointer(const void *ptr) {
+    unsigned long addr = (unsigned long) (size_t) ptr;
+    /* Fold the upper half of 64-bit addresses. Two shifts avoid undefined behavior when unsigned
+     * long has only 32 bits. */
+    return mix32(addr ^ ((addr >> 16) >> 16));
+}
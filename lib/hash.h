@@ -0,0 +1,13 @@
+#ifndef NHL_HASH_H_
+#define NHL_HASH_H_
+
+/* Hash value of a null-terminated string. */
+unsigned long nhl_hash_string(const char *str);
+
+/* Hash value of an integer. */
+unsigned long nhl_hash_int(int num);
+
+/* Hash value of a pointer address. */
+unsigned long nhl_hash_pointer(const void *ptr);
+
+#endif /* NHL_HASH_H_ */
@@ -0,0 +1,154 @@
+#include "intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "mem.h"
+
+
+/* Single stored string. */
+typedef struct NhlInternEntry {
+    char *str;
+    int id;
+} NhlInternEntry;
+
+/* Entries are stored in an array, and two open-addressing indices map strings and IDs to array
+ * positions. Index slots hold the array position plus one, so that zero marks an empty slot. */
+struct NhlIntern {
+    NhlInternEntry *entries;
+    int num_entries;
+    int *by_str;
+    int *by_id;
+    unsigned long num_slots; /* Power of two */
+};
+
+
+NhlIntern *nhl_intern_create(void) {
+    NhlIntern *intern = malloc(sizeof(NhlIntern));
+    if (intern != NULL) {
+        intern->entries = NULL;
+        intern->num_entries = 0;
+        intern->by_str = NULL;
+        intern->by_id = NULL;
+        intern->num_slots = 0;
+    }
+    return intern;
+}
+
+void nhl_intern_delete(NhlIntern *intern) {
+    if (intern != NULL) {
+        int idx;
+        for (idx = 0; idx != intern->num_entries; ++idx) {
+            free(intern->entries[idx].str);
+        }
+        free(intern->entries);
+        free(intern->by_str);
+        free(intern->by_id);
+        free(intern);
+    }
+}
+
+
+/* Index slot for the string, either the one where it is stored or the empty slot where it
+ * would be stored. */
+static unsigned long str_slot(const NhlIntern *intern, const char *str) {
+    unsigned long mask = intern->num_slots - 1;
+    unsigned long slot = nhl_hash_string(str) & mask;
+    while (intern->by_str[slot] != 0 && strcmp(intern->entries[intern->by_str[slot] - 1].str, str)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Index slot for the ID, similarly to str_slot(). */
+static unsigned long id_slot(const NhlIntern *intern, int id) {
+    unsigned long mask = intern->num_slots - 1;
+    unsigned long slot = nhl_hash_int(id) & mask;
+    while (intern->by_id[slot] != 0 && intern->entries[intern->by_id[slot] - 1].id != id) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Make room for one more entry, keeping the indices at most half full. */
+static int grow(NhlIntern *intern) {
+    if (2 * (unsigned long) (intern->num_entries + 1) > intern->num_slots) {
+        unsigned long num_slots = intern->num_slots ? 2 * intern->num_slots : 16;
+        int *by_str = calloc(num_slots, sizeof(int));
+        int *by_id = calloc(num_slots, sizeof(int));
+        NhlInternEntry *entries = realloc(intern->entries, num_slots / 2 * sizeof(NhlInternEntry));
+        int idx;
+
+        if (by_str == NULL || by_id == NULL || entries == NULL) {
+            free(by_str);
+            free(by_id);
+            if (entries != NULL)
+                intern->entries = entries;
+            return 0;
+        }
+
+        free(intern->by_str);
+        free(intern->by_id);
+        intern->entries = entries;
+        intern->by_str = by_str;
+        intern->by_id = by_id;
+        intern->num_slots = num_slots;
+
+        for (idx = 0; idx != intern->num_entries; ++idx) {
+            intern->by_str[str_slot(intern, intern->entries[idx].str)] = idx + 1;
+            intern->by_id[id_slot(intern, intern->entries[idx].id)] = idx + 1;
+        }
+    }
+    return 1;
+}
+
+
+const char *nhl_intern_add(NhlIntern *intern, const char *str, int id) {
+    unsigned long s_slot;
+    unsigned long i_slot;
+    char *copy;
+
+    if (!grow(intern)) {
+        return NULL;
+    }
+
+    s_slot = str_slot(intern, str);
+    if (intern->by_str[s_slot] != 0) {
+        return intern->entries[intern->by_str[s_slot] - 1].str;
+    }
+    i_slot = id_slot(intern, id);
+    if (intern->by_id[i_slot] != 0) {
+        return intern->entries[intern->by_id[i_slot] - 1].str;
+    }
+
+    copy = nhl_copy_string(str);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    intern->entries[intern->num_entries].str = copy;
+    intern->entries[intern->num_entries].id = id;
+    intern->num_entries++;
+    intern->by_str[s_slot] = intern->num_entries;
+    intern->by_id[i_slot] = intern->num_entries;
+    return copy;
+}
+
+const char *nhl_intern_find_string(const NhlIntern *intern, int id) {
+    if (intern->num_slots != 0) {
+        int pos = intern->by_id[id_slot(intern, id)];
+        if (pos != 0)
+            return intern->entries[pos - 1].str;
+    }
+    return NULL;
+}
+
+int nhl_intern_find_id(const NhlIntern *intern, const char *str) {
+    if (intern->num_slots != 0) {
+        int pos = intern->by_str[str_slot(intern, str)];
+        if (pos != 0)
+            return intern->entries[pos - 1].id;
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef NHL_INTERN_H_
+#define NHL_INTERN_H_
+
+/* Table of unique strings, each associated with a unique integer ID. The stored strings remain
+ * valid until the table is deleted, so they can be shared without copying. */
+typedef struct NhlIntern NhlIntern;
+
+/* Create new empty table. Release with nhl_intern_delete(). */
+NhlIntern *nhl_intern_create(void);
+
+/* Release resources acquired with nhl_intern_create(), including all stored strings. */
+void nhl_intern_delete(NhlIntern *intern);
+
+/* Store a copy of the string with the given ID, and return the stored string. If the string or
+ * the ID already exists, the existing entry is returned instead. Returns NULL if error occurs. */
+const char *nhl_intern_add(NhlIntern *intern, const char *str, int id);
+
+/* Return stored string whose ID is id, or NULL if not found. */
+const char *nhl_intern_find_string(const NhlIntern *intern, int id);
+
+/* Return ID of the stored string that equals str, or zero if not found. */
+int nhl_intern_find_id(const NhlIntern *intern, const char *str);
+
+#endif /* NHL_INTERN_H_ */
@@ -5,6 +5,7 @@
 
 #include <nhl/update.h>
 #include "cache.h"
+#include "destroy.h"
 #include "dict.h"
 #include "get.h"
 #include "handle.h"
@@ -82,11 +83,18 @@ NhlStatus nhl_conference_get(Nhl *nhl, int conference_id, NhlQueryLevel level, N
 }
 
 void nhl_conference_unget(Nhl *nhl, NhlConference *conference) {
-    if (conference != NULL && nhl_dict_unref(nhl->conferences, conference) == 0) {
-        delete_conference(conference);
+    if (conference != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->conferences, conference);
+        nhl_handle_unlock(nhl);
     }
 }
 
+void nhl_conference_destroy(void *conference, void *nhl) {
+    (void) nhl;
+    delete_conference(conference);
+}
+
 
 /* Create division from cached division. Release with delete_division(). */
 static NhlDivision *create_division(const NhlCacheDivision *cache_division) {
@@ -152,7 +160,7 @@ NhlStatus nhl_division_get(Nhl *nhl, int division_id, NhlQueryLevel level, NhlDi
         nhl_dict_insert(nhl->divisions, &division_id, *division, cache_division->meta->timestamp);
     }
 
-    if (*division != NULL && level & NHL_QUERY_BASIC) {
+    if (*division != NULL && level & NHL_QUERY_BASIC && nhl_links_refreshable(nhl, (*division)->conference != NULL)) {
         int conference_id = 0;
         NhlConference *conference_old = (*division)->conference;
         NhlConference *conference;
@@ -179,8 +187,16 @@ NhlStatus nhl_division_get(Nhl *nhl, int division_id, NhlQueryLevel level, NhlDi
 }
 
 void nhl_division_unget(Nhl *nhl, NhlDivision *division) {
-    if (division != NULL && nhl_dict_unref(nhl->divisions, division) == 0) {
-        nhl_conference_unget(nhl, division->conference);
-        delete_division(division);
+    if (division != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->divisions, division);
+        nhl_handle_unlock(nhl);
     }
 }
+
+void nhl_division_destroy(void *ptr, void *nhl_ptr) {
+    Nhl *nhl = nhl_ptr;
+    NhlDivision *division = ptr;
+    nhl_conference_unget(nhl, division->conference);
+    delete_division(division);
+}
@@ -0,0 +1,179 @@
+#include "lock.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+
+
+/* URL being downloaded by the owner of the lock or a suspended thread. Released claims are kept
+ * (outside the list of claims) until every waiting thread has read the result. */
+struct NhlLockClaim {
+    char *url;
+    int done; /* nonzero if released */
+    int result; /* result of the download, once released */
+    int num_waiters;
+    struct NhlLockClaim *next;
+};
+
+/* The mutex only protects the members, and is never held while the lock is owned. All waiting
+ * threads share the condition variable, which is broadcast whenever the lock or a claim is
+ * released. */
+struct NhlLock {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t owner;
+    int depth; /* zero if not owned */
+    NhlLockClaim *claims;
+};
+
+
+/* Return the claim of url, or NULL if not found. The mutex must be held. */
+static NhlLockClaim *find_claim(const NhlLock *lock, const char *url) {
+    NhlLockClaim *claim;
+    for (claim = lock->claims; claim != NULL; claim = claim->next) {
+        if (strcmp(claim->url, url) == 0) {
+            return claim;
+        }
+    }
+    return NULL;
+}
+
+/* Wait until the lock is not owned by another thread, and take the ownership with the given depth.
+ * The mutex must be held. */
+static void take_ownership(NhlLock *lock, int depth) {
+    pthread_t self = pthread_self();
+    while (lock->depth > 0 && !pthread_equal(lock->owner, self)) {
+        pthread_cond_wait(&lock->cond, &lock->mutex);
+    }
+    lock->owner = self;
+    lock->depth += depth;
+}
+
+
+NhlLock *nhl_lock_create(void) {
+    NhlLock *lock = malloc(sizeof(NhlLock));
+    if (lock != NULL) {
+        if (pthread_mutex_init(&lock->mutex, NULL) != 0) {
+            free(lock);
+            return NULL;
+        }
+        if (pthread_cond_init(&lock->cond, NULL) != 0) {
+            pthread_mutex_destroy(&lock->mutex);
+            free(lock);
+            return NULL;
+        }
+        lock->depth = 0;
+        lock->claims = NULL;
+    }
+    return lock;
+}
+
+void nhl_lock_delete(NhlLock *lock) {
+    if (lock != NULL) {
+        while (lock->claims != NULL) {
+            NhlLockClaim *next = lock->claims->next;
+            free(lock->claims->url);
+            free(lock->claims);
+            lock->claims = next;
+        }
+        pthread_cond_destroy(&lock->cond);
+        pthread_mutex_destroy(&lock->mutex);
+        free(lock);
+    }
+}
+
+void nhl_lock_acquire(NhlLock *lock) {
+    pthread_mutex_lock(&lock->mutex);
+    take_ownership(lock, 1);
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+void nhl_lock_release(NhlLock *lock) {
+    pthread_mutex_lock(&lock->mutex);
+    if (--lock->depth == 0) {
+        pthread_cond_broadcast(&lock->cond);
+    }
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+int nhl_lock_suspend(NhlLock *lock) {
+    int depth;
+    pthread_mutex_lock(&lock->mutex);
+    depth = lock->depth;
+    lock->depth = 0;
+    pthread_cond_broadcast(&lock->cond);
+    pthread_mutex_unlock(&lock->mutex);
+    return depth;
+}
+
+void nhl_lock_resume(NhlLock *lock, int depth) {
+    pthread_mutex_lock(&lock->mutex);
+    take_ownership(lock, depth);
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+NhlLockClaim *nhl_lock_claim(NhlLock *lock, const char *url, NhlLockClaim **other) {
+    NhlLockClaim *claim;
+    pthread_mutex_lock(&lock->mutex);
+
+    *other = find_claim(lock, url);
+    if (*other != NULL) {
+        ++(*other)->num_waiters;
+        pthread_mutex_unlock(&lock->mutex);
+        return NULL;
+    }
+
+    /* Without memory for the claim, the download is not coalesced, but still made */
+    claim = malloc(sizeof(NhlLockClaim));
+    if (claim != NULL) {
+        claim->url = nhl_copy_string(url);
+        if (claim->url != NULL) {
+            claim->done = 0;
+            claim->result = 0;
+            claim->num_waiters = 0;
+            claim->next = lock->claims;
+            lock->claims = claim;
+        } else {
+            free(claim);
+            claim = NULL;
+        }
+    }
+    pthread_mutex_unlock(&lock->mutex);
+    return claim;
+}
+
+int nhl_lock_wait(NhlLock *lock, NhlLockClaim *claim) {
+    int result;
+    pthread_mutex_lock(&lock->mutex);
+    while (!claim->done) {
+        pthread_cond_wait(&lock->cond, &lock->mutex);
+    }
+    result = claim->result;
+    if (--claim->num_waiters == 0) {
+        free(claim->url);
+        free(claim);
+    }
+    pthread_mutex_unlock(&lock->mutex);
+    return result;
+}
+
+void nhl_lock_unclaim(NhlLock *lock, NhlLockClaim *claim, int result) {
+    NhlLockClaim **prev;
+    pthread_mutex_lock(&lock->mutex);
+    for (prev = &lock->claims; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == claim) {
+            *prev = claim->next;
+            break;
+        }
+    }
+    claim->done = 1;
+    claim->result = result;
+    if (claim->num_waiters == 0) {
+        free(claim->url);
+        free(claim);
+    }
+    pthread_cond_broadcast(&lock->cond);
+    pthread_mutex_unlock(&lock->mutex);
+}
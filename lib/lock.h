@@ -0,0 +1,46 @@
+#ifndef NHL_LOCK_H_
+#define NHL_LOCK_H_
+
+/* Recursive lock of a handle shared by several threads. The thread that owns the lock can acquire
+ * it again, and other threads wait until it has been released as many times. The owner can also
+ * suspend the lock (e.g., during a download) and claim URLs, so that other threads wait for the
+ * claimed URL and use its result instead of downloading it again. */
+typedef struct NhlLock NhlLock;
+
+/* URL being downloaded by one thread and possibly waited for by others. */
+typedef struct NhlLockClaim NhlLockClaim;
+
+/* Create new unowned lock. Returns NULL if error occurs. Release with nhl_lock_delete(). */
+NhlLock *nhl_lock_create(void);
+
+/* Release resources acquired with nhl_lock_create(). The lock must not be owned. */
+void nhl_lock_delete(NhlLock *lock);
+
+/* Acquire the lock, waiting for other threads if necessary. */
+void nhl_lock_acquire(NhlLock *lock);
+
+/* Release the lock acquired by nhl_lock_acquire(). */
+void nhl_lock_release(NhlLock *lock);
+
+/* Release the lock completely, and return the number of times it was acquired. */
+int nhl_lock_suspend(NhlLock *lock);
+
+/* Acquire the lock again after nhl_lock_suspend(), which returned depth. */
+void nhl_lock_resume(NhlLock *lock, int depth);
+
+/* Mark url as being downloaded by the owner, and return the claim, which must be released with
+ * nhl_lock_unclaim(). If the URL has already been claimed, returns NULL and sets *other to the
+ * existing claim, which must then be waited for with nhl_lock_wait(). Returns NULL and sets *other
+ * to NULL if there is no memory for the claim, in which case the URL is downloaded unclaimed. */
+NhlLockClaim *nhl_lock_claim(NhlLock *lock, const char *url, NhlLockClaim **other);
+
+/* Wait until the claim returned via *other by nhl_lock_claim() has been released, and return the
+ * result given to nhl_lock_unclaim(). The lock must not be owned while waiting, see
+ * nhl_lock_suspend(). The claim must not be used after this. */
+int nhl_lock_wait(NhlLock *lock, NhlLockClaim *claim);
+
+/* Release the claim made by nhl_lock_claim() with the result of the download, and wake up the
+ * threads waiting for it. */
+void nhl_lock_unclaim(NhlLock *lock, NhlLockClaim *claim, int result);
+
+#endif /* NHL_LOCK_H_ */
@@ -7,6 +7,7 @@
 #include <nhl/update.h>
 #include <nhl/utils.h>
 #include "cache.h"
+#include "destroy.h"
 #include "dict.h"
 #include "get.h"
 #include "handle.h"
@@ -79,11 +80,18 @@ NhlStatus nhl_player_position_get(Nhl *nhl, const char *position_code, NhlQueryL
 }
 
 void nhl_player_position_unget(Nhl *nhl, NhlPlayerPosition *position) {
-    if (position != NULL && nhl_dict_unref(nhl->player_positions, position) == 0) {
-        delete_position(position);
+    if (position != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->player_positions, position);
+        nhl_handle_unlock(nhl);
     }
 }
 
+void nhl_player_position_destroy(void *position, void *nhl) {
+    (void) nhl;
+    delete_position(position);
+}
+
 
 /* Convert cached roster status to roster status. */
 static NhlPlayerRosterStatus *create_roster_status(const NhlCacheRosterStatus *cache_roster_status) {
@@ -145,11 +153,18 @@ NhlStatus nhl_player_roster_status_get(Nhl *nhl, const char *roster_code, NhlQue
 }
 
 void nhl_player_roster_status_unget(Nhl *nhl, NhlPlayerRosterStatus *roster_status) {
-    if (roster_status != NULL && nhl_dict_unref(nhl->roster_statuses, roster_status) == 0) {
-        delete_roster_status(roster_status);
+    if (roster_status != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->roster_statuses, roster_status);
+        nhl_handle_unlock(nhl);
     }
 }
 
+void nhl_player_roster_status_destroy(void *roster_status, void *nhl) {
+    (void) nhl;
+    delete_roster_status(roster_status);
+}
+
 
 /* Convert cached player to player. */
 static NhlPlayer *create_player(const NhlCachePlayer *cache_player) {
@@ -230,7 +245,8 @@ NhlStatus nhl_player_get(Nhl *nhl, int player_id, NhlQueryLevel level, NhlPlayer
         nhl_dict_insert(nhl->players, &player_id, *player, cache_player->meta->timestamp);
     }
 
-    if (*player != NULL && level & NHL_QUERY_BASIC) {
+    if (*player != NULL && level & NHL_QUERY_BASIC &&
+            nhl_links_refreshable(nhl, (*player)->current_team && (*player)->primary_position && (*player)->roster_status)) {
         int team_id = 0;
         NhlTeam *team_old = (*player)->current_team;
         NhlTeam *team;
@@ -279,10 +295,18 @@ NhlStatus nhl_player_get(Nhl *nhl, int player_id, NhlQueryLevel level, NhlPlayer
 }
 
 void nhl_player_unget(Nhl *nhl, NhlPlayer *player) {
-    if (player != NULL && nhl_dict_unref(nhl->players, player) == 0) {
-        nhl_team_unget(nhl, player->current_team);
-        nhl_player_roster_status_unget(nhl, player->roster_status);
-        nhl_player_position_unget(nhl, player->primary_position);
-        delete_player(player);
+    if (player != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->players, player);
+        nhl_handle_unlock(nhl);
     }
 }
+
+void nhl_player_destroy(void *ptr, void *nhl_ptr) {
+    Nhl *nhl = nhl_ptr;
+    NhlPlayer *player = ptr;
+    nhl_team_unget(nhl, player->current_team);
+    nhl_player_roster_status_unget(nhl, player->roster_status);
+    nhl_player_position_unget(nhl, player->primary_position);
+    delete_player(player);
+}
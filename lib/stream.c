@@ -0,0 +1,527 @@
+#include "stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+
+/* Kinds of tokens that can be split between two pieces of input. */
+typedef enum NhlJsonToken {
+    NHL_JSON_TOKEN_NONE,    /* between tokens */
+    NHL_JSON_TOKEN_STRING,  /* inside a string */
+    NHL_JSON_TOKEN_ESCAPE,  /* after a backslash inside a string */
+    NHL_JSON_TOKEN_UNICODE, /* inside \uXXXX escape sequence */
+    NHL_JSON_TOKEN_LITERAL  /* inside a number, true, false or null */
+} NhlJsonToken;
+
+/* What can come next between tokens, apart from whitespace. */
+typedef enum NhlJsonExpect {
+    NHL_JSON_EXPECT_VALUE,       /* value at the beginning, or after a colon or a comma in an array */
+    NHL_JSON_EXPECT_FIRST_VALUE, /* value, or the end of an empty array */
+    NHL_JSON_EXPECT_KEY,         /* member name after a comma in an object */
+    NHL_JSON_EXPECT_FIRST_KEY,   /* member name, or the end of an empty object */
+    NHL_JSON_EXPECT_COLON,       /* colon after a member name */
+    NHL_JSON_EXPECT_NEXT         /* comma or the end of the container, or the end of the document */
+} NhlJsonExpect;
+
+/* Open container. */
+typedef struct NhlJsonFrame {
+    cJSON *node;
+    char *name;   /* member name in the parent object, or NULL */
+    int detached; /* nonzero if the container is handed to the callback when complete */
+} NhlJsonFrame;
+
+struct NhlJsonStream {
+    const char *const *path;
+    int path_len;
+    NhlJsonElementCb element_cb;
+    void *userdata;
+
+    NhlJsonFrame *stack; /* open containers, root first */
+    int depth;
+    int allocated;
+    cJSON *root;
+
+    NhlJsonToken token;
+    char *text;          /* string or literal being read */
+    size_t text_len;
+    size_t text_allocated;
+    unsigned long unicode;
+    int unicode_digits;
+    unsigned long high_surrogate;
+
+    char *key;           /* member name waiting for its value */
+    NhlJsonExpect expect;
+    int error;
+};
+
+NhlJsonStream *nhl_json_stream_create(const char *const *path, int path_len,
+                                      NhlJsonElementCb element_cb, void *userdata) {
+    NhlJsonStream *stream = calloc(1, sizeof(NhlJsonStream));
+    if (stream != NULL) {
+        stream->path = path;
+        stream->path_len = path_len;
+        stream->element_cb = element_cb;
+        stream->userdata = userdata;
+    }
+    return stream;
+}
+
+void nhl_json_stream_delete(NhlJsonStream *stream) {
+    if (stream != NULL) {
+        int idx;
+        for (idx = 0; idx != stream->depth; ++idx) {
+            if (stream->stack[idx].detached) {
+                cJSON_Delete(stream->stack[idx].node);
+            }
+            free(stream->stack[idx].name);
+        }
+        cJSON_Delete(stream->root);
+        free(stream->stack);
+        free(stream->text);
+        free(stream->key);
+        free(stream);
+    }
+}
+
+cJSON *nhl_json_stream_ancestor(const NhlJsonStream *stream, int up) {
+    return 0 < up && up <= stream->depth ? stream->stack[stream->depth - up].node : NULL;
+}
+
+/* Append bytes to the current token. */
+static void append_text(NhlJsonStream *stream, const char *bytes, size_t len) {
+    if (stream->text_allocated < stream->text_len + len + 1) {
+        size_t allocated = 2 * (stream->text_len + len + 1);
+        char *text = realloc(stream->text, allocated);
+        if (text == NULL) {
+            stream->error = 1;
+            return;
+        }
+        stream->text = text;
+        stream->text_allocated = allocated;
+    }
+    memcpy(stream->text + stream->text_len, bytes, len);
+    stream->text_len += len;
+    stream->text[stream->text_len] = '\0';
+}
+
+/* Append Unicode code point to the current token as UTF-8. */
+static void append_code_point(NhlJsonStream *stream, unsigned long code) {
+    char utf8[4];
+    size_t len;
+    if (code < 0x80) {
+        utf8[0] = (char) code;
+        len = 1;
+    } else if (code < 0x800) {
+        utf8[0] = (char) (0xC0 | (code >> 6));
+        utf8[1] = (char) (0x80 | (code & 0x3F));
+        len = 2;
+    } else if (code < 0x10000) {
+        utf8[0] = (char) (0xE0 | (code >> 12));
+        utf8[1] = (char) (0x80 | ((code >> 6) & 0x3F));
+        utf8[2] = (char) (0x80 | (code & 0x3F));
+        len = 3;
+    } else {
+        utf8[0] = (char) (0xF0 | (code >> 18));
+        utf8[1] = (char) (0x80 | ((code >> 12) & 0x3F));
+        utf8[2] = (char) (0x80 | ((code >> 6) & 0x3F));
+        utf8[3] = (char) (0x80 | (code & 0x3F));
+        len = 4;
+    }
+    append_text(stream, utf8, len);
+}
+
+/* Returns nonzero if a container opened at the current depth with the given member name is at the
+ * path of detached elements. */
+static int at_path(const NhlJsonStream *stream, const char *name) {
+    int idx;
+    if (stream->path_len == 0 || stream->depth != stream->path_len) {
+        return 0;
+    }
+    for (idx = 1; idx <= stream->path_len; ++idx) {
+        const char *expected = stream->path[idx - 1];
+        const char *actual = idx < stream->depth ? stream->stack[idx].name : name;
+        if ((expected == NULL) != (actual == NULL) || (expected != NULL && strcmp(expected, actual) != 0)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Add a complete value to the innermost open container. */
+static void add_value(NhlJsonStream *stream, cJSON *item) {
+    cJSON *parent;
+    if (item == NULL) {
+        stream->error = 1;
+        return;
+    }
+    if (stream->depth == 0) {
+        if (stream->root != NULL) {
+            cJSON_Delete(item);
+            stream->error = 1;
+            return;
+        }
+        stream->root = item;
+        return;
+    }
+
+    parent = stream->stack[stream->depth - 1].node;
+    if (parent->type == cJSON_Object) {
+        if (stream->key == NULL) {
+            cJSON_Delete(item);
+            stream->error = 1;
+            return;
+        }
+        cJSON_AddItemToObject(parent, stream->key, item);
+        free(stream->key);
+        stream->key = NULL;
+    } else {
+        cJSON_AddItemToArray(parent, item);
+    }
+}
+
+/* Open new object or array. */
+static void open_container(NhlJsonStream *stream, cJSON *node) {
+    NhlJsonFrame *frame;
+    char *name = stream->key;
+    int detached;
+
+    if (node == NULL) {
+        stream->error = 1;
+        return;
+    }
+    if (stream->depth == stream->allocated) {
+        int allocated = stream->allocated > 0 ? 2 * stream->allocated : 8;
+        NhlJsonFrame *stack = realloc(stream->stack, allocated * sizeof(NhlJsonFrame));
+        if (stack == NULL) {
+            cJSON_Delete(node);
+            stream->error = 1;
+            return;
+        }
+        stream->stack = stack;
+        stream->allocated = allocated;
+    }
+
+    detached = at_path(stream, name);
+    if (detached) {
+        stream->key = NULL;
+    } else {
+        /* Member name is copied by cJSON, but kept for matching the path */
+        if (name != NULL && (name = nhl_copy_string(name)) == NULL) {
+            cJSON_Delete(node);
+            stream->error = 1;
+            return;
+        }
+        add_value(stream, node);
+        if (stream->error) {
+            free(name);
+            return;
+        }
+    }
+
+    frame = &stream->stack[stream->depth++];
+    frame->node = node;
+    frame->name = name;
+    frame->detached = detached;
+    stream->expect = node->type == cJSON_Object ? NHL_JSON_EXPECT_FIRST_KEY : NHL_JSON_EXPECT_FIRST_VALUE;
+}
+
+/* Close the innermost object or array. */
+static void close_container(NhlJsonStream *stream, int type) {
+    NhlJsonFrame frame;
+    if (stream->depth == 0 || stream->stack[stream->depth - 1].node->type != type || stream->key != NULL) {
+        stream->error = 1;
+        return;
+    }
+
+    frame = stream->stack[--stream->depth];
+    if (frame.detached) {
+        if (stream->element_cb != NULL) {
+            stream->element_cb(stream, frame.node, stream->userdata);
+        }
+        cJSON_Delete(frame.node);
+    }
+    free(frame.name);
+    stream->expect = NHL_JSON_EXPECT_NEXT;
+}
+
+/* Finish string token, which is either a member name or a value. */
+static void finish_string(NhlJsonStream *stream) {
+    const char *text = stream->text != NULL ? stream->text : "";
+
+    if (stream->expect == NHL_JSON_EXPECT_KEY || stream->expect == NHL_JSON_EXPECT_FIRST_KEY) {
+        stream->key = nhl_copy_string(text);
+        if (stream->key == NULL) {
+            stream->error = 1;
+        }
+        stream->expect = NHL_JSON_EXPECT_COLON;
+    } else {
+        add_value(stream, cJSON_CreateString(text));
+        stream->expect = NHL_JSON_EXPECT_NEXT;
+    }
+    stream->text_len = 0;
+    stream->token = NHL_JSON_TOKEN_NONE;
+}
+
+/* Returns nonzero if text is a number as defined by JSON. */
+static int is_number(const char *text) {
+    if (*text == '-') {
+        ++text;
+    }
+    if (*text == '0') {
+        ++text;
+    } else if ('1' <= *text && *text <= '9') {
+        while ('0' <= *text && *text <= '9')
+            ++text;
+    } else {
+        return 0;
+    }
+    if (*text == '.') {
+        if (!('0' <= *++text && *text <= '9'))
+            return 0;
+        while ('0' <= *text && *text <= '9')
+            ++text;
+    }
+    if (*text == 'e' || *text == 'E') {
+        ++text;
+        if (*text == '+' || *text == '-')
+            ++text;
+        if (!('0' <= *text && *text <= '9'))
+            return 0;
+        while ('0' <= *text && *text <= '9')
+            ++text;
+    }
+    return *text == '\0';
+}
+
+/* Finish number or other literal token. */
+static void finish_literal(NhlJsonStream *stream) {
+    const char *text = stream->text != NULL ? stream->text : "";
+    if (strcmp(text, "true") == 0) {
+        add_value(stream, cJSON_CreateTrue());
+    } else if (strcmp(text, "false") == 0) {
+        add_value(stream, cJSON_CreateFalse());
+    } else if (strcmp(text, "null") == 0) {
+        add_value(stream, cJSON_CreateNull());
+    } else if (is_number(text)) {
+        add_value(stream, cJSON_CreateNumber(strtod(text, NULL)));
+    } else {
+        stream->error = 1;
+    }
+    stream->expect = NHL_JSON_EXPECT_NEXT;
+    stream->text_len = 0;
+    stream->token = NHL_JSON_TOKEN_NONE;
+}
+
+/* Value of a hexadecimal digit, or -1. */
+static int hex_value(char c) {
+    if ('0' <= c && c <= '9')
+        return c - '0';
+    if ('a' <= c && c <= 'f')
+        return c - 'a' + 10;
+    if ('A' <= c && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* Read the escape sequence after a backslash. */
+static void read_escape(NhlJsonStream *stream, char c) {
+    char unescaped;
+    if (stream->high_surrogate != 0 && c != 'u') {
+        stream->error = 1;
+        return;
+    }
+    switch (c) {
+        case 'b': unescaped = '\b'; break;
+        case 'f': unescaped = '\f'; break;
+        case 'n': unescaped = '\n'; break;
+        case 'r': unescaped = '\r'; break;
+        case 't': unescaped = '\t'; break;
+        case 'u':
+            stream->unicode = 0;
+            stream->unicode_digits = 0;
+            stream->token = NHL_JSON_TOKEN_UNICODE;
+            return;
+        case '"':
+        case '\\':
+        case '/':
+            unescaped = c;
+            break;
+        default:
+            stream->error = 1;
+            return;
+    }
+    append_text(stream, &unescaped, 1);
+    stream->token = NHL_JSON_TOKEN_STRING;
+}
+
+/* Read a hexadecimal digit of \uXXXX escape sequence. Surrogate pairs are combined, and unpaired
+ * surrogates are errors. */
+static void read_unicode(NhlJsonStream *stream, char c) {
+    int digit = hex_value(c);
+    if (digit < 0) {
+        stream->error = 1;
+        return;
+    }
+    stream->unicode = 16 * stream->unicode + digit;
+    if (++stream->unicode_digits < 4) {
+        return;
+    }
+
+    if (stream->high_surrogate != 0) {
+        if (stream->unicode < 0xDC00 || 0xE000 <= stream->unicode) {
+            stream->error = 1;
+            return;
+        }
+        append_code_point(stream, 0x10000 + ((stream->high_surrogate - 0xD800) << 10) + (stream->unicode - 0xDC00));
+        stream->high_surrogate = 0;
+    } else if (0xD800 <= stream->unicode && stream->unicode < 0xDC00) {
+        stream->high_surrogate = stream->unicode;
+    } else if (0xDC00 <= stream->unicode && stream->unicode < 0xE000) {
+        stream->error = 1;
+        return;
+    } else {
+        append_code_point(stream, stream->unicode);
+    }
+    stream->token = NHL_JSON_TOKEN_STRING;
+}
+
+/* Returns nonzero if a value can begin at the current position. */
+static int expects_value(const NhlJsonStream *stream) {
+    return stream->expect == NHL_JSON_EXPECT_VALUE || stream->expect == NHL_JSON_EXPECT_FIRST_VALUE;
+}
+
+int nhl_json_stream_feed(NhlJsonStream *stream, const char *bytes, size_t len) {
+    const char *end = bytes + len;
+
+    while (bytes != end && !stream->error) {
+        char c = *bytes;
+
+        switch (stream->token) {
+            case NHL_JSON_TOKEN_STRING: {
+                /* Copy plain characters at once. A high surrogate must be followed by the escape
+                 * sequence of a low one, and control characters must be escaped. */
+                const char *run = bytes;
+                if (stream->high_surrogate != 0 && c != '\\') {
+                    stream->error = 1;
+                    continue;
+                }
+                while (run != end && *run != '"' && *run != '\\' && (unsigned char) *run >= 0x20) {
+                    ++run;
+                }
+                append_text(stream, bytes, run - bytes);
+                bytes = run;
+                if (bytes != end) {
+                    if (*bytes == '"') {
+                        finish_string(stream);
+                    } else if (*bytes == '\\') {
+                        stream->token = NHL_JSON_TOKEN_ESCAPE;
+                    } else {
+                        stream->error = 1;
+                    }
+                    ++bytes;
+                }
+                continue;
+            }
+            case NHL_JSON_TOKEN_ESCAPE:
+                read_escape(stream, c);
+                ++bytes;
+                continue;
+            case NHL_JSON_TOKEN_UNICODE:
+                read_unicode(stream, c);
+                ++bytes;
+                continue;
+            case NHL_JSON_TOKEN_LITERAL:
+                if (('0' <= c && c <= '9') || ('a' <= c && c <= 'z') || c == '-' || c == '+' || c == '.' ||
+                        c == 'E') {
+                    append_text(stream, &c, 1);
+                    ++bytes;
+                    continue;
+                }
+                finish_literal(stream);
+                continue; /* c is not consumed */
+            default:
+                break;
+        }
+
+        /* Separators and brackets are only accepted where the grammar allows them */
+        switch (c) {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                break;
+            case ':':
+                if (stream->expect != NHL_JSON_EXPECT_COLON) {
+                    stream->error = 1;
+                }
+                stream->expect = NHL_JSON_EXPECT_VALUE;
+                break;
+            case ',':
+                if (stream->expect != NHL_JSON_EXPECT_NEXT || stream->depth == 0) {
+                    stream->error = 1;
+                    break;
+                }
+                stream->expect = stream->stack[stream->depth - 1].node->type == cJSON_Object ?
+                                 NHL_JSON_EXPECT_KEY : NHL_JSON_EXPECT_VALUE;
+                break;
+            case '{':
+            case '[':
+                if (!expects_value(stream)) {
+                    stream->error = 1;
+                    break;
+                }
+                open_container(stream, c == '{' ? cJSON_CreateObject() : cJSON_CreateArray());
+                break;
+            case '}':
+                if (stream->expect != NHL_JSON_EXPECT_NEXT && stream->expect != NHL_JSON_EXPECT_FIRST_KEY) {
+                    stream->error = 1;
+                    break;
+                }
+                close_container(stream, cJSON_Object);
+                break;
+            case ']':
+                if (stream->expect != NHL_JSON_EXPECT_NEXT && stream->expect != NHL_JSON_EXPECT_FIRST_VALUE) {
+                    stream->error = 1;
+                    break;
+                }
+                close_container(stream, cJSON_Array);
+                break;
+            case '"':
+                if (!expects_value(stream) && stream->expect != NHL_JSON_EXPECT_KEY &&
+                        stream->expect != NHL_JSON_EXPECT_FIRST_KEY) {
+                    stream->error = 1;
+                    break;
+                }
+                stream->token = NHL_JSON_TOKEN_STRING;
+                stream->text_len = 0;
+                append_text(stream, "", 0);
+                break;
+            default:
+                if (!expects_value(stream)) {
+                    stream->error = 1;
+                    break;
+                }
+                stream->token = NHL_JSON_TOKEN_LITERAL;
+                stream->text_len = 0;
+                append_text(stream, &c, 1);
+                break;
+        }
+        ++bytes;
+    }
+    return !stream->error;
+}
+
+cJSON *nhl_json_stream_finish(NhlJsonStream *stream) {
+    cJSON *root;
+    if (stream->token == NHL_JSON_TOKEN_LITERAL) {
+        finish_literal(stream);
+    }
+    if (stream->error || stream->depth != 0 || stream->token != NHL_JSON_TOKEN_NONE ||
+            stream->expect != NHL_JSON_EXPECT_NEXT) {
+        return NULL;
+    }
+    root = stream->root;
+    stream->root = NULL;
+    return root;
+}
@@ -0,0 +1,44 @@
+#ifndef NHL_STREAM_H_
+#define NHL_STREAM_H_
+
+#include <stddef.h>
+
+#include <cjson/cJSON.h>
+
+/* Incremental JSON parser that can be fed with arbitrary pieces of a document, e.g., directly from
+ * a download callback. Selected elements of the document are handed out as separate trees as soon
+ * as they are complete, and released after that, so that the whole document is never kept in
+ * memory at once. */
+typedef struct NhlJsonStream NhlJsonStream;
+
+/* Callback for a complete element. The element is owned by the stream and deleted after the call,
+ * but its ancestors can be inspected with nhl_json_stream_ancestor() during the call. */
+typedef void (*NhlJsonElementCb)(NhlJsonStream *stream, cJSON *element, void *userdata);
+
+/* Create new parser. Containers found at path are handed to element_cb instead of being added to
+ * the document. The path is an array of path_len member names, where NULL stands for any element
+ * of an array. For example, {"dates", NULL, "games", NULL} selects every element of each "games"
+ * array inside the "dates" array of the root object. If path_len is zero, the whole document is
+ * kept. The path must remain valid for the lifetime of the parser. Release with
+ * nhl_json_stream_delete(). */
+NhlJsonStream *nhl_json_stream_create(const char *const *path, int path_len,
+                                      NhlJsonElementCb element_cb, void *userdata);
+
+/* Release resources acquired with nhl_json_stream_create(). */
+void nhl_json_stream_delete(NhlJsonStream *stream);
+
+/* Parse the next len bytes of the document. Returns zero if the document is not valid JSON, in
+ * which case further input is ignored. */
+int nhl_json_stream_feed(NhlJsonStream *stream, const char *bytes, size_t len);
+
+/* Return the document without the elements handed to the callback, or NULL if the document is
+ * invalid or incomplete. The caller takes the ownership of the returned tree and must release it
+ * with cJSON_Delete(). */
+cJSON *nhl_json_stream_finish(NhlJsonStream *stream);
+
+/* Return the container that is up levels above the element being handed to the callback (one
+ * means the parent), or NULL if there is no such container. Containers are complete only up to the
+ * element. */
+cJSON *nhl_json_stream_ancestor(const NhlJsonStream *stream, int up);
+
+#endif /* NHL_STREAM_H_ */
@@ -5,6 +5,7 @@
 
 #include <nhl/update.h>
 #include "cache.h"
+#include "destroy.h"
 #include "dict.h"
 #include "get.h"
 #include "handle.h"
@@ -87,7 +88,8 @@ NhlStatus nhl_team_get(Nhl *nhl, int team_id, NhlQueryLevel level, NhlTeam **tea
         nhl_dict_insert(nhl->teams, &team_id, *team, cache_team->meta->timestamp);
     }
 
-    if (*team != NULL && level & NHL_QUERY_BASIC) {
+    if (*team != NULL && level & NHL_QUERY_BASIC &&
+            nhl_links_refreshable(nhl, (*team)->franchise && (*team)->conference && (*team)->division)) {
         int franchise_id = 0;
         NhlFranchise *franchise_old = (*team)->franchise;
         NhlFranchise *franchise;
@@ -139,12 +141,24 @@ NhlStatus nhl_team_get(Nhl *nhl, int team_id, NhlQueryLevel level, NhlTeam **tea
 }
 
 void nhl_team_unget(Nhl *nhl, NhlTeam *team) {
-    if (team != NULL && nhl_dict_unref(nhl->teams, team) == 0) {
-        nhl_franchise_unget(nhl, team->franchise);
-        nhl_conference_unget(nhl, team->conference);
-        nhl_division_unget(nhl, team->division);
-        delete_team(team);
+    if (team != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->teams, team);
+        nhl_handle_unlock(nhl);
+    }
+}
+
+void nhl_team_destroy(void *ptr, void *nhl_ptr) {
+    Nhl *nhl = nhl_ptr;
+    NhlTeam *team = ptr;
+    /* Franchise may outlive the team, so it must not keep a pointer to it */
+    if (team->franchise != NULL && team->franchise->most_recent_team == team) {
+        team->franchise->most_recent_team = NULL;
     }
+    nhl_franchise_unget(nhl, team->franchise);
+    nhl_conference_unget(nhl, team->conference);
+    nhl_division_unget(nhl, team->division);
+    delete_team(team);
 }
 
 
@@ -202,7 +216,8 @@ NhlStatus nhl_franchise_get(Nhl *nhl, int franchise_id, NhlQueryLevel level, Nhl
         nhl_dict_insert(nhl->franchises, &franchise_id, *franchise, cache_franchise->meta->timestamp);
     }
 
-    if (*franchise != NULL && level & NHL_QUERY_BASIC && !(level & team_recursion)) {
+    if (*franchise != NULL && level & NHL_QUERY_BASIC && !(level & team_recursion) &&
+            nhl_links_refreshable(nhl, (*franchise)->most_recent_team != NULL)) {
         int team_id = 0;
         NhlTeam *team_old = (*franchise)->most_recent_team;
         NhlTeam *team;
@@ -232,8 +247,20 @@ NhlStatus nhl_franchise_get(Nhl *nhl, int franchise_id, NhlQueryLevel level, Nhl
 }
 
 void nhl_franchise_unget(Nhl *nhl, NhlFranchise *franchise) {
-    if (franchise != NULL && nhl_dict_unref(nhl->franchises, franchise) == 0) {
-        nhl_team_unget(nhl, franchise->most_recent_team);
-        delete_franchise(franchise);
+    if (franchise != NULL) {
+        nhl_handle_lock(nhl);
+        nhl_dict_unref(nhl->franchises, franchise);
+        nhl_handle_unlock(nhl);
+    }
+}
+
+void nhl_franchise_destroy(void *ptr, void *nhl_ptr) {
+    Nhl *nhl = nhl_ptr;
+    NhlFranchise *franchise = ptr;
+    /* Team may outlive the franchise, so it must not keep a pointer to it */
+    if (franchise->most_recent_team != NULL && franchise->most_recent_team->franchise == franchise) {
+        franchise->most_recent_team->franchise = NULL;
     }
+    nhl_team_unget(nhl, franchise->most_recent_team);
+    delete_franchise(franchise);
 }
@@ -1,166 +1,264 @@
 #include <nhl/update.h>
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <cjson/cJSON.h>
 #include <curl/curl.h>
+#include <sqlite3.h>
 
+#include <nhl/utils.h>
+#include "arena.h"
 #include "cache.h"
+#include "get.h"
 #include "handle.h"
-#include "list.h"
-#include "mem.h"
+#include "stream.h"
+#include "visited.h"
 
 
-/* Macro for reading nodes from a JSON tree.
- * TODO: The usage of static variable is a bit hacky and definitely not thread-safe.
- */
-static cJSON *leaf;
-#define read_leaf(parent, name, type) \
-    (leaf = cJSON_GetObjectItemCaseSensitive((parent), (name)), leaf ? leaf->type : 0);
+/* Read a string member of a JSON object. Returns NULL if the member does not exist. */
+static char *read_string(const cJSON *parent, const char *name) {
+    cJSON *leaf = cJSON_GetObjectItemCaseSensitive(parent, name);
+    return leaf != NULL ? leaf->valuestring : NULL;
+}
+
+/* Read an integer member of a JSON object. Returns zero if the member does not exist. */
+static int read_int(const cJSON *parent, const char *name) {
+    cJSON *leaf = cJSON_GetObjectItemCaseSensitive(parent, name);
+    return leaf != NULL ? leaf->valueint : 0;
+}
+
+
+/* Maximum number of simultaneous connections to a single host in batch downloads. */
+#define NHL_MAX_CONNECTIONS 6L
+
+/* Size of the blocks of the arena that holds the games of a response. */
+#define NHL_RECORD_BLOCK_SIZE 16384
 
+/* Offset basis and prime of the 64-bit FNV-1a hash of response bodies. */
+#define NHL_DIGEST_BASIS (((sqlite3_uint64) 0xcbf29ce4UL << 32) | 0x84222325UL)
+#define NHL_DIGEST_PRIME (((sqlite3_uint64) 1 << 40) + 0x1b3)
 
-/* User data for CURL write callback function. */
+typedef struct NhlGameRecord NhlGameRecord;
+
+/* State of a single request, shared by CURL callback functions. */
 typedef struct cb_data {
-    char *str; /* null-terminated data, or NULL */
-    size_t len; /* string length (without terminator) */
+    CURL *curl;
+    NhlUpdateContentType type;
+    NhlCacheMeta meta; /* metadata of the rows read from the response */
+    NhlStatus status; /* NHL_MEMORY_ERROR if the parser runs out of memory */
+    NhlJsonStream *stream; /* parser of the body, or NULL if out of memory */
+    NhlArena *arena; /* rows of the games of a schedule, or NULL */
+    NhlGameRecord *games; /* games of a schedule in the order of the response */
+    NhlGameRecord *last_game;
+    size_t len; /* length of the response body */
+    sqlite3_uint64 digest; /* hash of the response body */
+    long code; /* HTTP response code, or zero for other protocols */
+    char *etag; /* ETag response header, or NULL */
+    char *last_modified; /* Last-Modified response header, or NULL */
+    struct curl_slist *headers; /* Conditional request headers */
+    NhlCacheResponse *cached; /* Previous response from the same URL, or NULL */
 } cb_data;
 
-/* CURL write callback function. */
+/* CURL write callback function. The body is fed to the parser as it arrives, so that it is never
+ * kept in memory as a whole. The transfer is aborted as soon as the body turns out to be invalid. */
 static size_t read_url_cb(void *url_contents, size_t size, size_t len, void *writedata) {
     size_t bytes = size * len;
     cb_data *data = writedata;
-    data->str = realloc(data->str, data->len + bytes + 1);
-    if (data->str == NULL) {
-        fprintf(stderr, "FATAL ERROR: realloc failure!\n");
-        exit(EXIT_FAILURE);
+    size_t idx;
+
+    if (data->len == 0) {
+        curl_easy_getinfo(data->curl, CURLINFO_RESPONSE_CODE, &data->code);
     }
-    memcpy(data->str + data->len, url_contents, bytes);
     data->len += bytes;
-    data->str[data->len] = '\0';
+    for (idx = 0; idx != bytes; ++idx) {
+        data->digest = (data->digest ^ ((unsigned char *) url_contents)[idx]) * NHL_DIGEST_PRIME;
+    }
+
+    if (data->code >= 400) {
+        return bytes; /* Error pages are not parsed */
+    }
+    if (data->stream == NULL) {
+        data->status |= NHL_MEMORY_ERROR;
+        return 0;
+    }
+    if (!nhl_json_stream_feed(data->stream, url_contents, bytes) || data->status & NHL_MEMORY_ERROR) {
+        return 0;
+    }
     return bytes;
 }
 
-/* Read URL into a string. The returned string must be released with free(). */
-static char *read_url(Nhl *nhl, const char *url) {
-    cb_data data = { NULL, 0 };
-    if (nhl->params->verbose) {
-        fprintf(stderr, "Receiving %s ...", url);
+/* Return a copy of the header value if the header line has the given name, or NULL otherwise. */
+static char *read_header(const char *line, size_t len, const char *name) {
+    size_t name_len = strlen(name);
+    size_t idx;
+    char *value;
+
+    if (len <= name_len || line[name_len] != ':') {
+        return NULL;
+    }
+    for (idx = 0; idx != name_len; ++idx) {
+        if (tolower((unsigned char) line[idx]) != tolower((unsigned char) name[idx])) {
+            return NULL;
+        }
     }
 
-    curl_easy_setopt(nhl->curl, CURLOPT_URL, url);
-    curl_easy_setopt(nhl->curl, CURLOPT_WRITEFUNCTION, read_url_cb);
-    curl_easy_setopt(nhl->curl, CURLOPT_WRITEDATA, &data);
-    curl_easy_perform(nhl->curl);
+    line += name_len + 1;
+    len -= name_len + 1;
+    while (len > 0 && (*line == ' ' || *line == '\t')) {
+        ++line;
+        --len;
+    }
+    while (len > 0 && isspace((unsigned char) line[len-1])) {
+        --len;
+    }
+    value = malloc(len + 1);
+    memcpy(value, line, len);
+    value[len] = '\0';
+    return value;
+}
 
-    if (nhl->params->verbose) {
-        fprintf(stderr, " %s\n", data.str != NULL ? "OK." : "Failed!");
+/* CURL header callback function. */
+static size_t read_header_cb(char *line, size_t size, size_t len, void *headerdata) {
+    size_t bytes = size * len;
+    cb_data *data = headerdata;
+    char *value;
+
+    if ((value = read_header(line, bytes, "ETag")) != NULL) {
+        free(data->etag);
+        data->etag = value;
+    } else if ((value = read_header(line, bytes, "Last-Modified")) != NULL) {
+        free(data->last_modified);
+        data->last_modified = value;
     }
-    return data.str;
+    return bytes;
 }
 
+/* Append a request header "<name>: <value>" to a list of headers, unless value is empty. */
+static struct curl_slist *append_header(struct curl_slist *headers, const char *name, const char *value) {
+    if (value != NULL && value[0] != '\0') {
+        char *line = malloc(strlen(name) + strlen(value) + 3);
+        sprintf(line, "%s: %s", name, value);
+        headers = curl_slist_append(headers, line);
+        free(line);
+    }
+    return headers;
+}
 
-/* Period updater needed by update_from_linescore(). */
-static NhlStatus update_from_period(Nhl *nhl, cJSON *period, int game, int period_idx, NhlCacheMeta *meta) {
-    NhlStatus status = 0;
-    NhlCachePeriod p = {0};
+/* Read a string member of a JSON object into the arena. Returns NULL if the member does not exist,
+ * or if the arena is out of memory. */
+static char *copy_string(NhlArena *arena, const cJSON *parent, const char *name) {
+    return nhl_arena_copy_string(arena, read_string(parent, name));
+}
+
+/* Period reader needed by read_linescore(). Strings of p are allocated from the arena. */
+static void read_period(NhlArena *arena, cJSON *period, int game, int period_idx, NhlCacheMeta *meta,
+                        NhlCachePeriod *p) {
     cJSON *away;
     cJSON *home;
 
-    p.game = game;
-    p.periodIndex = period_idx;
+    memset(p, 0, sizeof(NhlCachePeriod));
+    p->game = game;
+    p->periodIndex = period_idx;
 
-    p.periodType = read_leaf(period, "periodType", valuestring);
-    p.startTime = read_leaf(period, "startTime", valuestring);
-    p.endTime = read_leaf(period, "endTime", valuestring);
-    p.num = read_leaf(period, "num", valueint);
-    p.ordinalNum = read_leaf(period, "ordinalNum", valuestring);
+    p->periodType = copy_string(arena, period, "periodType");
+    p->startTime = copy_string(arena, period, "startTime");
+    p->endTime = copy_string(arena, period, "endTime");
+    p->num = read_int(period, "num");
+    p->ordinalNum = copy_string(arena, period, "ordinalNum");
 
     away = cJSON_GetObjectItemCaseSensitive(period, "away");
-    p.awayGoals = read_leaf(away, "goals", valueint);
-    p.awayShotsOnGoal = read_leaf(away, "shotsOnGoal", valueint);
-    p.awayRinkSide = read_leaf(away, "rinkSide", valuestring);
+    p->awayGoals = read_int(away, "goals");
+    p->awayShotsOnGoal = read_int(away, "shotsOnGoal");
+    p->awayRinkSide = copy_string(arena, away, "rinkSide");
 
     home = cJSON_GetObjectItemCaseSensitive(period, "home");
-    p.homeGoals = read_leaf(home, "goals", valueint);
-    p.homeShotsOnGoal = read_leaf(home, "shotsOnGoal", valueint);
-    p.homeRinkSide = read_leaf(home, "rinkSide", valuestring);
+    p->homeGoals = read_int(home, "goals");
+    p->homeShotsOnGoal = read_int(home, "shotsOnGoal");
+    p->homeRinkSide = copy_string(arena, home, "rinkSide");
 
-    p.meta = meta;
-    status |= nhl_cache_period_put(nhl, &p);
-    return status;
+    p->meta = meta;
 }
 
-/* Linescore updater needed by update_from_game(). */
-static NhlStatus update_from_linescore(Nhl *nhl, cJSON *linescore, int game, NhlCacheMeta *meta) {
-    NhlStatus status = 0;
-    NhlCacheLinescore s = {0};
-    cJSON *periods;
+/* Linescore reader needed by read_game() and update_from_game_linescore(). Strings of s and the
+ * periods of the linescore are allocated from the arena. */
+static void read_linescore(NhlArena *arena, cJSON *linescore, int game, NhlCacheMeta *meta,
+                           NhlCacheLinescore *s, NhlCachePeriod **periods, int *num_periods) {
+    cJSON *periods_arr;
     cJSON *periods_elem;
     cJSON *shootoutInfo;
     cJSON *teams;
     cJSON *team;
     cJSON *intermissionInfo;
     cJSON *powerPlayInfo;
-    int period_idx = 0;
 
-    s.game = game;
+    memset(s, 0, sizeof(NhlCacheLinescore));
+    s->game = game;
 
-    s.currentPeriod = read_leaf(linescore, "currentPeriod", valueint);
-    s.currentPeriodOrdinal = read_leaf(linescore, "currentPeriodOrdinal", valuestring);
-    s.currentPeriodTimeRemaining = read_leaf(linescore, "currentPeriodTimeRemaining", valuestring);
+    s->currentPeriod = read_int(linescore, "currentPeriod");
+    s->currentPeriodOrdinal = copy_string(arena, linescore, "currentPeriodOrdinal");
+    s->currentPeriodTimeRemaining = copy_string(arena, linescore, "currentPeriodTimeRemaining");
 
-    periods = cJSON_GetObjectItemCaseSensitive(linescore, "periods");
-    nhl_cache_periods_reset(nhl, s.game);
-    cJSON_ArrayForEach(periods_elem, periods) {
-        status |= update_from_period(nhl, periods_elem, s.game, period_idx, meta);
-        ++period_idx;
+    periods_arr = cJSON_GetObjectItemCaseSensitive(linescore, "periods");
+    *periods = nhl_arena_alloc(arena, (cJSON_GetArraySize(periods_arr) + 1) * sizeof(NhlCachePeriod));
+    *num_periods = 0;
+    cJSON_ArrayForEach(periods_elem, periods_arr) {
+        if (*periods != NULL) {
+            read_period(arena, periods_elem, game, *num_periods, meta, &(*periods)[*num_periods]);
+            ++*num_periods;
+        }
     }
 
     shootoutInfo = cJSON_GetObjectItemCaseSensitive(linescore, "shootoutInfo");
     team = cJSON_GetObjectItemCaseSensitive(shootoutInfo, "away");
-    s.awayShootoutScores = read_leaf(team, "scores", valueint);
-    s.awayShootoutAttempts = read_leaf(team, "attempts", valueint);
+    s->awayShootoutScores = read_int(team, "scores");
+    s->awayShootoutAttempts = read_int(team, "attempts");
     team = cJSON_GetObjectItemCaseSensitive(shootoutInfo, "home");
-    s.homeShootoutScores = read_leaf(team, "scores", valueint);
-    s.homeShootoutAttempts = read_leaf(team, "attempts", valueint);
-    s.shootoutStartTime = read_leaf(shootoutInfo, "startTime", valuestring);
+    s->homeShootoutScores = read_int(team, "scores");
+    s->homeShootoutAttempts = read_int(team, "attempts");
+    s->shootoutStartTime = copy_string(arena, shootoutInfo, "startTime");
 
     teams = cJSON_GetObjectItemCaseSensitive(linescore, "teams");
     team = cJSON_GetObjectItemCaseSensitive(teams, "away");
-    s.awayShotsOnGoal = read_leaf(team, "shotsOnGoal", valueint);
-    s.awayGoaliePulled = read_leaf(team, "goaliePulled", valueint);
-    s.awayNumSkaters = read_leaf(team, "numSkaters", valueint);
-    s.awayPowerPlay = read_leaf(team, "powerPlay", valueint);
+    s->awayShotsOnGoal = read_int(team, "shotsOnGoal");
+    s->awayGoaliePulled = read_int(team, "goaliePulled");
+    s->awayNumSkaters = read_int(team, "numSkaters");
+    s->awayPowerPlay = read_int(team, "powerPlay");
     team = cJSON_GetObjectItemCaseSensitive(teams, "home");
-    s.homeShotsOnGoal = read_leaf(team, "shotsOnGoal", valueint);
-    s.homeGoaliePulled = read_leaf(team, "goaliePulled", valueint);
-    s.homeNumSkaters = read_leaf(team, "numSkaters", valueint);
-    s.homePowerPlay = read_leaf(team, "powerPlay", valueint);
+    s->homeShotsOnGoal = read_int(team, "shotsOnGoal");
+    s->homeGoaliePulled = read_int(team, "goaliePulled");
+    s->homeNumSkaters = read_int(team, "numSkaters");
+    s->homePowerPlay = read_int(team, "powerPlay");
 
-    s.powerPlayStrength = read_leaf(linescore, "powerPlayStrength", valuestring);
-    s.hasShootout = read_leaf(linescore, "hasShootout", valueint);
+    s->powerPlayStrength = copy_string(arena, linescore, "powerPlayStrength");
+    s->hasShootout = read_int(linescore, "hasShootout");
 
     intermissionInfo = cJSON_GetObjectItemCaseSensitive(linescore, "intermissionInfo");
-    s.intermissionTimeRemaining = read_leaf(intermissionInfo, "intermissionTimeRemaining", valueint);
-    s.intermissionTimeElapsed = read_leaf(intermissionInfo, "intermissionTimeElapsed", valueint);
-    s.intermission = read_leaf(intermissionInfo, "intermission", valueint);
+    s->intermissionTimeRemaining = read_int(intermissionInfo, "intermissionTimeRemaining");
+    s->intermissionTimeElapsed = read_int(intermissionInfo, "intermissionTimeElapsed");
+    s->intermission = read_int(intermissionInfo, "intermission");
 
     powerPlayInfo = cJSON_GetObjectItemCaseSensitive(linescore, "powerPlayInfo");
-    s.powerPlaySituationRemaining = read_leaf(powerPlayInfo, "situationTimeRemaining", valueint);
-    s.powerPlaySituationElapsed = read_leaf(powerPlayInfo, "situationTimeElapsed", valueint);
-    s.powerPlayInSituation = read_leaf(powerPlayInfo, "inSituation", valueint);
+    s->powerPlaySituationRemaining = read_int(powerPlayInfo, "situationTimeRemaining");
+    s->powerPlaySituationElapsed = read_int(powerPlayInfo, "situationTimeElapsed");
+    s->powerPlayInSituation = read_int(powerPlayInfo, "inSituation");
 
-    s.meta = meta;
-    status |= nhl_cache_linescore_put(nhl, &s);
-    return status;
+    s->meta = meta;
 }
 
-/* Goal updater needed by update_from_game(). */
-static NhlStatus update_from_goal(Nhl *nhl, cJSON *goal, int game, int goal_idx, NhlCacheMeta *meta) {
+/* Write a linescore and its periods read by read_linescore(). */
+static NhlStatus write_linescore(Nhl *nhl, NhlCacheLinescore *s, NhlCachePeriod *periods, int num_periods) {
     NhlStatus status = 0;
-    NhlCacheGoal g = {0};
+    status |= nhl_cache_periods_put(nhl, s->game, periods, num_periods);
+    status |= nhl_cache_linescore_put(nhl, s);
+    return status;
+}
+
+/* Goal reader needed by read_game(). Strings of g are allocated from the arena. */
+static void read_goal(NhlArena *arena, cJSON *goal, int game, int goal_idx, NhlCacheMeta *meta,
+                      NhlCacheGoal *g) {
     cJSON *players;
     cJSON *players_elem;
     cJSON *result;
@@ -169,61 +267,73 @@ static NhlStatus update_from_goal(Nhl *nhl, cJSON *goal, int game, int goal_idx,
     cJSON *goals;
     cJSON *team;
 
-    g.game = game;
-    g.goalNumber = goal_idx;
+    memset(g, 0, sizeof(NhlCacheGoal));
+    g->game = game;
+    g->goalNumber = goal_idx;
 
     players = cJSON_GetObjectItemCaseSensitive(goal, "players");
     cJSON_ArrayForEach(players_elem, players) {
         cJSON *player = cJSON_GetObjectItemCaseSensitive(players_elem, "player");
-        char *playerType = read_leaf(players_elem, "playerType", valuestring);
+        char *playerType = read_string(players_elem, "playerType");
         if (strcmp(playerType, "Scorer") == 0) {
-            g.scorer = read_leaf(player, "id", valueint);
-            g.scorerSeasonTotal = read_leaf(players_elem, "seasonTotal", valueint);
-        } else if (strcmp(playerType, "Assist") == 0 && g.assist1 == 0) {
-            g.assist1 = read_leaf(player, "id", valueint);
-            g.assist1SeasonTotal = read_leaf(players_elem, "seasonTotal", valueint);
+            g->scorer = read_int(player, "id");
+            g->scorerSeasonTotal = read_int(players_elem, "seasonTotal");
+        } else if (strcmp(playerType, "Assist") == 0 && g->assist1 == 0) {
+            g->assist1 = read_int(player, "id");
+            g->assist1SeasonTotal = read_int(players_elem, "seasonTotal");
         } else if (strcmp(playerType, "Assist") == 0) {
-            g.assist2 = read_leaf(player, "id", valueint);
-            g.assist2SeasonTotal = read_leaf(players_elem, "seasonTotal", valueint);
+            g->assist2 = read_int(player, "id");
+            g->assist2SeasonTotal = read_int(players_elem, "seasonTotal");
         } else if (strcmp(playerType, "Goalie") == 0) {
-            g.goalie = read_leaf(player, "id", valueint);
+            g->goalie = read_int(player, "id");
         } else {
             /* ERROR */
         }
     }
 
     result = cJSON_GetObjectItemCaseSensitive(goal, "result");
-    g.secondaryType = read_leaf(result, "secondaryType", valuestring);
+    g->secondaryType = copy_string(arena, result, "secondaryType");
     strength = cJSON_GetObjectItemCaseSensitive(result, "strength");
-    g.strengthCode = read_leaf(strength, "code", valuestring);
-    g.strengthName = read_leaf(strength, "name", valuestring);
-    g.gameWinningGoal = read_leaf(result, "gameWinningGoal", valueint);
-    g.emptyNet = read_leaf(result, "emptyNet", valueint);
+    g->strengthCode = copy_string(arena, strength, "code");
+    g->strengthName = copy_string(arena, strength, "name");
+    g->gameWinningGoal = read_int(result, "gameWinningGoal");
+    g->emptyNet = read_int(result, "emptyNet");
 
     about = cJSON_GetObjectItemCaseSensitive(goal, "about");
-    g.period = read_leaf(about, "period", valueint);
-    g.periodType = read_leaf(about, "periodType", valuestring);
-    g.ordinalNum = read_leaf(about, "ordinalNum", valuestring);
-    g.periodTime = read_leaf(about, "periodTime", valuestring);
-    g.periodTimeRemaining = read_leaf(about, "periodTimeRemaining", valuestring);
-    g.dateTime = read_leaf(about, "dateTime", valuestring);
+    g->period = read_int(about, "period");
+    g->periodType = copy_string(arena, about, "periodType");
+    g->ordinalNum = copy_string(arena, about, "ordinalNum");
+    g->periodTime = copy_string(arena, about, "periodTime");
+    g->periodTimeRemaining = copy_string(arena, about, "periodTimeRemaining");
+    g->dateTime = copy_string(arena, about, "dateTime");
     goals = cJSON_GetObjectItemCaseSensitive(about, "goals");
-    g.goalsAway = read_leaf(goals, "away", valueint);
-    g.goalsHome = read_leaf(goals, "home", valueint);
+    g->goalsAway = read_int(goals, "away");
+    g->goalsHome = read_int(goals, "home");
 
     team = cJSON_GetObjectItemCaseSensitive(goal, "team");
-    g.team = read_leaf(team, "id", valueint);
+    g->team = read_int(team, "id");
 
-    g.meta = meta;
-    status |= nhl_cache_goal_put(nhl, &g);
-
-    return status;
+    g->meta = meta;
 }
 
-/* Game updater needed by update_from_schedule(). */
-static NhlStatus update_from_game(Nhl *nhl, cJSON *game, char *date, NhlCacheMeta *meta) {
-    NhlStatus status = 0;
-    NhlCacheGame g;
+/* Rows of a single game of a schedule. Games are read as soon as the parser has completed them,
+ * but written only after the whole response has been received and the write lock has been taken.
+ * The rows are allocated from the arena of the response, so that the JSON tree of the game can be
+ * released right away. */
+struct NhlGameRecord {
+    NhlCacheGame game;
+    NhlCacheGoal *goals;          /* NULL if the game has no scoring plays */
+    int num_goals;
+    NhlCacheLinescore *linescore; /* NULL if the game has no linescore */
+    NhlCachePeriod *periods;
+    int num_periods;
+    NhlGameRecord *next;          /* Next game of the response */
+};
+
+/* Read the rows of a game of a schedule. Returns NULL if the arena is out of memory. */
+static NhlGameRecord *read_game(NhlArena *arena, cJSON *game, const char *date, NhlCacheMeta *meta) {
+    NhlGameRecord *record = nhl_arena_alloc(arena, sizeof(NhlGameRecord));
+    NhlCacheGame *g;
     cJSON *game_status;
     cJSON *teams;
     cJSON *awayHome;
@@ -232,76 +342,242 @@ static NhlStatus update_from_game(Nhl *nhl, cJSON *game, char *date, NhlCacheMet
     cJSON *scoringPlays;
     cJSON *scoringPlays_elem;
     cJSON *linescore;
-    int goal_idx = 0;
 
-    g.gamePk = read_leaf(game, "gamePk", valueint);
-    g.date = date;
-    g.gameType = read_leaf(game, "gameType", valuestring);
-    g.season = read_leaf(game, "season", valuestring);
-    g.gameDate = read_leaf(game, "gameDate", valuestring);
+    if (record == NULL) {
+        return NULL;
+    }
+    memset(record, 0, sizeof(NhlGameRecord));
+    g = &record->game;
+
+    g->gamePk = read_int(game, "gamePk");
+    g->date = nhl_arena_copy_string(arena, date);
+    g->gameType = copy_string(arena, game, "gameType");
+    g->season = copy_string(arena, game, "season");
+    g->gameDate = copy_string(arena, game, "gameDate");
     game_status = cJSON_GetObjectItemCaseSensitive(game, "status");
-    g.statusCode = read_leaf(game_status, "statusCode", valuestring);
+    g->statusCode = copy_string(arena, game_status, "statusCode");
 
     teams = cJSON_GetObjectItemCaseSensitive(game, "teams");
 
     awayHome = cJSON_GetObjectItemCaseSensitive(teams, "away");
     team = cJSON_GetObjectItemCaseSensitive(awayHome, "team");
-    g.awayTeam = read_leaf(team, "id", valueint);
-    g.awayScore = read_leaf(awayHome, "score", valueint);
+    g->awayTeam = read_int(team, "id");
+    g->awayScore = read_int(awayHome, "score");
     leagueRecord = cJSON_GetObjectItemCaseSensitive(awayHome, "leagueRecord");
-    g.awayWins = read_leaf(leagueRecord, "wins", valueint);
-    g.awayLosses = read_leaf(leagueRecord, "losses", valueint);
-    g.awayOt = read_leaf(leagueRecord, "ot", valueint);
-    g.awayRecordType = read_leaf(leagueRecord, "type", valuestring);
+    g->awayWins = read_int(leagueRecord, "wins");
+    g->awayLosses = read_int(leagueRecord, "losses");
+    g->awayOt = read_int(leagueRecord, "ot");
+    g->awayRecordType = copy_string(arena, leagueRecord, "type");
 
     awayHome = cJSON_GetObjectItemCaseSensitive(teams, "home");
     team = cJSON_GetObjectItemCaseSensitive(awayHome, "team");
-    g.homeTeam = read_leaf(team, "id", valueint);
-    g.homeScore = read_leaf(awayHome, "score", valueint);
+    g->homeTeam = read_int(team, "id");
+    g->homeScore = read_int(awayHome, "score");
     leagueRecord = cJSON_GetObjectItemCaseSensitive(awayHome, "leagueRecord");
-    g.homeWins = read_leaf(leagueRecord, "wins", valueint);
-    g.homeLosses = read_leaf(leagueRecord, "losses", valueint);
-    g.homeOt = read_leaf(leagueRecord, "ot", valueint);
-    g.homeRecordType = read_leaf(leagueRecord, "type", valuestring);
+    g->homeWins = read_int(leagueRecord, "wins");
+    g->homeLosses = read_int(leagueRecord, "losses");
+    g->homeOt = read_int(leagueRecord, "ot");
+    g->homeRecordType = copy_string(arena, leagueRecord, "type");
 
-    g.meta = meta;
-    status |= nhl_cache_game_put(nhl, &g);
+    g->meta = meta;
 
     scoringPlays = cJSON_GetObjectItemCaseSensitive(game, "scoringPlays");
     if (scoringPlays != NULL) {
-        nhl_cache_goals_reset(nhl, g.gamePk);
+        record->goals = nhl_arena_alloc(arena, (cJSON_GetArraySize(scoringPlays) + 1) * sizeof(NhlCacheGoal));
         cJSON_ArrayForEach(scoringPlays_elem, scoringPlays) {
-            status |= update_from_goal(nhl, scoringPlays_elem, g.gamePk, goal_idx, meta);
-            ++goal_idx;
+            if (record->goals != NULL) {
+                read_goal(arena, scoringPlays_elem, g->gamePk, record->num_goals, meta,
+                          &record->goals[record->num_goals]);
+                ++record->num_goals;
+            }
         }
     }
 
     linescore = cJSON_GetObjectItemCaseSensitive(game, "linescore");
     if (linescore != NULL) {
-        status |= update_from_linescore(nhl, linescore, g.gamePk, meta);
+        record->linescore = nhl_arena_alloc(arena, sizeof(NhlCacheLinescore));
+        if (record->linescore != NULL) {
+            read_linescore(arena, linescore, g->gamePk, meta, record->linescore, &record->periods,
+                           &record->num_periods);
+        }
+    }
+
+    /* A game with missing rows or strings must not be written */
+    return nhl_arena_failed(arena) ? NULL : record;
+}
+
+/* Write the rows of a game read by read_game(). */
+static NhlStatus write_game(Nhl *nhl, NhlGameRecord *record) {
+    NhlStatus status = 0;
+    status |= nhl_cache_game_put(nhl, &record->game);
+    if (record->goals != NULL) {
+        status |= nhl_cache_goals_put(nhl, record->game.gamePk, record->goals, record->num_goals);
+    }
+    if (record->linescore != NULL) {
+        status |= write_linescore(nhl, record->linescore, record->periods, record->num_periods);
+    }
+    return status;
+}
+
+/* Status code of a game implied by its linescore, or NULL if status_code still holds. Finished
+ * linescores mean a final game (code 7), and linescores of started periods mean a game in progress
+ * (code 3) if the game was still a preview. */
+static const char *linescore_status_code(Nhl *nhl, cJSON *root, const char *status_code) {
+    NhlCacheGameStatus *game_status = status_code != NULL ?
+                                      nhl_cache_game_status_get(nhl, status_code) : NULL;
+    const char *abstract_state = game_status != NULL ? game_status->abstractGameState : NULL;
+    const char *time_remaining = read_string(root, "currentPeriodTimeRemaining");
+    const char *new_code = NULL;
+
+    if (time_remaining != NULL && strcmp(time_remaining, "Final") == 0) {
+        if (abstract_state == NULL || strcmp(abstract_state, "Final") != 0) {
+            new_code = "7";
+        }
+    } else if (read_int(root, "currentPeriod") > 0 && abstract_state != NULL &&
+               strcmp(abstract_state, "Preview") == 0) {
+        new_code = "3";
+    }
+
+    nhl_cache_game_status_free(game_status);
+    return new_code;
+}
+
+/* Update linescore and score of a single game. The game ID is read from the URL, and the game must
+ * already be in the cache. Other data of the game (e.g., goals) is not included in linescores. The
+ * game keeps the source of its schedule, so that it is still refreshed with the schedule, but its
+ * score, status and timestamp are updated. */
+static NhlStatus update_from_game_linescore(Nhl *nhl, cJSON *root, NhlCacheMeta *meta) {
+    NhlStatus status = 0;
+    const char *status_code;
+    const char *game_str = strstr(meta->source, "/game/");
+    int game_id = 0;
+    NhlCacheGame *game;
+    NhlArena *arena;
+    NhlCacheLinescore linescore;
+    NhlCachePeriod *periods;
+    int num_periods;
+    cJSON *teams;
+    cJSON *team;
+
+    if (root == NULL || game_str == NULL || sscanf(game_str, "/game/%d", &game_id) != 1) {
+        return NHL_INVALID_REQUEST;
+    }
+    game = nhl_cache_game_get(nhl, game_id);
+    if (game == NULL) {
+        return NHL_INVALID_REQUEST;
     }
 
+    /* Strings of the rows are copied, as for the games of schedules */
+    arena = nhl_arena_create(1024);
+    if (arena == NULL) {
+        nhl_cache_game_free(game);
+        return NHL_MEMORY_ERROR;
+    }
+    read_linescore(arena, root, game_id, meta, &linescore, &periods, &num_periods);
+    if (nhl_arena_failed(arena)) {
+        nhl_arena_delete(arena);
+        nhl_cache_game_free(game);
+        return NHL_MEMORY_ERROR;
+    }
+    status |= write_linescore(nhl, &linescore, periods, num_periods);
+    nhl_arena_delete(arena);
+
+    /* Keep the old score if the linescore does not have one */
+    teams = cJSON_GetObjectItemCaseSensitive(root, "teams");
+    team = cJSON_GetObjectItemCaseSensitive(teams, "away");
+    if (cJSON_GetObjectItemCaseSensitive(team, "goals") != NULL) {
+        game->awayScore = read_int(team, "goals");
+    }
+    team = cJSON_GetObjectItemCaseSensitive(teams, "home");
+    if (cJSON_GetObjectItemCaseSensitive(team, "goals") != NULL) {
+        game->homeScore = read_int(team, "goals");
+    }
+    status_code = linescore_status_code(nhl, root, game->statusCode);
+    {
+        NhlCacheGame g = *game;
+        NhlCacheMeta m = *meta;
+        m.source = game->meta->source;
+        g.meta = &m;
+        if (status_code != NULL) {
+            g.statusCode = (char *) status_code;
+        }
+        status |= nhl_cache_game_put(nhl, &g);
+    }
+
+    nhl_cache_game_free(game);
     return status;
 }
 
+/* Read the value of a date parameter (e.g., "date=") of a query string into date. */
+static int read_url_date(const char *url, const char *param, NhlDate *date) {
+    const char *query = strchr(url, '?');
+    size_t param_len = strlen(param);
+    if (query == NULL && (query = strstr(url, "%3F")) != NULL) {
+        query += 2; /* escaped question mark in file:// URLs */
+    }
+    while (query != NULL) {
+        ++query;
+        if (strncmp(query, param, param_len) == 0) {
+            *date = nhl_string_to_date(query + param_len);
+            return date->year > 0;
+        }
+        query = strchr(query, '&');
+    }
+    return 0;
+}
+
+/* Returns nonzero if the "dates" array of a schedule contains date_str. */
+static int schedule_has_date(cJSON *dates, const char *date_str) {
+    cJSON *dates_elem;
+    cJSON_ArrayForEach(dates_elem, dates) {
+        cJSON *date = cJSON_GetObjectItemCaseSensitive(dates_elem, "date");
+        if (date != NULL && date->valuestring != NULL && strcmp(date->valuestring, date_str) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 static NhlStatus update_from_schedule(Nhl *nhl, cJSON *root, NhlCacheMeta *meta) {
     NhlStatus status = 0;
     cJSON *dates = cJSON_GetObjectItemCaseSensitive(root, "dates");
     cJSON *dates_elem;
+    NhlDate first;
+    NhlDate last;
+
+    /* Games have been handed out by the parser, see schedule_game_cb() */
     cJSON_ArrayForEach(dates_elem, dates) {
         NhlCacheSchedule s;
-        cJSON *games;
-        cJSON *games_elem;
-
-        s.date = read_leaf(dates_elem, "date", valuestring);
-        s.totalGames = read_leaf(dates_elem, "totalGames", valueint);
+        s.date = read_string(dates_elem, "date");
+        s.totalGames = read_int(dates_elem, "totalGames");
         s.meta = meta;
         status |= nhl_cache_schedule_put(nhl, &s);
+    }
 
-        games = cJSON_GetObjectItemCaseSensitive(dates_elem, "games");
-        cJSON_ArrayForEach(games_elem, games) {
-            status |= update_from_game(nhl, games_elem, s.date, meta);
+    /* Upstream omits dates without games. Store them as empty schedules, so that every date
+     * covered by the request is known to be up to date. */
+    if (dates == NULL || dates->type != cJSON_Array) {
+        return status;
+    }
+    if (read_url_date(meta->source, "date=", &first)) {
+        last = first;
+    } else if (!read_url_date(meta->source, "startDate=", &first) ||
+               !read_url_date(meta->source, "endDate=", &last)) {
+        return status;
+    }
+    for (; nhl_date_compare(&first, &last) <= 0; first = nhl_date_next(&first)) {
+        char *date_str = nhl_date_to_string(&first);
+        if (date_str == NULL) {
+            break;
+        }
+        if (!schedule_has_date(dates, date_str)) {
+            NhlCacheSchedule s;
+            s.date = date_str;
+            s.totalGames = 0;
+            s.meta = meta;
+            status |= nhl_cache_schedule_put(nhl, &s);
         }
+        free(date_str);
     }
     return status;
 }
@@ -315,28 +591,28 @@ static NhlStatus update_from_people(Nhl *nhl, cJSON *root, NhlCacheMeta *meta) {
         NhlCachePlayer p;
         cJSON *currentTeam;
         cJSON *primaryPosition;
-        p.id = read_leaf(people_elem, "id", valueint);
-        p.fullName = read_leaf(people_elem, "fullName", valuestring);
-        p.firstName = read_leaf(people_elem, "firstName", valuestring);
-        p.lastName = read_leaf(people_elem, "lastName", valuestring);
-        p.primaryNumber = read_leaf(people_elem, "primaryNumber", valuestring);
-        p.birthDate = read_leaf(people_elem, "birthDate", valuestring);
-        p.birthCity = read_leaf(people_elem, "birthCity", valuestring);
-        p.birthStateProvince = read_leaf(people_elem, "birthStateProvince", valuestring);
-        p.birthCountry = read_leaf(people_elem, "birthCountry", valuestring);
-        p.nationality = read_leaf(people_elem, "nationality", valuestring);
-        p.height = read_leaf(people_elem, "height", valuestring);
-        p.weight = read_leaf(people_elem, "weight", valueint);
-        p.active = read_leaf(people_elem, "active", valueint);
-        p.alternateCaptain = read_leaf(people_elem, "alternateCaptain", valueint);
-        p.captain = read_leaf(people_elem, "captain", valueint);
-        p.rookie = read_leaf(people_elem, "rookie", valueint);
-        p.shootsCatches = read_leaf(people_elem, "shootsCatches", valuestring);
-        p.rosterStatus = read_leaf(people_elem, "rosterStatus", valuestring);
+        p.id = read_int(people_elem, "id");
+        p.fullName = read_string(people_elem, "fullName");
+        p.firstName = read_string(people_elem, "firstName");
+        p.lastName = read_string(people_elem, "lastName");
+        p.primaryNumber = read_string(people_elem, "primaryNumber");
+        p.birthDate = read_string(people_elem, "birthDate");
+        p.birthCity = read_string(people_elem, "birthCity");
+        p.birthStateProvince = read_string(people_elem, "birthStateProvince");
+        p.birthCountry = read_string(people_elem, "birthCountry");
+        p.nationality = read_string(people_elem, "nationality");
+        p.height = read_string(people_elem, "height");
+        p.weight = read_int(people_elem, "weight");
+        p.active = read_int(people_elem, "active");
+        p.alternateCaptain = read_int(people_elem, "alternateCaptain");
+        p.captain = read_int(people_elem, "captain");
+        p.rookie = read_int(people_elem, "rookie");
+        p.shootsCatches = read_string(people_elem, "shootsCatches");
+        p.rosterStatus = read_string(people_elem, "rosterStatus");
         currentTeam = cJSON_GetObjectItemCaseSensitive(people_elem, "currentTeam");
-        p.currentTeam = read_leaf(currentTeam, "id", valueint);
+        p.currentTeam = read_int(currentTeam, "id");
         primaryPosition = cJSON_GetObjectItemCaseSensitive(people_elem, "primaryPosition");
-        p.primaryPosition = read_leaf(primaryPosition, "code", valuestring);
+        p.primaryPosition = read_string(primaryPosition, "code");
         p.meta = meta;
         status |= nhl_cache_player_put(nhl, &p);
     }
@@ -353,21 +629,21 @@ static NhlStatus update_from_teams(Nhl *nhl, cJSON *root, NhlCacheMeta *meta) {
         cJSON *division;
         cJSON *conference;
         cJSON *franchise;
-        t.id = read_leaf(teams_elem, "id", valueint);
-        t.name = read_leaf(teams_elem, "name", valuestring);
-        t.abbreviation = read_leaf(teams_elem, "abbreviation", valuestring);
-        t.teamName = read_leaf(teams_elem, "teamName", valuestring);
-        t.locationName = read_leaf(teams_elem, "locationName", valuestring);
-        t.firstYearOfPlay = read_leaf(teams_elem, "firstYearOfPlay", valuestring);
+        t.id = read_int(teams_elem, "id");
+        t.name = read_string(teams_elem, "name");
+        t.abbreviation = read_string(teams_elem, "abbreviation");
+        t.teamName = read_string(teams_elem, "teamName");
+        t.locationName = read_string(teams_elem, "locationName");
+        t.firstYearOfPlay = read_string(teams_elem, "firstYearOfPlay");
         division = cJSON_GetObjectItemCaseSensitive(teams_elem, "division");
-        t.division = read_leaf(division, "id", valueint);
+        t.division = read_int(division, "id");
         conference = cJSON_GetObjectItemCaseSensitive(teams_elem, "conference");
-        t.conference = read_leaf(conference, "id", valueint);
+        t.conference = read_int(conference, "id");
         franchise = cJSON_GetObjectItemCaseSensitive(teams_elem, "franchise");
-        t.franchise = read_leaf(franchise, "franchiseId", valueint);
-        t.shortName = read_leaf(teams_elem, "shortName", valuestring);
-        t.officialSiteUrl = read_leaf(teams_elem, "officialSiteUrl", valuestring);
-        t.active = read_leaf(teams_elem, "active", valueint);
+        t.franchise = read_int(franchise, "franchiseId");
+        t.shortName = read_string(teams_elem, "shortName");
+        t.officialSiteUrl = read_string(teams_elem, "officialSiteUrl");
+        t.active = read_int(teams_elem, "active");
         t.meta = meta;
         status |= nhl_cache_team_put(nhl, &t);
     }
@@ -381,12 +657,12 @@ static NhlStatus update_from_franchises(Nhl *nhl, cJSON *root, NhlCacheMeta *met
     cJSON *franchises_elem;
     cJSON_ArrayForEach(franchises_elem, franchises) {
         NhlCacheFranchise f;
-        f.franchiseId = read_leaf(franchises_elem, "franchiseId", valueint);
-        f.firstSeasonId = read_leaf(franchises_elem, "firstSeasonId", valueint);
-        f.lastSeasonId = read_leaf(franchises_elem, "lastSeasonId", valueint);
-        f.mostRecentTeamId = read_leaf(franchises_elem, "mostRecentTeamId", valueint);
-        f.teamName = read_leaf(franchises_elem, "teamName", valuestring);
-        f.locationName = read_leaf(franchises_elem, "locationName", valuestring);
+        f.franchiseId = read_int(franchises_elem, "franchiseId");
+        f.firstSeasonId = read_int(franchises_elem, "firstSeasonId");
+        f.lastSeasonId = read_int(franchises_elem, "lastSeasonId");
+        f.mostRecentTeamId = read_int(franchises_elem, "mostRecentTeamId");
+        f.teamName = read_string(franchises_elem, "teamName");
+        f.locationName = read_string(franchises_elem, "locationName");
         f.meta = meta;
         status |= nhl_cache_franchise_put(nhl, &f);
     }
@@ -401,13 +677,13 @@ static NhlStatus update_from_divisions(Nhl *nhl, cJSON *root, NhlCacheMeta *meta
     cJSON_ArrayForEach(divisions_elem, divisions) {
         NhlCacheDivision d;
         cJSON *conference;
-        d.id = read_leaf(divisions_elem, "id", valueint);
-        d.name = read_leaf(divisions_elem, "name", valuestring);
-        d.nameShort = read_leaf(divisions_elem, "nameShort", valuestring);
-        d.abbreviation = read_leaf(divisions_elem, "abbreviation", valuestring);
+        d.id = read_int(divisions_elem, "id");
+        d.name = read_string(divisions_elem, "name");
+        d.nameShort = read_string(divisions_elem, "nameShort");
+        d.abbreviation = read_string(divisions_elem, "abbreviation");
         conference = cJSON_GetObjectItemCaseSensitive(divisions_elem, "conference");
-        d.conference = read_leaf(conference, "id", valueint);
-        d.active = read_leaf(divisions_elem, "active", valueint);
+        d.conference = read_int(conference, "id");
+        d.active = read_int(divisions_elem, "active");
         d.meta = meta;
         status |= nhl_cache_division_put(nhl, &d);
     }
@@ -421,11 +697,11 @@ static NhlStatus update_from_conferences(Nhl *nhl, cJSON *root, NhlCacheMeta *me
     cJSON *conferences_elem;
     cJSON_ArrayForEach(conferences_elem, conferences) {
         NhlCacheConference c;
-        c.id = read_leaf(conferences_elem, "id", valueint);
-        c.name = read_leaf(conferences_elem, "name", valuestring);
-        c.abbreviation = read_leaf(conferences_elem, "abbreviation", valuestring);
-        c.shortName = read_leaf(conferences_elem, "shortName", valuestring);
-        c.active = read_leaf(conferences_elem, "active", valueint);
+        c.id = read_int(conferences_elem, "id");
+        c.name = read_string(conferences_elem, "name");
+        c.abbreviation = read_string(conferences_elem, "abbreviation");
+        c.shortName = read_string(conferences_elem, "shortName");
+        c.active = read_int(conferences_elem, "active");
         c.meta = meta;
         status |= nhl_cache_conference_put(nhl, &c);
     }
@@ -438,10 +714,10 @@ static NhlStatus update_from_game_statuses(Nhl *nhl, cJSON *root, NhlCacheMeta *
     cJSON *gamest_elem;
     cJSON_ArrayForEach(gamest_elem, root) {
         NhlCacheGameStatus g;
-        g.code = read_leaf(gamest_elem, "code", valuestring);
-        g.abstractGameState = read_leaf(gamest_elem, "abstractGameState", valuestring);
-        g.detailedState = read_leaf(gamest_elem, "detailedState", valuestring);
-        g.startTimeTBD = read_leaf(gamest_elem, "startTimeTBD", valueint);
+        g.code = read_string(gamest_elem, "code");
+        g.abstractGameState = read_string(gamest_elem, "abstractGameState");
+        g.detailedState = read_string(gamest_elem, "detailedState");
+        g.startTimeTBD = read_int(gamest_elem, "startTimeTBD");
         g.meta = meta;
         status |= nhl_cache_game_status_put(nhl, &g);
     }
@@ -454,9 +730,9 @@ static NhlStatus update_from_game_types(Nhl *nhl, cJSON *root, NhlCacheMeta *met
     cJSON *gametyp_elem;
     cJSON_ArrayForEach(gametyp_elem, root) {
         NhlCacheGameType t;
-        t.id = read_leaf(gametyp_elem, "id", valuestring);
-        t.description = read_leaf(gametyp_elem, "description", valuestring);
-        t.postseason = read_leaf(gametyp_elem, "postseason", valueint);
+        t.id = read_string(gametyp_elem, "id");
+        t.description = read_string(gametyp_elem, "description");
+        t.postseason = read_int(gametyp_elem, "postseason");
         t.meta = meta;
         status |= nhl_cache_game_type_put(nhl, &t);
     }
@@ -469,10 +745,10 @@ static NhlStatus update_from_positions(Nhl *nhl, cJSON *root, NhlCacheMeta *meta
     cJSON *position_elem;
     cJSON_ArrayForEach(position_elem, root) {
         NhlCachePosition p;
-        p.abbrev = read_leaf(position_elem, "abbrev", valuestring);
-        p.code = read_leaf(position_elem, "code", valuestring);
-        p.fullName = read_leaf(position_elem, "fullName", valuestring);
-        p.type = read_leaf(position_elem, "type", valuestring);
+        p.abbrev = read_string(position_elem, "abbrev");
+        p.code = read_string(position_elem, "code");
+        p.fullName = read_string(position_elem, "fullName");
+        p.type = read_string(position_elem, "type");
         p.meta = meta;
         status |= nhl_cache_position_put(nhl, &p);
     }
@@ -485,8 +761,8 @@ static NhlStatus update_from_roster_statuses(Nhl *nhl, cJSON *root, NhlCacheMeta
     cJSON *rosters_elem;
     cJSON_ArrayForEach(rosters_elem, root) {
         NhlCacheRosterStatus r;
-        r.code = read_leaf(rosters_elem, "code", valuestring);
-        r.description = read_leaf(rosters_elem, "description", valuestring);
+        r.code = read_string(rosters_elem, "code");
+        r.description = read_string(rosters_elem, "description");
         r.meta = meta;
         status |= nhl_cache_roster_status_put(nhl, &r);
     }
@@ -494,68 +770,438 @@ static NhlStatus update_from_roster_statuses(Nhl *nhl, cJSON *root, NhlCacheMeta
 }
 
 
-NhlStatus nhl_update_from_url(Nhl *nhl, const char *url, NhlUpdateContentType type) {
-    if (nhl->params->offline || url == NULL || nhl_list_contains(nhl->visited_urls, url)) {
+/* Maximum age of downloaded content of the given type. Negative value means no limit. */
+static int content_max_age(const Nhl *nhl, NhlUpdateContentType type) {
+    const NhlInitParams *params = nhl->params;
+    switch (type) {
+        case NHL_CONTENT_SCHEDULE:
+            /* Schedules are also the source of game data */
+            return nhl_min_age(params->schedule_max_age,
+                               nhl_min_age(params->game_live_max_age, params->game_final_max_age));
+        case NHL_CONTENT_LINESCORE:
+            return params->game_live_max_age;
+        case NHL_CONTENT_PEOPLE:
+            return params->player_max_age;
+        case NHL_CONTENT_TEAMS:
+        case NHL_CONTENT_FRANCHISES:
+            return params->team_max_age;
+        case NHL_CONTENT_DIVISIONS:
+        case NHL_CONTENT_CONFERENCES:
+            return params->league_max_age;
+        default:
+            return params->meta_max_age;
+    }
+}
+
+/* Returns nonzero if url has been accessed recently enough that it need not be accessed again.
+ * URLs accessed during the current top-level call are never accessed again. */
+static int recently_visited(const Nhl *nhl, const char *url, NhlUpdateContentType type) {
+    time_t when;
+    unsigned long call;
+    if (nhl_visited_find(nhl->visited_urls, url, &when, &call)) {
+        int max_age = content_max_age(nhl, type);
+        int age = nhl_cache_timestamp_age(nhl, when);
+        return (nhl->in_progress && call == nhl->call) || max_age < 0 || (0 <= age && age < max_age);
+    }
+    return 0;
+}
+
+
+/* Update database from a parsed document. */
+static NhlStatus update_from_tree(Nhl *nhl, cJSON *root, NhlCacheMeta *meta, NhlUpdateContentType type) {
+    switch (type) {
+        case NHL_CONTENT_SCHEDULE:
+            return update_from_schedule(nhl, root, meta);
+        case NHL_CONTENT_LINESCORE:
+            return update_from_game_linescore(nhl, root, meta);
+        case NHL_CONTENT_PEOPLE:
+            return update_from_people(nhl, root, meta);
+        case NHL_CONTENT_TEAMS:
+            return update_from_teams(nhl, root, meta);
+        case NHL_CONTENT_FRANCHISES:
+            return update_from_franchises(nhl, root, meta);
+        case NHL_CONTENT_DIVISIONS:
+            return update_from_divisions(nhl, root, meta);
+        case NHL_CONTENT_CONFERENCES:
+            return update_from_conferences(nhl, root, meta);
+        case NHL_CONTENT_GAME_STATUSES:
+            return update_from_game_statuses(nhl, root, meta);
+        case NHL_CONTENT_GAME_TYPES:
+            return update_from_game_types(nhl, root, meta);
+        case NHL_CONTENT_POSITIONS:
+            return update_from_positions(nhl, root, meta);
+        case NHL_CONTENT_ROSTER_STATUSES:
+            return update_from_roster_statuses(nhl, root, meta);
+        default:
+            return NHL_INVALID_REQUEST;
+    }
+}
+
+/* Games of a schedule are handed out by the parser one by one, so that the JSON tree of only a
+ * single game is kept in memory at a time. The rest of the schedule is read after the whole
+ * response. */
+static const char *const schedule_game_path[] = { "dates", NULL, "games", NULL };
+
+/* Parser callback for a single game of a schedule. The date of the game precedes the games array
+ * in the enclosing element of "dates". The callback runs during the transfer, so the game is only
+ * read here, and written after the transfer. */
+static void schedule_game_cb(NhlJsonStream *stream, cJSON *game, void *userdata) {
+    cb_data *data = userdata;
+    const char *date = read_string(nhl_json_stream_ancestor(stream, 2), "date");
+    NhlGameRecord *record = read_game(data->arena, game, date, &data->meta);
+
+    if (record == NULL) {
+        data->status |= NHL_MEMORY_ERROR;
+    } else if (data->last_game != NULL) {
+        data->last_game->next = record;
+        data->last_game = record;
+    } else {
+        data->games = data->last_game = record;
+    }
+}
+
+/* Create parser for the response. The stream remains NULL if out of memory. */
+static void create_stream(cb_data *data) {
+    if (data->type == NHL_CONTENT_SCHEDULE) {
+        data->arena = nhl_arena_create(NHL_RECORD_BLOCK_SIZE);
+        if (data->arena != NULL) {
+            data->stream = nhl_json_stream_create(schedule_game_path, 4, schedule_game_cb, data);
+        }
+    } else {
+        data->stream = nhl_json_stream_create(NULL, 0, NULL, NULL);
+    }
+}
+
+/* Set up CURL handle for reading url of the given content type into data. If the previous response
+ * from the same URL is known, the request is made conditional. */
+static void setup_request(Nhl *nhl, CURL *curl, const char *url, NhlUpdateContentType type, cb_data *data) {
+    data->curl = curl;
+    data->type = type;
+    data->meta.source = url;
+    data->meta.timestamp = nhl_cache_current_time(nhl);
+    data->digest = NHL_DIGEST_BASIS;
+    create_stream(data);
+
+    data->cached = nhl_cache_response_get(nhl, url);
+    if (data->cached != NULL) {
+        data->headers = append_header(data->headers, "If-None-Match", data->cached->etag);
+        data->headers = append_header(data->headers, "If-Modified-Since", data->cached->lastModified);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, read_url_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, data);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, read_header_cb);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, data);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, data->headers);
+}
+
+/* Release resources held by data after the request has been completed. */
+static void cleanup_request(cb_data *data) {
+    free(data->etag);
+    free(data->last_modified);
+    curl_slist_free_all(data->headers);
+    nhl_cache_response_free(data->cached);
+    nhl_json_stream_delete(data->stream);
+    nhl_arena_delete(data->arena);
+}
+
+/* Claim url for downloading in a shared handle. Returns the claim, or NULL if the handle is not
+ * shared. If another thread is downloading the URL, returns NULL and sets *other to its claim,
+ * which must be waited for with wait_url(). */
+static NhlLockClaim *claim_url(Nhl *nhl, const char *url, NhlLockClaim **other) {
+    *other = NULL;
+    if (nhl->lock != NULL && url != NULL) {
+        return nhl_lock_claim(nhl->lock, url, other);
+    }
+    return NULL;
+}
+
+/* Wait for the download of another thread, and return its status. Other threads can use the handle
+ * meanwhile. */
+static NhlStatus wait_url(Nhl *nhl, NhlLockClaim *other) {
+    NhlCallState state;
+    NhlStatus status;
+    nhl_handle_suspend(nhl, &state);
+    status = (NhlStatus) nhl_lock_wait(nhl->lock, other);
+    nhl_handle_resume(nhl, &state);
+    return status;
+}
+
+/* Release the claim made by claim_url(), and pass the status of the download to waiting threads. */
+static void unclaim_url(Nhl *nhl, NhlLockClaim *claim, NhlStatus status) {
+    if (claim != NULL) {
+        nhl_lock_unclaim(nhl->lock, claim, (int) status);
+    }
+}
+
+/* Returns nonzero if url should not be downloaded now. */
+static int skip_url(Nhl *nhl, const char *url, NhlUpdateContentType type) {
+    if (nhl->params->offline || url == NULL || recently_visited(nhl, url, type)) {
         if (nhl->params->verbose)
             fprintf(stderr, "Skipping %s\n", url != NULL ? url : "(null)");
-        return NHL_DOWNLOAD_SKIPPED;
+        return 1;
+    }
+    return 0;
+}
 
-    } else {
-        char *json = read_url(nhl, url);
-        nhl->visited_urls = nhl_list_prepend(nhl->visited_urls, url);
-        if (json == NULL) {
-            return NHL_DOWNLOAD_ERROR;
 
-        } else {
-            NhlStatus status = NHL_DOWNLOAD_OK;
-            const char *timestamp = nhl_cache_current_time(nhl);
-            NhlCacheMeta meta = { NULL, NULL, 0 };
-            cJSON *root = cJSON_Parse(json);
-
-            meta.source = nhl_copy_string(url);
-            meta.timestamp = nhl_copy_string(timestamp);
-
-            switch (type) {
-                case NHL_CONTENT_SCHEDULE:
-                    status = update_from_schedule(nhl, root, &meta);
-                    break;
-                case NHL_CONTENT_PEOPLE:
-                    status |= update_from_people(nhl, root, &meta);
-                    break;
-                case NHL_CONTENT_TEAMS:
-                    status |= update_from_teams(nhl, root, &meta);
-                    break;
-                case NHL_CONTENT_FRANCHISES:
-                    status |= update_from_franchises(nhl, root, &meta);
-                    break;
-                case NHL_CONTENT_DIVISIONS:
-                    status |= update_from_divisions(nhl, root, &meta);
-                    break;
-                case NHL_CONTENT_CONFERENCES:
-                    status |= update_from_conferences(nhl, root, &meta);
-                    break;
-                case NHL_CONTENT_GAME_STATUSES:
-                    status |= update_from_game_statuses(nhl, root, &meta);
-                    break;
-                case NHL_CONTENT_GAME_TYPES:
-                    status |= update_from_game_types(nhl, root, &meta);
-                    break;
-                case NHL_CONTENT_POSITIONS:
-                    status |= update_from_positions(nhl, root, &meta);
-                    break;
-                case NHL_CONTENT_ROSTER_STATUSES:
-                    status |= update_from_roster_statuses(nhl, root, &meta);
-                    break;
-                default:
-                    status |= NHL_INVALID_REQUEST;
-                    break;
-            }
+/* Update database from a completed request. If the server reports that the response has not
+ * changed since the previous one (304 Not Modified), or the body has the same size and 64-bit hash
+ * as before, only the timestamps of the rows read from the URL are updated. Otherwise, the rows
+ * read by the parser during the transfer are written. Nothing
+ * is written if the response turns out to be truncated or invalid, so that a partial response is
+ * never taken for a complete one. All writes of a response are made within a single savepoint of
+ * the write transaction begun by the caller, and rolled back if some of them fails. If the caller
+ * could not take the write lock, writable is zero and nothing is written. */
+static NhlStatus update_from_response(Nhl *nhl, const char *url, cb_data *data, int writable) {
+    NhlStatus status = NHL_DOWNLOAD_OK;
+    NhlCacheResponse response;
+    cJSON *root = NULL;
+    char digest[17];
+    int unchanged = 0;
+    int savepoint;
+
+    if (data->code == 304 && data->cached != NULL) {
+        response = *data->cached;
+        if (data->etag != NULL) {
+            response.etag = data->etag;
+        }
+        unchanged = 1;
 
+    } else if (data->status & NHL_MEMORY_ERROR) {
+        return NHL_DOWNLOAD_ERROR | NHL_MEMORY_ERROR;
+
+    } else if (data->len == 0 || data->code >= 400 || data->stream == NULL ||
+               (root = nhl_json_stream_finish(data->stream)) == NULL) {
+        return NHL_DOWNLOAD_ERROR;
+
+    } else {
+        sprintf(digest, "%08lx%08lx", (unsigned long) (data->digest >> 32),
+                (unsigned long) (data->digest & 0xffffffffUL));
+        response.etag = data->etag != NULL ? data->etag : "";
+        response.lastModified = data->last_modified != NULL ? data->last_modified : "";
+        response.digest = digest;
+        response.size = (int) data->len;
+        if (data->cached != NULL && data->cached->size == response.size &&
+                strcmp(data->cached->digest, digest) == 0) {
             cJSON_Delete(root);
-            free(meta.timestamp);
-            free(meta.source);
-            free(json);
-            return status;
+            root = NULL;
+            unchanged = 1;
         }
     }
+
+    if (!writable) {
+        cJSON_Delete(root);
+        return status | NHL_CACHE_LOCKED;
+    }
+    savepoint = sqlite3_exec(nhl->db, "SAVEPOINT nhl_response;", NULL, NULL, NULL) == SQLITE_OK;
+
+    if (unchanged) {
+        status |= nhl_cache_source_touch(nhl, &data->meta);
+
+    } else {
+        NhlGameRecord *game;
+        status |= update_from_tree(nhl, root, &data->meta, data->type);
+        for (game = data->games; game != NULL; game = game->next) {
+            status |= write_game(nhl, game);
+        }
+        cJSON_Delete(root);
+    }
+
+    /* Partially written content must not be mistaken for up-to-date content later */
+    if (!(status & NHL_CACHE_WRITE_ERROR)) {
+        response.url = (char *) url;
+        response.meta = &data->meta;
+        status |= nhl_cache_response_put(nhl, &response);
+    } else if (savepoint) {
+        sqlite3_exec(nhl->db, "ROLLBACK TO nhl_response;", NULL, NULL, NULL);
+        status &= ~NHL_CACHE_WRITE_OK;
+    }
+
+    if (savepoint) {
+        sqlite3_exec(nhl->db, "RELEASE nhl_response;", NULL, NULL, NULL);
+    }
+    return status;
+}
+
+NhlStatus nhl_update_from_url(Nhl *nhl, const char *url, NhlUpdateContentType type) {
+    NhlStatus status;
+    NhlLockClaim *claim;
+    NhlLockClaim *other;
+    CURL *curl;
+    nhl_handle_lock(nhl);
+
+    /* If another thread is downloading the same URL, its result is used instead, even if the
+     * download failed */
+    claim = claim_url(nhl, url, &other);
+    if (other != NULL) {
+        status = wait_url(nhl, other);
+
+    } else if (skip_url(nhl, url, type)) {
+        status = NHL_DOWNLOAD_SKIPPED;
+
+    } else if ((curl = nhl->lock != NULL ? curl_easy_init() : nhl->curl) == NULL) {
+        /* Transfers of a shared handle may run in parallel, so they need handles of their own. The
+         * URL is not downloaded if the handle cannot be allocated. */
+        status = NHL_MEMORY_ERROR;
+
+    } else {
+        NhlCallState state;
+        cb_data data;
+        int writable;
+        memset(&data, 0, sizeof(cb_data));
+        if (nhl->params->verbose) {
+            fprintf(stderr, "Receiving %s ...", url);
+        }
+        if (curl != nhl->curl) {
+            curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+        }
+
+        setup_request(nhl, curl, url, type, &data);
+        nhl_handle_suspend(nhl, &state);
+        curl_easy_perform(curl);
+        nhl_handle_resume(nhl, &state);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &data.code);
+        nhl_visited_add(nhl->visited_urls, url, nhl_cache_current_time(nhl), nhl->call);
+        if (curl != nhl->curl) {
+            curl_easy_cleanup(curl);
+        }
+
+        if (nhl->params->verbose) {
+            fprintf(stderr, " %s\n", data.code == 304 ? "Not modified." : data.len > 0 ? "OK." : "Failed!");
+        }
+        /* The write lock is taken only after the download, so other processes are not blocked by it */
+        writable = nhl_handle_begin_write(nhl);
+        status = update_from_response(nhl, url, &data, writable);
+        if (writable) {
+            nhl_handle_end_write(nhl);
+        }
+        cleanup_request(&data);
+    }
+
+    unclaim_url(nhl, claim, status);
+    nhl_handle_unlock(nhl);
+    return status;
+}
+
+
+/* Single transfer of nhl_update_from_urls(). */
+typedef struct NhlTransfer {
+    CURL *curl;   /* NULL if the URL is skipped */
+    NhlLockClaim *claim; /* claim of the URL, or NULL */
+    NhlLockClaim *other; /* claim of another thread downloading the URL, or NULL */
+    cb_data data;
+} NhlTransfer;
+
+NhlStatus nhl_update_from_urls(Nhl *nhl, const char *const *urls, int num_urls, NhlUpdateContentType type) {
+    NhlStatus status = 0;
+    int start = nhl_prepare(nhl);
+    NhlTransfer *transfers = calloc(num_urls > 0 ? num_urls : 1, sizeof(NhlTransfer));
+    CURLM *multi = curl_multi_init();
+    NhlCallState state;
+    int num_transfers = 0;
+    int running = 0;
+    int writable = 0;
+    int idx;
+
+    if (transfers == NULL || multi == NULL) {
+        free(transfers);
+        if (multi != NULL) {
+            curl_multi_cleanup(multi);
+        }
+        nhl_finish(nhl, start);
+        return NHL_MEMORY_ERROR;
+    }
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, NHL_MAX_CONNECTIONS);
+
+    /* Start all transfers. Duplicate URLs are skipped, because they are marked visited. URLs that
+     * other threads are downloading are waited for only after the batch, because waiting while
+     * holding claims could deadlock. */
+    for (idx = 0; idx != num_urls; ++idx) {
+        transfers[idx].claim = claim_url(nhl, urls[idx], &transfers[idx].other);
+        if (transfers[idx].other != NULL) {
+            continue;
+        }
+        if (skip_url(nhl, urls[idx], type)) {
+            status |= NHL_DOWNLOAD_SKIPPED;
+            unclaim_url(nhl, transfers[idx].claim, NHL_DOWNLOAD_SKIPPED);
+            transfers[idx].claim = NULL;
+            continue;
+        }
+        transfers[idx].curl = curl_easy_init();
+        if (transfers[idx].curl == NULL) {
+            status |= NHL_MEMORY_ERROR;
+            unclaim_url(nhl, transfers[idx].claim, NHL_MEMORY_ERROR);
+            transfers[idx].claim = NULL;
+            continue;
+        }
+        if (nhl->params->verbose) {
+            fprintf(stderr, "Receiving %s\n", urls[idx]);
+        }
+        nhl_visited_add(nhl->visited_urls, urls[idx], nhl_cache_current_time(nhl), nhl->call);
+
+        curl_easy_setopt(transfers[idx].curl, CURLOPT_ACCEPT_ENCODING, "");
+        setup_request(nhl, transfers[idx].curl, urls[idx], type, &transfers[idx].data);
+        ++num_transfers;
+        curl_multi_add_handle(multi, transfers[idx].curl);
+    }
+
+    nhl_handle_suspend(nhl, &state);
+    do {
+        if (curl_multi_perform(multi, &running) != CURLM_OK) {
+            break;
+        }
+        if (running) {
+            curl_multi_poll(multi, NULL, 0, 1000, NULL);
+        }
+    } while (running);
+    nhl_handle_resume(nhl, &state);
+
+    /* Update database in the original order of URLs, within a single write transaction */
+    if (num_transfers > 0) {
+        writable = nhl_handle_begin_write(nhl);
+    }
+    for (idx = 0; idx != num_urls; ++idx) {
+        NhlTransfer *transfer = &transfers[idx];
+        NhlStatus transfer_status;
+        if (transfer->curl == NULL) {
+            continue;
+        }
+        curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &transfer->data.code);
+        curl_multi_remove_handle(multi, transfer->curl);
+        curl_easy_cleanup(transfer->curl);
+
+        if (nhl->params->verbose) {
+            fprintf(stderr, "Received %s ... %s\n", urls[idx], transfer->data.code == 304 ? "Not modified." :
+                    transfer->data.len > 0 ? "OK." : "Failed!");
+        }
+        transfer_status = update_from_response(nhl, urls[idx], &transfer->data, writable);
+        cleanup_request(&transfer->data);
+        unclaim_url(nhl, transfer->claim, transfer_status);
+        status |= transfer_status;
+    }
+    if (writable) {
+        nhl_handle_end_write(nhl);
+    }
+
+    /* Wait for the URLs downloaded by other threads, and use their results */
+    for (idx = 0; idx != num_urls; ++idx) {
+        if (transfers[idx].other != NULL) {
+            status |= wait_url(nhl, transfers[idx].other);
+        }
+    }
+
+    curl_multi_cleanup(multi);
+    free(transfers);
+    nhl_finish(nhl, start);
+    return status;
+}
+
+unsigned long nhl_update_num_changed(Nhl *nhl) {
+    unsigned long num_changed;
+    nhl_handle_lock(nhl);
+    num_changed = nhl->num_changed;
+    nhl_handle_unlock(nhl);
+    return num_changed;
 }
@@ -2,6 +2,10 @@
 #define NHL_URLS_H_
 
 #define NHL_URL_PREFIX_SCHEDULE "https://statsapi.web.nhl.com/api/v1/schedule?expand=schedule.linescore&expand=schedule.scoringplays&date="
+#define NHL_URL_PREFIX_SCHEDULE_RANGE "https://statsapi.web.nhl.com/api/v1/schedule?expand=schedule.linescore&expand=schedule.scoringplays&startDate="
+#define NHL_URL_INFIX_SCHEDULE_RANGE  "&endDate="
+#define NHL_URL_PREFIX_GAME      "https://statsapi.web.nhl.com/api/v1/game/"
+#define NHL_URL_SUFFIX_LINESCORE "/linescore"
 #define NHL_URL_PREFIX_PEOPLE   "https://statsapi.web.nhl.com/api/v1/people"
 #define NHL_URL_TEAMS           "https://statsapi.web.nhl.com/api/v1/teams"
 #define NHL_URL_FRANCHISES      "https://statsapi.web.nhl.com/api/v1/franchises"
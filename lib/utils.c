@@ -50,6 +50,25 @@ int nhl_date_compare(const NhlDate *date1, const NhlDate *date2) {
     return 0;
 }
 
+NhlDate nhl_date_next(const NhlDate *date) {
+    static const int month_days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    NhlDate next = *date;
+    int leap = (date->year % 4 == 0 && date->year % 100 != 0) || date->year % 400 == 0;
+    int days = 31;
+    if (1 <= date->month && date->month <= 12) {
+        days = month_days[date->month - 1] + (date->month == 2 && leap);
+    }
+
+    if (++next.day > days) {
+        next.day = 1;
+        if (++next.month > 12) {
+            next.month = 1;
+            ++next.year;
+        }
+    }
+    return next;
+}
+
 
 NhlTime nhl_string_to_time(const char *str) {
     int hours;
@@ -1,7 +1,5 @@
 #include <nhl/version.h>
 
-#include <stdio.h>
-
 #define NHL_VERSION_MAJOR 0
 #define NHL_VERSION_MINOR 0
 #define NHL_VERSION_PATCH 1
@@ -17,11 +15,11 @@ const NhlVersion *nhl_version(void) {
     return &version;
 }
 
+/* Version string is assembled at compile time, so that no mutable state is needed. */
+#define NHL_STRINGIFY(x) #x
+#define NHL_VERSION_STRING(major, minor, patch) \
+    NHL_STRINGIFY(major) "." NHL_STRINGIFY(minor) "." NHL_STRINGIFY(patch) NHL_VERSION_SUFFIX
+
 const char *nhl_version_string(void) {
-    static char version[3*9 + sizeof(NHL_VERSION_SUFFIX)] = {'\0'};
-    if (!*version) {
-        const NhlVersion *ver = nhl_version();
-        sprintf(version, "%u.%u.%u%s", ver->major, ver->major, ver->patch, ver->suffix);
-    }
-    return version;
+    return NHL_VERSION_STRING(NHL_VERSION_MAJOR, NHL_VERSION_MINOR, NHL_VERSION_PATCH);
 }
@@ -0,0 +1,111 @@
+#include "visited.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "mem.h"
+
+
+/* Single visited URL. Empty slots have NULL url. */
+typedef struct NhlVisitedEntry {
+    char *url;
+    time_t when;
+    unsigned long call;
+} NhlVisitedEntry;
+
+/* Open-addressing hash table of visited URLs. */
+struct NhlVisited {
+    NhlVisitedEntry *entries;
+    unsigned long num_entries;
+    unsigned long num_slots; /* Power of two */
+};
+
+
+NhlVisited *nhl_visited_create(void) {
+    NhlVisited *visited = malloc(sizeof(NhlVisited));
+    if (visited != NULL) {
+        visited->entries = NULL;
+        visited->num_entries = 0;
+        visited->num_slots = 0;
+    }
+    return visited;
+}
+
+void nhl_visited_delete(NhlVisited *visited) {
+    if (visited != NULL) {
+        unsigned long slot;
+        for (slot = 0; slot != visited->num_slots; ++slot) {
+            free(visited->entries[slot].url);
+        }
+        free(visited->entries);
+        free(visited);
+    }
+}
+
+
+/* Slot where url is stored, or the empty slot where it would be stored. */
+static NhlVisitedEntry *find_slot(const NhlVisited *visited, const char *url) {
+    unsigned long mask = visited->num_slots - 1;
+    unsigned long slot = nhl_hash_string(url) & mask;
+    while (visited->entries[slot].url != NULL && strcmp(visited->entries[slot].url, url)) {
+        slot = (slot + 1) & mask;
+    }
+    return &visited->entries[slot];
+}
+
+/* Make room for one more entry, keeping the table at most half full. */
+static int grow(NhlVisited *visited) {
+    if (2 * (visited->num_entries + 1) > visited->num_slots) {
+        NhlVisited resized;
+        unsigned long slot;
+
+        resized.num_slots = visited->num_slots ? 2 * visited->num_slots : 16;
+        resized.entries = calloc(resized.num_slots, sizeof(NhlVisitedEntry));
+        if (resized.entries == NULL) {
+            return 0;
+        }
+        for (slot = 0; slot != visited->num_slots; ++slot) {
+            if (visited->entries[slot].url != NULL) {
+                *find_slot(&resized, visited->entries[slot].url) = visited->entries[slot];
+            }
+        }
+        free(visited->entries);
+        visited->entries = resized.entries;
+        visited->num_slots = resized.num_slots;
+    }
+    return 1;
+}
+
+
+int nhl_visited_add(NhlVisited *visited, const char *url, time_t when, unsigned long call) {
+    NhlVisitedEntry *entry;
+
+    if (!grow(visited)) {
+        return 0;
+    }
+
+    entry = find_slot(visited, url);
+    if (entry->url == NULL) {
+        entry->url = nhl_copy_string(url);
+        if (entry->url == NULL) {
+            return 0;
+        }
+        visited->num_entries++;
+    }
+    entry->when = when;
+    entry->call = call;
+    return 1;
+}
+
+int nhl_visited_find(const NhlVisited *visited, const char *url, time_t *when, unsigned long *call) {
+    if (visited->num_entries != 0) {
+        const NhlVisitedEntry *entry = find_slot(visited, url);
+        if (entry->url != NULL) {
+            *when = entry->when;
+            *call = entry->call;
+            return 1;
+        }
+    }
+    return 0;
+}
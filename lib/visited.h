@@ -0,0 +1,22 @@
+#ifndef NHL_VISITED_H_
+#define NHL_VISITED_H_
+
+#include <time.h>
+
+/* Set of URLs that have been accessed, together with the time of the latest access. */
+typedef struct NhlVisited NhlVisited;
+
+/* Create new empty set. Release with nhl_visited_delete(). */
+NhlVisited *nhl_visited_create(void);
+
+/* Release resources acquired with nhl_visited_create(). */
+void nhl_visited_delete(NhlVisited *visited);
+
+/* Record access to url at the given time during the given top-level call. An earlier record of
+ * the same URL is overwritten. Returns nonzero if success. */
+int nhl_visited_add(NhlVisited *visited, const char *url, time_t when, unsigned long call);
+
+/* Return nonzero if url has been accessed, and store the time and the call of the latest access. */
+int nhl_visited_find(const NhlVisited *visited, const char *url, time_t *when, unsigned long *call);
+
+#endif /* NHL_VISITED_H_ */
@@ -0,0 +1,336 @@
+#include "worker.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <nhl/async.h>
+#include <nhl/game.h>
+#include <nhl/player.h>
+#include "handle.h"
+#include "lock.h"
+
+/* Number of worker threads. Downloads of different workers run in parallel. */
+#define NHL_NUM_WORKERS 4
+
+
+/* Asynchronous request types. */
+typedef enum NhlRequestType {
+    NHL_REQUEST_SCHEDULE,
+    NHL_REQUEST_GAME,
+    NHL_REQUEST_PLAYER
+} NhlRequestType;
+
+/* Single asynchronous request, first in the pending queue and then in the completed queue. */
+typedef struct NhlRequest {
+    NhlRequestType type;
+    NhlDate date;
+    int id;
+    NhlQueryLevel level;
+    NhlScheduleCb schedule_cb;
+    NhlGameCb game_cb;
+    NhlPlayerCb player_cb;
+    void *userdata;
+
+    NhlStatus status;
+    void *result;
+
+    struct NhlRequest *next;
+} NhlRequest;
+
+/* Queue of requests. */
+typedef struct NhlQueue {
+    NhlRequest *head;
+    NhlRequest *tail;
+} NhlQueue;
+
+struct NhlWorkers {
+    Nhl *nhl;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond; /* broadcast when the queues change */
+    pthread_t threads[NHL_NUM_WORKERS];
+    int num_threads;
+    int stop;
+
+    NhlQueue pending;
+    NhlQueue completed;
+    int num_running;
+
+    /* Pipe that has a byte while the completed queue is not empty. Both ends are non-blocking, so
+     * that a worker never blocks on it while holding the mutex. */
+    int notify[2];
+};
+
+
+static void push(NhlQueue *queue, NhlRequest *request) {
+    request->next = NULL;
+    if (queue->tail != NULL) {
+        queue->tail->next = request;
+    } else {
+        queue->head = request;
+    }
+    queue->tail = request;
+}
+
+static NhlRequest *pop(NhlQueue *queue) {
+    NhlRequest *request = queue->head;
+    if (request != NULL) {
+        queue->head = request->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+    }
+    return request;
+}
+
+
+/* Run the synchronous function of the request. */
+static void run_request(Nhl *nhl, NhlRequest *request) {
+    switch (request->type) {
+        case NHL_REQUEST_SCHEDULE:
+            request->status = nhl_schedule_get(nhl, &request->date, request->level,
+                                               (NhlSchedule **) &request->result);
+            break;
+        case NHL_REQUEST_GAME:
+            request->status = nhl_game_get(nhl, request->id, request->level, (NhlGame **) &request->result);
+            break;
+        case NHL_REQUEST_PLAYER:
+            request->status = nhl_player_get(nhl, request->id, request->level, (NhlPlayer **) &request->result);
+            break;
+    }
+}
+
+/* Release the result of a request that is not delivered. */
+static void unget_result(Nhl *nhl, NhlRequest *request) {
+    switch (request->type) {
+        case NHL_REQUEST_SCHEDULE:
+            nhl_schedule_unget(nhl, request->result);
+            break;
+        case NHL_REQUEST_GAME:
+            nhl_game_unget(nhl, request->result);
+            break;
+        case NHL_REQUEST_PLAYER:
+            nhl_player_unget(nhl, request->result);
+            break;
+    }
+}
+
+/* Call the completion callback of the request. */
+static void deliver(Nhl *nhl, NhlRequest *request) {
+    switch (request->type) {
+        case NHL_REQUEST_SCHEDULE:
+            request->schedule_cb(nhl, request->status, request->result, request->userdata);
+            break;
+        case NHL_REQUEST_GAME:
+            request->game_cb(nhl, request->status, request->result, request->userdata);
+            break;
+        case NHL_REQUEST_PLAYER:
+            request->player_cb(nhl, request->status, request->result, request->userdata);
+            break;
+    }
+}
+
+/* Thread function of a worker. */
+static void *work(void *arg) {
+    NhlWorkers *workers = arg;
+    pthread_mutex_lock(&workers->mutex);
+    for (;;) {
+        NhlRequest *request;
+        while (!workers->stop && workers->pending.head == NULL) {
+            pthread_cond_wait(&workers->cond, &workers->mutex);
+        }
+        if (workers->stop) {
+            break;
+        }
+
+        request = pop(&workers->pending);
+        workers->num_running++;
+        pthread_mutex_unlock(&workers->mutex);
+
+        request->result = NULL;
+        run_request(workers->nhl, request);
+
+        pthread_mutex_lock(&workers->mutex);
+        workers->num_running--;
+        if (workers->completed.head == NULL) {
+            /* A full pipe (EAGAIN) is readable already */
+            while (write(workers->notify[1], "", 1) == -1 && errno == EINTR) {
+                continue;
+            }
+        }
+        push(&workers->completed, request);
+        pthread_cond_broadcast(&workers->cond);
+    }
+    pthread_mutex_unlock(&workers->mutex);
+    return NULL;
+}
+
+
+/* Create the workers of the handle. Returns NULL if error occurs. */
+static NhlWorkers *create_workers(Nhl *nhl) {
+    NhlWorkers *workers = calloc(1, sizeof(NhlWorkers));
+    if (workers == NULL) {
+        return NULL;
+    }
+    workers->nhl = nhl;
+    if (pipe(workers->notify) != 0) {
+        free(workers);
+        return NULL;
+    }
+    fcntl(workers->notify[0], F_SETFL, fcntl(workers->notify[0], F_GETFL) | O_NONBLOCK);
+    fcntl(workers->notify[1], F_SETFL, fcntl(workers->notify[1], F_GETFL) | O_NONBLOCK);
+    fcntl(workers->notify[0], F_SETFD, FD_CLOEXEC);
+    fcntl(workers->notify[1], F_SETFD, FD_CLOEXEC);
+    pthread_mutex_init(&workers->mutex, NULL);
+    pthread_cond_init(&workers->cond, NULL);
+
+    while (workers->num_threads != NHL_NUM_WORKERS &&
+           pthread_create(&workers->threads[workers->num_threads], NULL, work, workers) == 0) {
+        workers->num_threads++;
+    }
+    if (workers->num_threads == 0) {
+        nhl_workers_delete(workers, nhl);
+        return NULL;
+    }
+    return workers;
+}
+
+void nhl_workers_delete(NhlWorkers *workers, Nhl *nhl) {
+    if (workers != NULL) {
+        NhlRequest *request;
+        int idx;
+
+        pthread_mutex_lock(&workers->mutex);
+        workers->stop = 1;
+        pthread_cond_broadcast(&workers->cond);
+        pthread_mutex_unlock(&workers->mutex);
+        for (idx = 0; idx != workers->num_threads; ++idx) {
+            pthread_join(workers->threads[idx], NULL);
+        }
+
+        while ((request = pop(&workers->pending)) != NULL) {
+            free(request);
+        }
+        while ((request = pop(&workers->completed)) != NULL) {
+            unget_result(nhl, request);
+            free(request);
+        }
+
+        close(workers->notify[0]);
+        close(workers->notify[1]);
+        pthread_cond_destroy(&workers->cond);
+        pthread_mutex_destroy(&workers->mutex);
+        free(workers);
+    }
+}
+
+/* Queue a request for the workers. Takes the ownership of request. */
+static int submit(Nhl *nhl, NhlRequest *request) {
+    NhlWorkers *workers;
+
+    /* Without workers, no other thread can be using a handle that is not shared yet */
+    if (nhl->lock == NULL) {
+        nhl->lock = nhl_lock_create();
+        if (nhl->lock == NULL) {
+            free(request);
+            return 0;
+        }
+    }
+
+    nhl_handle_lock(nhl);
+    if (nhl->workers == NULL) {
+        nhl->workers = create_workers(nhl);
+    }
+    workers = nhl->workers;
+    nhl_handle_unlock(nhl);
+
+    if (workers == NULL) {
+        free(request);
+        return 0;
+    }
+    pthread_mutex_lock(&workers->mutex);
+    push(&workers->pending, request);
+    pthread_cond_broadcast(&workers->cond);
+    pthread_mutex_unlock(&workers->mutex);
+    return 1;
+}
+
+
+int nhl_schedule_get_async(Nhl *nhl, const NhlDate *date, NhlQueryLevel level,
+                           NhlScheduleCb cb, void *userdata) {
+    NhlRequest *request = calloc(1, sizeof(NhlRequest));
+    if (request == NULL) {
+        return 0;
+    }
+    request->type = NHL_REQUEST_SCHEDULE;
+    request->date = *date;
+    request->level = level;
+    request->schedule_cb = cb;
+    request->userdata = userdata;
+    return submit(nhl, request);
+}
+
+int nhl_game_get_async(Nhl *nhl, int game_id, NhlQueryLevel level, NhlGameCb cb, void *userdata) {
+    NhlRequest *request = calloc(1, sizeof(NhlRequest));
+    if (request == NULL) {
+        return 0;
+    }
+    request->type = NHL_REQUEST_GAME;
+    request->id = game_id;
+    request->level = level;
+    request->game_cb = cb;
+    request->userdata = userdata;
+    return submit(nhl, request);
+}
+
+int nhl_player_get_async(Nhl *nhl, int player_id, NhlQueryLevel level, NhlPlayerCb cb, void *userdata) {
+    NhlRequest *request = calloc(1, sizeof(NhlRequest));
+    if (request == NULL) {
+        return 0;
+    }
+    request->type = NHL_REQUEST_PLAYER;
+    request->id = player_id;
+    request->level = level;
+    request->player_cb = cb;
+    request->userdata = userdata;
+    return submit(nhl, request);
+}
+
+int nhl_poll(Nhl *nhl, int wait) {
+    NhlWorkers *workers = nhl->workers;
+    NhlQueue completed;
+    NhlRequest *request;
+    int num_calls = 0;
+    char buf[64];
+
+    if (workers == NULL) {
+        return 0;
+    }
+
+    /* Take all completed requests, so that callbacks can make new requests */
+    pthread_mutex_lock(&workers->mutex);
+    while (wait && workers->completed.head == NULL &&
+           (workers->pending.head != NULL || workers->num_running != 0)) {
+        pthread_cond_wait(&workers->cond, &workers->mutex);
+    }
+    while (read(workers->notify[0], buf, sizeof(buf)) > 0) {
+        continue;
+    }
+    completed = workers->completed;
+    workers->completed.head = NULL;
+    workers->completed.tail = NULL;
+    pthread_mutex_unlock(&workers->mutex);
+
+    while ((request = pop(&completed)) != NULL) {
+        deliver(nhl, request);
+        free(request);
+        num_calls++;
+    }
+    return num_calls;
+}
+
+int nhl_poll_fd(Nhl *nhl) {
+    return nhl->workers != NULL ? nhl->workers->notify[0] : -1;
+}
@@ -0,0 +1,14 @@
+#ifndef NHL_WORKER_H_
+#define NHL_WORKER_H_
+
+#include <nhl/core.h>
+
+/* Worker threads that run the asynchronous requests of a handle, and the queues of pending and
+ * completed requests. Created by the first asynchronous request. */
+typedef struct NhlWorkers NhlWorkers;
+
+/* Stop the workers, release the results that have not been delivered, and release resources.
+ * Requests that have not been started are discarded without calling their callbacks. */
+void nhl_workers_delete(NhlWorkers *workers, Nhl *nhl);
+
+#endif /* NHL_WORKER_H_ */
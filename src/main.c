@@ -110,16 +110,25 @@ int main(int argc, char **argv) {
     params.cache_file = cache_file;
     params.verbose = uargs.verbose;
     params.offline = uargs.offline;
+    params.read_only = uargs.readonly;
     if (uargs.update) {
         params.schedule_max_age = 0;
         params.game_live_max_age = 0;
         params.game_final_max_age = 0;
+        params.game_future_max_age = 0;
         params.team_max_age = 0;
         params.player_max_age = 0;
         params.league_max_age = 0;
         params.meta_max_age = 0;
     }
     Nhl *nhl = nhl_init(&params);
+    if (nhl == NULL) {
+        fprintf(stderr, "Unable to open cache file \"%s\".\n", cache_file != NULL ? cache_file : ":memory:");
+        free(cache_file);
+        free(dates);
+        reset_args(&uargs);
+        return 1;
+    }
 
     // Get and show results
     NhlQueryLevel level = NHL_QUERY_BASIC | NHL_QUERY_GAMEDETAILS;
@@ -139,21 +148,30 @@ int main(int argc, char **argv) {
         .num_highlight = uargs.num_highlight,
         .utc_offset = tzone,
     };
+    NhlDate *nhl_dates = malloc(num_dates * sizeof(NhlDate));
+    int *date_indices = malloc(num_dates * sizeof(int));
+    int num_valid = 0;
     for (int i = 0; i != num_dates; ++i) {
         if (dates[i].day <= 0)
             continue;
-        NhlDate date = {
+        nhl_dates[num_valid] = (NhlDate) {
             .year = dates[i].year,
             .month = dates[i].month,
             .day = dates[i].day
         };
-        NhlSchedule *schedule;
-        nhl_schedule_get(nhl, &date, level, &schedule); // TODO: Check return value
-        display(schedule, &opts);
-        if (i < num_dates-1 && opts.style != STYLE_COMPACT)
+        date_indices[num_valid++] = i;
+    }
+    NhlSchedule **schedules = malloc((num_valid > 0 ? num_valid : 1) * sizeof(NhlSchedule *));
+    nhl_schedules_get(nhl, nhl_dates, num_valid, level, schedules); // TODO: Check return value
+    for (int i = 0; i != num_valid; ++i) {
+        display(schedules[i], &opts);
+        if (date_indices[i] < num_dates-1 && opts.style != STYLE_COMPACT)
             printf("\n");
-        nhl_schedule_unget(nhl, schedule); // TODO: This is inefficient if there are many dates
+        nhl_schedule_unget(nhl, schedules[i]);
     }
+    free(schedules);
+    free(date_indices);
+    free(nhl_dates);
 
     // Clean-up
     nhl_close(nhl);
@@ -38,7 +38,7 @@ enum keys {
     KEY_TEKSTITV = 1000,
     KEY_TIMEZONE,
     KEY_CACHEFILE,
-    // KEY_READONLY,
+    KEY_READONLY,
 };
 
 static const struct argp_option options[] = {
@@ -54,7 +54,7 @@ static const struct argp_option options[] = {
     {0, 0, 0, 0, "Cache settings:", 0},
     {"cache-file", KEY_CACHEFILE, "FILE", 0, "Use non-default cache file", 0},
     {"offline", KEY_OFFLINE, 0, 0, "Do not connect to the Internet", 0},
-    // {"read-only", KEY_READONLY, 0, 0, "Do not write to cache", 0},
+    {"read-only", KEY_READONLY, 0, 0, "Do not write to cache", 0},
     {"update", KEY_UPDATE, 0, 0, "Do not read from cache", 0},
     {0, 0, 0, 0, "Help and diagnostics:", -1},
     {"verbose", KEY_VERBOSE, 0, 0, "Increase verbosity level for debugging", 0},
@@ -94,9 +94,9 @@ static error_t parse(int key, char *arg, struct argp_state *state) {
         case KEY_CACHEFILE:
             uargs->cache_file = arg;
             break;
-        // case KEY_READONLY:
-        //     uargs->readonly = true;
-        //     break;
+        case KEY_READONLY:
+            uargs->readonly = true;
+            break;
         case KEY_OFFLINE:
             uargs->offline = true;
             break;
@@ -168,7 +168,7 @@ void print_args(UserArgs *args) {
         printf("  Time zone: (default)\n");
     printf("  Cache file: %s\n", args->cache_file ? args->cache_file : "(default)");
     printf("  Offline mode: %s\n", args->offline ? "on" : "off");
-    // printf("  Read-only cache: %s\n", args->readonly ? "on" : "off");
+    printf("  Read-only cache: %s\n", args->readonly ? "on" : "off");
     printf("  Write-only cache: %s\n", args->update ? "on" : "off");
     printf("  Verbosity: %d\n", args->verbose);
 }
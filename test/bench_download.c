@@ -0,0 +1,152 @@
+/* Benchmark of downloading the schedules of a week one by one and as a batch. The schedules are
+ * served by a loopback HTTP server that delays each response to simulate a round trip. */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fixture.h"
+
+#define NUM_DATES 7
+#define DELAY_MS 50
+#define CACHE_FILE "bench_download.db"
+
+static char *body;
+static long body_len;
+
+
+/* Read the whole fixture file name into body. */
+static int read_body(const char *name) {
+    char path[4096];
+    FILE *file;
+    snprintf(path, sizeof(path), "%s/%s", NHL_TEST_DATA, name);
+    if ((file = fopen(path, "rb")) == NULL) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    body_len = ftell(file);
+    rewind(file);
+    body = malloc(body_len);
+    if (body == NULL || fread(body, 1, body_len, file) != (size_t) body_len) {
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    return 1;
+}
+
+/* Answer a single request with the fixture after the delay. */
+static void *serve_request(void *arg) {
+    int conn = (int) (long) arg;
+    char request[4096];
+    char header[256];
+    size_t len = 0;
+    ssize_t num;
+
+    while (len < sizeof(request) - 1 && (num = read(conn, request + len, sizeof(request) - 1 - len)) > 0) {
+        len += num;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL) {
+            break;
+        }
+    }
+    usleep(DELAY_MS * 1000);
+    snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+             "Content-Length: %ld\r\nConnection: close\r\n\r\n", body_len);
+    if (write(conn, header, strlen(header)) < 0 || write(conn, body, body_len) < 0) {
+        perror("write");
+    }
+    close(conn);
+    return NULL;
+}
+
+/* Accept connections forever, each in a thread of its own. */
+static void *serve(void *arg) {
+    int sock = (int) (long) arg;
+    for (;;) {
+        pthread_t thread;
+        int conn = accept(sock, NULL, NULL);
+        if (conn < 0) {
+            continue;
+        }
+        pthread_create(&thread, NULL, serve_request, (void *) (long) conn);
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+/* Start the server on a free loopback port, and return the port or zero if error occurs. */
+static int start_server(void) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    pthread_t thread;
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (sock < 0 || bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(sock, 64) != 0 ||
+        getsockname(sock, (struct sockaddr *) &addr, &addr_len) != 0) {
+        return 0;
+    }
+    pthread_create(&thread, NULL, serve, (void *) (long) sock);
+    pthread_detach(thread);
+    return ntohs(addr.sin_port);
+}
+
+/* Download the URLs into a fresh cache, either one by one or as a batch, and return the time taken
+ * in seconds, or a negative value if some download fails. */
+static double run(char **urls, int batch) {
+    Nhl *nhl;
+    NhlStatus status = 0;
+    double start;
+    int idx;
+
+    remove(CACHE_FILE);
+    nhl = fixture_open(CACHE_FILE, 0);
+    start = fixture_seconds();
+    if (batch) {
+        status = nhl_update_from_urls(nhl, (const char *const *) urls, NUM_DATES, NHL_CONTENT_SCHEDULE);
+    } else {
+        for (idx = 0; idx != NUM_DATES; ++idx) {
+            status |= nhl_update_from_url(nhl, urls[idx], NHL_CONTENT_SCHEDULE);
+        }
+    }
+    start = fixture_seconds() - start;
+    nhl_close(nhl);
+    remove(CACHE_FILE);
+    return status & NHL_DOWNLOAD_ERROR ? -1.0 : start;
+}
+
+int main(void) {
+    char *urls[NUM_DATES];
+    double sequential;
+    double batch;
+    int port;
+    int idx;
+
+    if (!read_body("schedule.json") || (port = start_server()) == 0) {
+        fprintf(stderr, "Cannot start the fixture server\n");
+        return EXIT_FAILURE;
+    }
+    for (idx = 0; idx != NUM_DATES; ++idx) {
+        urls[idx] = malloc(64);
+        snprintf(urls[idx], 64, "http://127.0.0.1:%d/schedule?date=2022-01-%02d", port, idx + 3);
+    }
+
+    sequential = run(urls, 0);
+    batch = run(urls, 1);
+    printf("download %d schedules (%d ms per response): sequential %.0f ms, batch %.0f ms\n",
+           NUM_DATES, DELAY_MS, 1000 * sequential, 1000 * batch);
+
+    for (idx = 0; idx != NUM_DATES; ++idx) {
+        free(urls[idx]);
+    }
+    free(body);
+    return sequential < 0 || batch < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
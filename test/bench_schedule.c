@@ -0,0 +1,64 @@
+/* Benchmark of reading a full schedule from the cache. A cold read opens a new handle, so that the
+ * schedule is read from the cache file with its games, linescores, periods and goals. A warm read
+ * uses the same handle again, so that the schedule is found in memory. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fixture.h"
+
+#define NUM_COLD 2000
+#define NUM_WARM 100000
+#define CACHE_FILE "bench_schedule.db"
+
+
+/* Read the schedule of the fixture date. Returns zero if the schedule is not complete. */
+static int read_schedule(Nhl *nhl) {
+    NhlDate date = NHL_TEST_DATE;
+    NhlSchedule *schedule;
+    int ok;
+    nhl_schedule_get(nhl, &date, NHL_QUERY_FULL, &schedule);
+    ok = schedule != NULL && schedule->num_games > 0 && schedule->games[0] != NULL;
+    nhl_schedule_unget(nhl, schedule);
+    return ok;
+}
+
+int main(void) {
+    Nhl *nhl;
+    double start;
+    double cold;
+    double warm;
+    int ok;
+    int idx;
+
+    remove(CACHE_FILE);
+    nhl = fixture_open(CACHE_FILE, 0);
+    ok = nhl != NULL && fixture_load(nhl);
+    nhl_close(nhl);
+
+    start = fixture_seconds();
+    for (idx = 0; ok && idx != NUM_COLD; ++idx) {
+        nhl = fixture_open(CACHE_FILE, 1);
+        ok = read_schedule(nhl);
+        nhl_close(nhl);
+    }
+    cold = (fixture_seconds() - start) / NUM_COLD;
+
+    nhl = fixture_open(CACHE_FILE, 1);
+    ok = ok && read_schedule(nhl);
+    start = fixture_seconds();
+    for (idx = 0; ok && idx != NUM_WARM; ++idx) {
+        ok = read_schedule(nhl);
+    }
+    warm = (fixture_seconds() - start) / NUM_WARM;
+    nhl_close(nhl);
+
+    remove(CACHE_FILE);
+    if (!ok) {
+        fprintf(stderr, "Cannot read the fixture schedule\n");
+        return EXIT_FAILURE;
+    }
+    printf("schedule get (full): cold %.1f us (including open and close), warm %.2f us\n",
+           1e6 * cold, 1e6 * warm);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,56 @@
+#include "fixture.h"
+
+#include <stdio.h>
+#include <time.h>
+
+
+/* Fixture files and their content types. The schedule comes last, so that the objects it refers
+ * to are already cached. */
+static const struct {
+    const char *name;
+    NhlUpdateContentType type;
+} fixtures[] = {
+    {"teams.json",          NHL_CONTENT_TEAMS},
+    {"franchises.json",     NHL_CONTENT_FRANCHISES},
+    {"divisions.json",      NHL_CONTENT_DIVISIONS},
+    {"conferences.json",    NHL_CONTENT_CONFERENCES},
+    {"gamestatus.json",     NHL_CONTENT_GAME_STATUSES},
+    {"gametypes.json",      NHL_CONTENT_GAME_TYPES},
+    {"positions.json",      NHL_CONTENT_POSITIONS},
+    {"rosterstatuses.json", NHL_CONTENT_ROSTER_STATUSES},
+    {"people_8475786.json", NHL_CONTENT_PEOPLE},
+    {"people_8477934.json", NHL_CONTENT_PEOPLE},
+    {"people_8478402.json", NHL_CONTENT_PEOPLE},
+    {"schedule.json",       NHL_CONTENT_SCHEDULE}
+};
+
+void fixture_url(char *url, size_t size, const char *name) {
+    snprintf(url, size, "file://%s/%s", NHL_TEST_DATA, name);
+}
+
+Nhl *fixture_open(const char *cache_file, int offline) {
+    NhlInitParams params;
+    nhl_default_params(&params);
+    params.cache_file = (char *) cache_file;
+    params.offline = offline;
+    return nhl_init(&params);
+}
+
+int fixture_load(Nhl *nhl) {
+    char url[4096];
+    size_t idx;
+    for (idx = 0; idx != sizeof(fixtures) / sizeof(fixtures[0]); ++idx) {
+        fixture_url(url, sizeof(url), fixtures[idx].name);
+        if (!(nhl_update_from_url(nhl, url, fixtures[idx].type) & NHL_DOWNLOAD_OK)) {
+            fprintf(stderr, "Cannot read fixture %s\n", url);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+double fixture_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
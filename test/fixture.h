@@ -0,0 +1,28 @@
+#ifndef NHL_TEST_FIXTURE_H_
+#define NHL_TEST_FIXTURE_H_
+
+#include <stddef.h>
+
+#include <nhl/nhl.h>
+
+/* Directory of the JSON fixtures, normally set by the Makefile. */
+#ifndef NHL_TEST_DATA
+#define NHL_TEST_DATA "data"
+#endif
+
+/* Date of the fixture schedule with the most games. */
+#define NHL_TEST_DATE {2022, 1, 4}
+
+/* Write the file:// URL of the fixture file name into url. */
+void fixture_url(char *url, size_t size, const char *name);
+
+/* Open a handle on cache_file with default parameters, except for offline. */
+Nhl *fixture_open(const char *cache_file, int offline);
+
+/* Read all fixtures into the cache of the handle. Returns zero if some of them cannot be read. */
+int fixture_load(Nhl *nhl);
+
+/* Monotonic clock in seconds. */
+double fixture_seconds(void);
+
+#endif /* NHL_TEST_FIXTURE_H_ */
@@ -0,0 +1,113 @@
+/* Check that the cache lookups of games by date and by ID, and of periods and goals by game, search
+ * indices instead of scanning whole tables, and so do the updates that touch the rows of a source.
+ * Each lookup is made once, so that its statement is prepared in the handle, and the query plans of
+ * the prepared statements are then examined. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sqlite3.h>
+
+#include "fixture.h"
+#include "cache.h"
+#include "handle.h"
+
+#define CACHE_FILE "query_plan.db"
+
+/* Conditions of the lookups, as they appear in the SQL of the statements. */
+static const char *const lookups[] = {
+    "FROM Games WHERE date=?",
+    "FROM Games WHERE gamePk=?",
+    "FROM Periods WHERE game=?",
+    "FROM Goals WHERE game=?",
+    "UPDATE Games SET _timestamp=? WHERE _source=?",
+    "UPDATE Periods SET _timestamp=? WHERE _source=?",
+    "UPDATE Goals SET _timestamp=? WHERE _source=?",
+    "UPDATE Linescores SET _timestamp=? WHERE _source=?"
+};
+#define NUM_LOOKUPS (int) (sizeof(lookups) / sizeof(lookups[0]))
+
+
+/* Print the query plan of sql, and return nonzero if every step of it searches an index. */
+static int plan_searches(sqlite3 *db, const char *sql) {
+    char *explain = sqlite3_mprintf("EXPLAIN QUERY PLAN %s", sql);
+    sqlite3_stmt *stmt = NULL;
+    int num_steps = 0;
+    int ok = explain != NULL && sqlite3_prepare_v2(db, explain, -1, &stmt, NULL) == SQLITE_OK;
+
+    while (ok && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *detail = (const char *) sqlite3_column_text(stmt, 3);
+        printf("  %s\n", detail != NULL ? detail : "(null)");
+        ok = detail != NULL && strncmp(detail, "SEARCH", 6) == 0;
+        ++num_steps;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_free(explain);
+    return ok && num_steps > 0;
+}
+
+int main(void) {
+    NhlDate date = NHL_TEST_DATE;
+    char *date_str = nhl_date_to_string(&date);
+    int found[NUM_LOOKUPS] = {0};
+    int num_games = 0;
+    int num_periods = 0;
+    int num_goals = 0;
+    int failures = 0;
+    int *game_ids;
+    NhlCacheGame *game;
+    NhlCachePeriod *periods;
+    NhlCacheGoal *goals;
+    NhlCacheMeta meta;
+    sqlite3_stmt *stmt;
+    Nhl *nhl;
+    int idx;
+
+    remove(CACHE_FILE);
+    nhl = fixture_open(CACHE_FILE, 0);
+    if (nhl == NULL || !fixture_load(nhl)) {
+        return EXIT_FAILURE;
+    }
+
+    game_ids = nhl_cache_games_find(nhl, date_str, &num_games);
+    if (num_games == 0) {
+        fprintf(stderr, "No games on %s\n", date_str);
+        return EXIT_FAILURE;
+    }
+    game = nhl_cache_game_get(nhl, game_ids[0]);
+    meta = *game->meta;
+    nhl_cache_game_free(game);
+    periods = nhl_cache_periods_get(nhl, game_ids[0], &num_periods);
+    nhl_cache_periods_free(periods, num_periods);
+    goals = nhl_cache_goals_get(nhl, game_ids[0], &num_goals);
+    nhl_cache_goals_free(goals, num_goals);
+    nhl_cache_source_touch(nhl, &meta);
+
+    for (stmt = sqlite3_next_stmt(nhl->db, NULL); stmt != NULL; stmt = sqlite3_next_stmt(nhl->db, stmt)) {
+        const char *sql = sqlite3_sql(stmt);
+        for (idx = 0; idx != NUM_LOOKUPS; ++idx) {
+            if (sql != NULL && strstr(sql, lookups[idx]) != NULL && !found[idx]) {
+                found[idx] = 1;
+                printf("%s\n", lookups[idx]);
+                if (!plan_searches(nhl->db, sql)) {
+                    printf("FAIL: %s does not search an index\n", lookups[idx]);
+                    ++failures;
+                }
+            }
+        }
+    }
+    for (idx = 0; idx != NUM_LOOKUPS; ++idx) {
+        if (!found[idx]) {
+            printf("FAIL: no statement %s\n", lookups[idx]);
+            ++failures;
+        }
+    }
+
+    free(game_ids);
+    free(date_str);
+    nhl_close(nhl);
+    remove(CACHE_FILE);
+    printf("query_plan: %s\n", failures == 0 ? "OK" : "FAILED");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
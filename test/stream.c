@@ -0,0 +1,261 @@
+/* Unit test of the incremental JSON parser. Every document is fed in two pieces split at each byte
+ * position, and also byte by byte, and the result must not depend on how the input is split. The
+ * elements selected by a path must be handed out with their ancestors. Truncated and malformed
+ * documents must be rejected. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cjson/cJSON.h>
+
+#include "stream.h"
+
+/* Text of a parsed document in a canonical form, or of all the elements handed to the callback. */
+typedef struct Text {
+    char str[4096];
+    size_t len;
+} Text;
+
+static int failures;
+
+
+/* Append formatted text, truncating if the buffer is full. */
+static void append(Text *text, const char *str) {
+    size_t len = strlen(str);
+    if (text->len + len >= sizeof(text->str)) {
+        len = sizeof(text->str) - text->len - 1;
+    }
+    memcpy(text->str + text->len, str, len);
+    text->len += len;
+    text->str[text->len] = '\0';
+}
+
+/* Append a string in quotes. Quotes, backslashes and control characters are escaped, and other
+ * characters are written as UTF-8. */
+static void append_quoted(Text *text, const char *str) {
+    char buf[8];
+    append(text, "\"");
+    for (; *str != '\0'; ++str) {
+        if (*str == '"' || *str == '\\') {
+            sprintf(buf, "\\%c", *str);
+        } else if ((unsigned char) *str < 0x20) {
+            sprintf(buf, "\\u%04x", (unsigned) *str);
+        } else {
+            sprintf(buf, "%c", *str);
+        }
+        append(text, buf);
+    }
+    append(text, "\"");
+}
+
+/* Append the canonical form of a tree. */
+static void append_tree(Text *text, const cJSON *item) {
+    char buf[32];
+    const cJSON *child;
+    switch (item->type & 0xFF) {
+        case cJSON_False:
+            append(text, "false");
+            break;
+        case cJSON_True:
+            append(text, "true");
+            break;
+        case cJSON_NULL:
+            append(text, "null");
+            break;
+        case cJSON_Number:
+            sprintf(buf, "%g", item->valuedouble);
+            append(text, buf);
+            break;
+        case cJSON_String:
+            append_quoted(text, item->valuestring);
+            break;
+        case cJSON_Array:
+        case cJSON_Object:
+            append(text, item->type & cJSON_Array ? "[" : "{");
+            for (child = item->child; child != NULL; child = child->next) {
+                if (child != item->child) {
+                    append(text, ",");
+                }
+                if (item->type & cJSON_Object) {
+                    append_quoted(text, child->string);
+                    append(text, ":");
+                }
+                append_tree(text, child);
+            }
+            append(text, item->type & cJSON_Array ? "]" : "}");
+            break;
+        default:
+            append(text, "?");
+            break;
+    }
+}
+
+/* Callback that records the date of the enclosing element of "dates" and the game. */
+static void game_cb(NhlJsonStream *stream, cJSON *game, void *userdata) {
+    Text *text = userdata;
+    cJSON *date = cJSON_GetObjectItemCaseSensitive(nhl_json_stream_ancestor(stream, 2), "date");
+    append(text, date != NULL && date->valuestring != NULL ? date->valuestring : "?");
+    append(text, "=");
+    append_tree(text, game);
+    append(text, ";");
+}
+
+static const char *const game_path[] = { "dates", NULL, "games", NULL };
+
+/* Parse the first len bytes of doc in pieces of the given size, except that the first piece ends at
+ * split. Returns nonzero if the document is valid, in which case its canonical form is written to
+ * result. The elements at game_path are handed out if select is nonzero, and written to games. */
+static int parse(const char *doc, size_t len, size_t split, size_t piece, int select, Text *result,
+                 Text *games) {
+    NhlJsonStream *stream;
+    cJSON *root;
+    int ok;
+    size_t pos;
+
+    memset(result, 0, sizeof(Text));
+    memset(games, 0, sizeof(Text));
+    if (select) {
+        stream = nhl_json_stream_create(game_path, 4, game_cb, games);
+    } else {
+        stream = nhl_json_stream_create(NULL, 0, NULL, NULL);
+    }
+    ok = stream != NULL && nhl_json_stream_feed(stream, doc, split);
+    for (pos = split; ok && pos < len; pos += piece) {
+        ok = nhl_json_stream_feed(stream, doc + pos, pos + piece < len ? piece : len - pos);
+    }
+    root = ok ? nhl_json_stream_finish(stream) : NULL;
+    if (root != NULL) {
+        append_tree(result, root);
+        cJSON_Delete(root);
+    }
+    nhl_json_stream_delete(stream);
+    return root != NULL;
+}
+
+/* Check that doc parses to expected when split at every byte position, and when fed byte by byte.
+ * If expected_games is not NULL, the games are handed out and must match it. */
+static void check_valid(const char *doc, const char *expected, const char *expected_games) {
+    size_t len = strlen(doc);
+    size_t split;
+    Text result;
+    Text games;
+    for (split = 0; split <= len + 1; ++split) {
+        int select = expected_games != NULL;
+        int ok = split <= len ? parse(doc, len, split, len, select, &result, &games) :
+                                parse(doc, len, 0, 1, select, &result, &games);
+        if (!ok || strcmp(result.str, expected) != 0 ||
+                (select && strcmp(games.str, expected_games) != 0)) {
+            printf("FAIL: %s split at %lu: %s %s\n", doc, (unsigned long) split,
+                   ok ? result.str : "(invalid)", games.str);
+            ++failures;
+            return;
+        }
+    }
+}
+
+/* Check that the first len bytes of doc are rejected when fed byte by byte and in one piece, and if
+ * every_split is nonzero, also when split at every byte position. */
+static void check_rejected(const char *doc, size_t len, int every_split) {
+    size_t split;
+    Text result;
+    Text games;
+    for (split = 0; split <= len + 1; ++split) {
+        int ok;
+        if (split > 0 && split < len && !every_split) {
+            continue;
+        }
+        ok = split <= len ? parse(doc, len, split, len, 1, &result, &games) :
+                            parse(doc, len, 0, 1, 1, &result, &games);
+        if (ok) {
+            printf("FAIL: %.*s accepted (split at %lu): %s\n", (int) len, doc,
+                   (unsigned long) split, result.str);
+            ++failures;
+            return;
+        }
+    }
+}
+
+/* Documents with escapes, surrogate pairs, numbers, literals and nested containers. */
+static const char schedule_doc[] =
+    "{\"copyright\" : \"NHL \\\"quoted\\\" \\\\ \\/ \\b\\f\\n\\r\\t\",\n"
+    " \"name\": \"J\\u00e4rvinen \\u20AC \\ud83c\\udfd2 J\xc3\xa4rvinen\",\n"
+    " \"numbers\": [0, -1, 2.5, -1.25e2, 1E3, 4e-2],\n"
+    " \"literals\": [true, false, null], \"empty\": {}, \"none\": [ ],\n"
+    " \"dates\": [\n"
+    "  {\"date\": \"2022-01-04\",\n"
+    "   \"games\": [{\"gamePk\": 1, \"teams\": {\"away\": [\"A\"]}}, {\"gamePk\": 2}]},\n"
+    "  {\"date\": \"2022-01-05\", \"games\": []},\n"
+    "  {\"date\": \"2022-01-06\", \"games\": [{\"gamePk\": 3, \"games\": [{\"gamePk\": 4}]}],\n"
+    "   \"totalGames\": 1}\n"
+    " ]\n"
+    "}";
+
+static const char schedule_tree[] =
+    "{\"copyright\":\"NHL \\\"quoted\\\" \\\\ / \\u0008\\u000c\\u000a\\u000d\\u0009\","
+    "\"name\":\"J\xc3\xa4rvinen \xe2\x82\xac \xf0\x9f\x8f\x92 J\xc3\xa4rvinen\","
+    "\"numbers\":[0,-1,2.5,-125,1000,0.04],"
+    "\"literals\":[true,false,null],\"empty\":{},\"none\":[],"
+    "\"dates\":[{\"date\":\"2022-01-04\","
+    "\"games\":[{\"gamePk\":1,\"teams\":{\"away\":[\"A\"]}},{\"gamePk\":2}]},"
+    "{\"date\":\"2022-01-05\",\"games\":[]},"
+    "{\"date\":\"2022-01-06\",\"games\":[{\"gamePk\":3,\"games\":[{\"gamePk\":4}]}],"
+    "\"totalGames\":1}]}";
+
+/* The same document without the games, which are handed out one by one instead. */
+static const char schedule_rest[] =
+    "{\"copyright\":\"NHL \\\"quoted\\\" \\\\ / \\u0008\\u000c\\u000a\\u000d\\u0009\","
+    "\"name\":\"J\xc3\xa4rvinen \xe2\x82\xac \xf0\x9f\x8f\x92 J\xc3\xa4rvinen\","
+    "\"numbers\":[0,-1,2.5,-125,1000,0.04],"
+    "\"literals\":[true,false,null],\"empty\":{},\"none\":[],"
+    "\"dates\":[{\"date\":\"2022-01-04\",\"games\":[]},{\"date\":\"2022-01-05\",\"games\":[]},"
+    "{\"date\":\"2022-01-06\",\"games\":[],\"totalGames\":1}]}";
+
+static const char schedule_games[] =
+    "2022-01-04={\"gamePk\":1,\"teams\":{\"away\":[\"A\"]}};2022-01-04={\"gamePk\":2};"
+    "2022-01-06={\"gamePk\":3,\"games\":[{\"gamePk\":4}]};";
+
+/* Malformed documents. Their prefixes are rejected as well, except for documents that start with
+ * a valid document, which are marked with zero. */
+static const struct {
+    const char *doc;
+    int prefixes;
+} invalid_docs[] = {
+    {"", 1}, {" ", 1}, {"}", 1}, {"]", 1}, {"[1,]", 1}, {"[,1]", 1}, {"[1,,2]", 1},
+    {"{\"a\":}", 1}, {"{\"a\" 1}", 1}, {"{\"a\"::1}", 1}, {"{\"a\":1,}", 1}, {"{,}", 1},
+    {"{1:2}", 1}, {"{\"a\":1 \"b\":2}", 1}, {"{\"a\"}", 1}, {"[1 2]", 1}, {"[1]]", 0},
+    {"[1]x", 0}, {"{}{}", 0}, {"[01]", 1}, {"[-]", 1}, {"[1.]", 1}, {"[.5]", 1}, {"[1e]", 1},
+    {"[+1]", 1}, {"[tru]", 1}, {"[nul]", 1}, {"[True]", 1}, {"[\"a]", 1}, {"[\"\\x\"]", 1},
+    {"[\"\\u12G4\"]", 1}, {"[\"\\ud83c\"]", 1}, {"[\"\\ud83cx\"]", 1},
+    {"[\"\\ud83c\\n\"]", 1}, {"[\"\\ud83c\\u0041\"]", 1}, {"[\"\\udfd2\"]", 1},
+    {"[\"tab\there\"]", 1}, {"{\"dates\":[{\"games\":[{\"gamePk\":1,}]}]}", 1}
+};
+#define NUM_INVALID (int) (sizeof(invalid_docs) / sizeof(invalid_docs[0]))
+
+int main(void) {
+    size_t len;
+    int idx;
+
+    check_valid(schedule_doc, schedule_tree, NULL);
+    check_valid(schedule_doc, schedule_rest, schedule_games);
+    check_valid("12", "12", NULL);
+    check_valid(" \"a\\u0041\\u00e4\" ", "\"aA\xc3\xa4\"", NULL);
+    check_valid("-0.5e-1", "-0.05", NULL);
+    check_valid("[[], {}, [[1]]]", "[[],{},[[1]]]", NULL);
+
+    /* Truncated documents */
+    for (len = 0; len < strlen(schedule_doc); ++len) {
+        check_rejected(schedule_doc, len, 0);
+    }
+
+    for (idx = 0; idx != NUM_INVALID; ++idx) {
+        len = strlen(invalid_docs[idx].doc);
+        check_rejected(invalid_docs[idx].doc, len, 1);
+        while (invalid_docs[idx].prefixes && len-- > 0) {
+            check_rejected(invalid_docs[idx].doc, len, 1);
+        }
+    }
+
+    printf("stream: %s\n", failures == 0 ? "OK" : "FAILED");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
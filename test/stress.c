@@ -0,0 +1,129 @@
+/* Stress test of handles on several threads. First, each thread repeatedly opens handles of its own
+ * on a single cache file, writes the fixture schedule and reads back one of its dates. Then, all
+ * threads read the schedules through a single shared handle. Every read must find all games of the
+ * date, and no write may fail. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fixture.h"
+
+#define NUM_THREADS 8
+#define NUM_ROUNDS 100
+#define CACHE_FILE "stress.db"
+
+static Nhl *shared;
+static int failures;
+static int num_locked;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Record a failure, or a write that was skipped because the cache was locked. */
+static void record(int *counter, const char *what, int thread, int round) {
+    pthread_mutex_lock(&mutex);
+    if (counter == &failures) {
+        fprintf(stderr, "FAIL: %s (thread %d, round %d)\n", what, thread, round);
+    }
+    ++*counter;
+    pthread_mutex_unlock(&mutex);
+}
+
+/* Read the schedule of a fixture date with the given handle, and check the number of games. */
+static void check_schedule(Nhl *nhl, int thread, int round) {
+    NhlDate date = NHL_TEST_DATE;
+    NhlSchedule *schedule;
+    int expected;
+    int idx;
+
+    date.day -= (thread + round) % 2;
+    expected = date.day == 4 ? 2 : 1;
+    nhl_schedule_get(nhl, &date, NHL_QUERY_FULL, &schedule);
+    if (schedule == NULL || schedule->num_games != expected) {
+        record(&failures, "wrong number of games", thread, round);
+    } else {
+        for (idx = 0; idx != schedule->num_games; ++idx) {
+            if (schedule->games[idx] == NULL || schedule->games[idx]->home == NULL) {
+                record(&failures, "incomplete game", thread, round);
+            }
+        }
+    }
+    nhl_schedule_unget(nhl, schedule);
+}
+
+/* Write and read the cache with handles of the thread. */
+static void *run_own(void *arg) {
+    int thread = (int) (long) arg;
+    char url[4096];
+    int round;
+
+    fixture_url(url, sizeof(url), "schedule.json");
+    for (round = 0; round != NUM_ROUNDS; ++round) {
+        Nhl *nhl = fixture_open(CACHE_FILE, 0);
+        NhlStatus status = nhl != NULL ? nhl_update_from_url(nhl, url, NHL_CONTENT_SCHEDULE) : 0;
+        if (!(status & NHL_DOWNLOAD_OK) || status & NHL_CACHE_WRITE_ERROR) {
+            record(&failures, "update failed", thread, round);
+        } else if (status & NHL_CACHE_LOCKED) {
+            record(&num_locked, NULL, thread, round);
+        }
+        nhl_close(nhl);
+
+        nhl = fixture_open(CACHE_FILE, 1);
+        check_schedule(nhl, thread, round);
+        nhl_close(nhl);
+    }
+    return NULL;
+}
+
+/* Read the cache with the shared handle. */
+static void *run_shared(void *arg) {
+    int thread = (int) (long) arg;
+    int round;
+    for (round = 0; round != NUM_ROUNDS; ++round) {
+        check_schedule(shared, thread, round);
+    }
+    return NULL;
+}
+
+/* Run func on all threads, and return zero if some thread could not be started. */
+static int run_threads(void *(*func)(void *)) {
+    pthread_t threads[NUM_THREADS];
+    int num_threads;
+    int idx;
+    for (num_threads = 0; num_threads != NUM_THREADS; ++num_threads) {
+        if (pthread_create(&threads[num_threads], NULL, func, (void *) (long) num_threads) != 0) {
+            break;
+        }
+    }
+    for (idx = 0; idx != num_threads; ++idx) {
+        pthread_join(threads[idx], NULL);
+    }
+    return num_threads == NUM_THREADS;
+}
+
+int main(void) {
+    NhlInitParams params;
+    Nhl *nhl;
+    int ok;
+
+    /* Reference data is written once, so that the schedules can be read completely */
+    remove(CACHE_FILE);
+    nhl = fixture_open(CACHE_FILE, 0);
+    ok = nhl != NULL && fixture_load(nhl);
+    nhl_close(nhl);
+
+    ok = ok && run_threads(run_own);
+
+    nhl_default_params(&params);
+    params.cache_file = CACHE_FILE;
+    params.offline = 1;
+    params.shared = 1;
+    shared = nhl_init(&params);
+    ok = ok && shared != NULL && run_threads(run_shared);
+    nhl_close(shared);
+
+    remove(CACHE_FILE);
+    printf("stress: %d threads, %d rounds, %d writes skipped as locked: %s\n", NUM_THREADS, NUM_ROUNDS,
+           num_locked, ok && failures == 0 ? "OK" : "FAILED");
+    return ok && failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}